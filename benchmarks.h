@@ -0,0 +1,485 @@
+/**********************************************************************************************************************
+ * 	Module: Benchmarking module
+ * 	File Name: benchmarks.h
+ *  Authors: Ahmed Desoky
+ *	Date: 17/10/2026
+ *	*********************************************************************************************************************
+ *	Description: benchmarking suites for websocket and websocket secure modules.
+ *               Benchmarks are disabled by default to keep the testing run short, to run them:
+ *               --gtest_also_run_disabled_tests --gtest_filter=WSBENCHMARK.*
+ ***********************************************************************************************************************/
+#pragma once
+/************************************************************************************************************************
+ *                     							   INCLUDES
+ ***********************************************************************************************************************/
+#include "tests.h"
+#include <iomanip>
+#include <ctime>
+
+unsigned short benchmark_port = 8090;
+/************************************************************************************************************************
+ *                     						    BENCHMARK HELPERS
+ ***********************************************************************************************************************/
+using benchmark_clock = std::chrono::steady_clock;
+//threads counts to benchmark, powers of 2 up to the number of cores and the number of cores itself
+static std::vector<std::size_t> Benchmark_Threads_Counts(void)
+{
+    std::size_t cores = std::max(1u,std::thread::hardware_concurrency());
+    std::vector<std::size_t> counts;
+    for(std::size_t threads_num=1;threads_num<cores;threads_num*=2)
+        counts.push_back(threads_num);
+    counts.push_back(cores);
+    return counts;
+}
+//elapsed time since "start" in seconds
+static double Benchmark_Seconds(benchmark_clock::time_point start)
+{
+    return std::chrono::duration<double>(benchmark_clock::now()-start).count();
+}
+//read all messages from sessions 1..sessions_num until "expected" messages are read or timeout, returns messages read
+static std::size_t Benchmark_Drain(server_abstract* bench_server,int sessions_num,std::size_t expected,std::chrono::seconds timeout)
+{
+    std::size_t received = 0;
+    auto deadline = benchmark_clock::now() + timeout;
+    while(received < expected && benchmark_clock::now() < deadline)
+    {
+        for(int id=1;id<=sessions_num;++id)
+        {
+            while(bench_server->check_inbox(id))
+            {
+                bench_server->read_message(id);
+                ++received;
+            }
+        }
+    }
+    return received;
+}
+//TCP relay of one connection from "relay_port" to "target_port", counts the bytes on the wire of both directions
+class benchmark_relay
+{
+private:
+    net::io_context relay_ctx;
+    tcp::acceptor acceptor;
+    tcp::socket downstream;
+    tcp::socket upstream;
+    std::thread relay_thread;   //accepts, connects then pumps downstream bytes
+    static void pump(tcp::socket& from,tcp::socket& to,std::atomic<std::size_t>& bytes)
+    {
+        std::vector<char> buffer(64*1024);
+        boost::system::error_code errcode;
+        while(true)
+        {
+            std::size_t read_size = from.read_some(net::buffer(buffer),errcode);
+            if(errcode)
+                break;
+            bytes += read_size;
+            net::write(to,net::buffer(buffer.data(),read_size),errcode);
+            if(errcode)
+                break;
+        }
+        to.shutdown(tcp::socket::shutdown_send,errcode);
+    }
+public:
+    std::atomic<std::size_t> bytes = 0;
+    benchmark_relay(unsigned short relay_port,unsigned short target_port)
+        : acceptor(relay_ctx,tcp::endpoint(net::ip::make_address(ip),relay_port)), downstream(relay_ctx), upstream(relay_ctx)
+    {
+        relay_thread = std::thread([this,target_port]()
+        {
+            boost::system::error_code errcode;
+            acceptor.accept(downstream,errcode);
+            if(!errcode)
+                upstream.connect(tcp::endpoint(net::ip::make_address(ip),target_port),errcode);
+            if(errcode)
+                return;
+            std::thread upstream_pump([this](){pump(upstream,downstream,bytes);});
+            pump(downstream,upstream,bytes);
+            upstream_pump.join();
+        });
+    }
+    ~benchmark_relay(void)
+    {
+        relay_thread.join();
+    }
+};
+/************************************************************************************************************************
+ *                     						WEBSOCKET BENCHMARKS
+ ***********************************************************************************************************************/
+TEST(WSBENCHMARK, DISABLED_ThreadsScaling)  //connection capacity and messages throughput against io threads count
+{
+    const int clients_num = 32;
+    const int messages_num = 20;
+    ws_server::Destroy(server);    //destroy the already created server
+    server = nullptr;
+    ws_server* bench_server = ws_server::GetInstance(benchmark_port,clients_num);
+    std::cout << std::setw(10) << "threads" << std::setw(10) << "sessions" << std::setw(15) << "connects/s" << std::setw(15) << "messages/s" << std::endl;
+    for(std::size_t threads_num : Benchmark_Threads_Counts())
+    {
+        bench_server->set_io_threads(threads_num);
+        bench_server->start();
+        ASSERT_TRUE(bench_server->is_running());
+        std::vector<std::shared_ptr<client_abstract>> clients;
+        for(int i=0;i<clients_num;++i)
+            clients.push_back(std::make_shared<ws_client>());
+        std::vector<std::thread> workers;
+        auto connect_start = benchmark_clock::now();
+        for(auto& client : clients)
+            workers.emplace_back([&client](){client->connect(ip,benchmark_port);});
+        for(auto& worker : workers)
+            worker.join();
+        double connect_time = Benchmark_Seconds(connect_start);
+        int sessions_num = bench_server->sessions_count();  //connections established within the handshake timeout
+        workers.clear();
+        auto send_start = benchmark_clock::now();
+        for(auto& client : clients)
+            workers.emplace_back([&client,messages_num](){for(int i=0;i<messages_num;++i) client->send_message(tx_sample1);});
+        std::size_t received = Benchmark_Drain(bench_server,clients_num,sessions_num*messages_num,std::chrono::seconds(60));
+        double send_time = Benchmark_Seconds(send_start);
+        for(auto& worker : workers)
+            worker.join();
+        std::cout << std::setw(10) << threads_num << std::setw(10) << sessions_num << std::setw(15) << std::fixed << std::setprecision(1) << sessions_num/connect_time
+                  << std::setw(15) << received/send_time << std::endl;
+        for(auto& client : clients)
+            client->disconnect();
+        bench_server->stop();
+    }
+    ws_server::Destroy(bench_server);
+    bench_server = nullptr;
+    server = ws_server::GetInstance(8081,4);  //bring back the old server options
+}
+/*=====================================================================================================================*/
+TEST(WSBENCHMARK, DISABLED_AcceptRate)  //accepted connections per second against outstanding accepts count
+{
+    const int clients_num = 100;
+    ws_server::Destroy(server);    //destroy the already created server
+    server = nullptr;
+    ws_server* bench_server = ws_server::GetInstance(benchmark_port,clients_num);
+    struct accept_mode {const char* name; bool reuse_port; std::size_t accepts_num;};
+    std::cout << std::setw(12) << "acceptors" << std::setw(10) << "accepts" << std::setw(10) << "sessions" << std::setw(15) << "accepts/s" << std::endl;
+    for(accept_mode mode : {accept_mode{"single",false,1},accept_mode{"single",false,4},accept_mode{"single",false,16},
+                            accept_mode{"reuseport",true,16}})
+    {
+        bench_server->set_io_sharding(mode.reuse_port);    //SO_REUSEPORT acceptors are opened per io shard
+        bench_server->set_reuse_port(mode.reuse_port);
+        bench_server->set_accept_concurrency(mode.accepts_num);
+        bench_server->set_listen_backlog(clients_num);
+        bench_server->start();
+        ASSERT_TRUE(bench_server->is_running());
+        std::vector<std::shared_ptr<client_abstract>> clients;
+        for(int i=0;i<clients_num;++i)
+            clients.push_back(std::make_shared<ws_client>());
+        std::vector<std::thread> workers;
+        auto accept_start = benchmark_clock::now();
+        for(auto& client : clients) //reconnect storm, all clients connect at once
+            workers.emplace_back([&client](){client->connect(ip,benchmark_port);});
+        auto deadline = accept_start + std::chrono::seconds(60);
+        while(bench_server->sessions_count() < clients_num && benchmark_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        double accept_time = Benchmark_Seconds(accept_start);
+        int sessions_num = bench_server->sessions_count();
+        for(auto& worker : workers)
+            worker.join();
+        std::cout << std::setw(12) << mode.name << std::setw(10) << mode.accepts_num << std::setw(10) << sessions_num << std::setw(15) << std::fixed
+                  << std::setprecision(1) << sessions_num/accept_time << std::endl;
+        for(auto& client : clients)
+            client->disconnect();
+        bench_server->stop();
+    }
+    bench_server->set_io_sharding(false);   //back to default options
+    bench_server->set_reuse_port(false);
+    bench_server->set_accept_concurrency(0);
+    bench_server->set_listen_backlog(net::socket_base::max_listen_connections);
+    ws_server::Destroy(bench_server);
+    bench_server = nullptr;
+    server = ws_server::GetInstance(8081,4);  //bring back the old server options
+}
+/*=====================================================================================================================*/
+TEST(WSBENCHMARK, DISABLED_SessionsCalls)  //server calls per second from many threads, each thread on its own sessions
+{
+    const int clients_num = 64;
+    const auto duration = std::chrono::seconds(1);
+    ws_server::Destroy(server);    //destroy the already created server
+    server = nullptr;
+    ws_server* bench_server = ws_server::GetInstance(benchmark_port,clients_num);
+    bench_server->start();
+    ASSERT_TRUE(bench_server->is_running());
+    std::vector<std::shared_ptr<client_abstract>> clients;
+    for(int i=0;i<clients_num;++i)
+    {
+        clients.push_back(std::make_shared<ws_client>());
+        clients.back()->connect(ip,benchmark_port);
+    }
+    int sessions_num = bench_server->sessions_count();
+    std::cout << std::setw(10) << "threads" << std::setw(10) << "sessions" << std::setw(15) << "lookups/s" << std::setw(15) << "sends/s" << std::endl;
+    for(std::size_t threads_num : Benchmark_Threads_Counts())
+    {
+        std::atomic<std::size_t> lookups = 0;
+        std::atomic<std::size_t> sends = 0;
+        std::vector<std::thread> workers;
+        auto lookup_start = benchmark_clock::now();
+        for(std::size_t t=0;t<threads_num;++t)  //check_session, check_inbox and read_message calls
+            workers.emplace_back([&,t]()
+            {
+                std::size_t calls = 0;
+                while(benchmark_clock::now() - lookup_start < duration)
+                    for(int id=1+t;id<=sessions_num;id+=threads_num)
+                    {
+                        bench_server->check_session(id);
+                        bench_server->check_inbox(id);
+                        bench_server->read_message(id);
+                        calls += 3;
+                    }
+                lookups += calls;
+            });
+        for(auto& worker : workers)
+            worker.join();
+        double lookup_time = Benchmark_Seconds(lookup_start);
+        workers.clear();
+        auto send_start = benchmark_clock::now();
+        for(std::size_t t=0;t<threads_num;++t)  //send_message calls
+            workers.emplace_back([&,t]()
+            {
+                std::size_t calls = 0;
+                while(benchmark_clock::now() - send_start < duration)
+                    for(int id=1+t;id<=sessions_num && benchmark_clock::now() - send_start < duration;id+=threads_num)
+                    {
+                        bench_server->send_message(id,tx_sample1);
+                        ++calls;
+                    }
+                sends += calls;
+            });
+        for(auto& worker : workers)
+            worker.join();
+        double send_time = Benchmark_Seconds(send_start);
+        std::cout << std::setw(10) << threads_num << std::setw(10) << sessions_num << std::setw(15) << std::fixed << std::setprecision(1)
+                  << lookups/lookup_time << std::setw(15) << sends/send_time << std::endl;
+    }
+    for(auto& client : clients)
+        client->disconnect();
+    ws_server::Destroy(bench_server);
+    bench_server = nullptr;
+    server = ws_server::GetInstance(8081,4);  //bring back the old server options
+}
+/*=====================================================================================================================*/
+TEST(WSBENCHMARK, DISABLED_MessageLatency)  //round trip time of a message echoed back by the server
+{
+    const int messages_num = 1000;
+    ws_server::Destroy(server);    //destroy the already created server
+    server = nullptr;
+    ws_server* bench_server = ws_server::GetInstance(benchmark_port,1);
+    bench_server->set_on_message([bench_server](int id,std::vector<unsigned char>&& message){bench_server->send_message(id,message);});
+    bench_server->start();
+    ASSERT_TRUE(bench_server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    ASSERT_TRUE(client->connect(ip,benchmark_port));
+    int echoed = 0;
+    auto echo_start = benchmark_clock::now();
+    for(int i=0;i<messages_num;++i)
+    {
+        client->send_message(tx_sample1);
+        auto deadline = benchmark_clock::now() + std::chrono::seconds(1);
+        while(!client->check_inbox() && benchmark_clock::now() < deadline);
+        if(!client->read_message().empty())
+            ++echoed;
+    }
+    double echo_time = Benchmark_Seconds(echo_start);
+    std::cout << std::setw(10) << "messages" << std::setw(15) << "round trip us" << std::endl;
+    std::cout << std::setw(10) << echoed << std::setw(15) << std::fixed << std::setprecision(1) << echo_time*1e6/messages_num << std::endl;
+    client->disconnect();
+    bench_server->set_on_message(nullptr);
+    ws_server::Destroy(bench_server);
+    bench_server = nullptr;
+    server = ws_server::GetInstance(8081,4);  //bring back the old server options
+}
+/*=====================================================================================================================*/
+TEST(WSBENCHMARK, DISABLED_BatchSend)  //messages per second of small messages bursts, sent one by one and in batches
+{
+    const int bursts_num = 20;
+    const int burst_size = 500;
+    ws_server::Destroy(server);    //destroy the already created server
+    server = nullptr;
+    ws_server* bench_server = ws_server::GetInstance(benchmark_port,1);
+    bench_server->start();
+    ASSERT_TRUE(bench_server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    ASSERT_TRUE(client->connect(ip,benchmark_port));
+    std::vector<std::vector<unsigned char>> burst(burst_size,std::vector<unsigned char>(100,'x'));  //100 bytes telemetry messages
+    std::cout << std::setw(10) << "mode" << std::setw(15) << "messages/s" << std::endl;
+    for(bool batched : {false,true})
+    {
+        auto send_start = benchmark_clock::now();
+        for(int i=0;i<bursts_num;++i)
+        {
+            if(batched)
+                client->send_messages(burst);
+            else
+                for(const auto& message : burst)
+                    client->send_message(message);
+        }
+        std::size_t received = Benchmark_Drain(bench_server,1,bursts_num*burst_size,std::chrono::seconds(60));
+        double send_time = Benchmark_Seconds(send_start);
+        std::cout << std::setw(10) << (batched ? "batch" : "single") << std::setw(15) << std::fixed << std::setprecision(1)
+                  << received/send_time << std::endl;
+    }
+    client->disconnect();
+    ws_server::Destroy(bench_server);
+    bench_server = nullptr;
+    server = ws_server::GetInstance(8081,4);  //bring back the old server options
+}
+/*=====================================================================================================================*/
+TEST(WSBENCHMARK, DISABLED_Compression)  //CPU time per message and bytes on the wire of JSON messages with and without permessage-deflate
+{
+    const int messages_num = 2000;
+    const unsigned short relay_port = benchmark_port + 1;
+    std::vector<std::vector<unsigned char>> feed;   //~2KB JSON messages of changing prices and volumes
+    std::size_t payload_bytes = 0;
+    for(int i=0;i<messages_num;++i)
+    {
+        std::string json = "[";
+        for(int record=0;record<25;++record)
+            json += "{\"symbol\":\"SYM" + std::to_string(record) + "\",\"price\":" + std::to_string(100+(i*7+record*13)%500) +
+                    "." + std::to_string((i+record)%100) + ",\"volume\":" + std::to_string((i*31+record)%10000) + ",\"side\":\"" +
+                    ((i+record)%2 ? "buy" : "sell") + "\"},";
+        json.back() = ']';
+        feed.emplace_back(json.begin(),json.end());
+        payload_bytes += json.size();
+    }
+    ws_server::Destroy(server);    //destroy the already created server
+    server = nullptr;
+    ws_server* bench_server = ws_server::GetInstance(benchmark_port,1);
+    std::cout << std::setw(18) << "mode" << std::setw(15) << "messages/s" << std::setw(15) << "CPU us/msg"
+              << std::setw(15) << "wire B/msg" << std::setw(10) << "ratio" << std::endl;
+    deflate_options no_takeover;
+    no_takeover.enabled = true;
+    no_takeover.no_context_takeover = true;
+    deflate_options fastest;
+    fastest.enabled = true;
+    fastest.compression_level = 1;
+    std::vector<std::pair<std::string,deflate_options>> modes = {{"off",deflate_options()},{"on",deflate_options()},
+                                                                  {"on, level 1",fastest},{"on, no takeover",no_takeover}};
+    modes.at(1).second.enabled = true;
+    for(const auto& mode : modes)
+    {
+        bench_server->set_compression(mode.second);
+        bench_server->start();
+        ASSERT_TRUE(bench_server->is_running());
+        {
+            benchmark_relay relay(relay_port,benchmark_port);
+            std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+            client->set_compression(mode.second);
+            ASSERT_TRUE(client->connect(ip,relay_port));
+            std::size_t handshake_bytes = relay.bytes.load();
+            std::clock_t cpu_start = std::clock();
+            auto send_start = benchmark_clock::now();
+            for(const auto& message : feed)
+                client->send_message(message);
+            std::size_t received = Benchmark_Drain(bench_server,1,messages_num,std::chrono::seconds(60));
+            double send_time = Benchmark_Seconds(send_start);
+            double cpu_time = double(std::clock()-cpu_start)/CLOCKS_PER_SEC;  //deflate of the client and inflate of the server
+            std::size_t wire_bytes = relay.bytes.load() - handshake_bytes;
+            std::cout << std::setw(18) << mode.first << std::setw(15) << std::fixed << std::setprecision(1) << received/send_time
+                      << std::setw(15) << cpu_time*1e6/messages_num << std::setw(15) << double(wire_bytes)/messages_num
+                      << std::setw(10) << double(payload_bytes)/wire_bytes << std::endl;
+            client->disconnect();
+        }
+        bench_server->stop();
+    }
+    bench_server->set_compression(deflate_options());
+    ws_server::Destroy(bench_server);
+    bench_server = nullptr;
+    server = ws_server::GetInstance(8081,4);  //bring back the old server options
+}
+/*=====================================================================================================================*/
+TEST(WSBENCHMARK, DISABLED_UTF8Validation)  //UTF-8 validation speed of large text messages against copying them
+{
+    const int rounds_num = 200;
+    std::string text_pattern = "{\"name\":\"caf\xC3\xA9\",\"price\":\"12 \xE2\x82\xAC\",\"mood\":\"\xF0\x9F\x98\x80\",\"note\":\"plain ascii text\"},";
+    std::vector<unsigned char> text;
+    while(text.size() < 1024*1024)  //1MB text message, mostly ASCII
+        text.insert(text.end(),text_pattern.begin(),text_pattern.end());
+    std::vector<unsigned char> copy_target(text.size());
+    std::vector<std::pair<std::string,std::function<bool(const unsigned char*,std::size_t)>>> validators =
+    {
+        {"memcpy",[&copy_target](const unsigned char* data,std::size_t size){std::memcpy(copy_target.data(),data,size);return copy_target[0] != 0;}},
+        {"scalar",Validate_UTF8_Scalar}
+    };
+#ifdef UTF8_SIMD_VALIDATOR
+    if(__builtin_cpu_supports("ssse3"))
+        validators.push_back({"ssse3",Validate_UTF8_SSSE3});
+    if(__builtin_cpu_supports("avx2"))
+        validators.push_back({"avx2",Validate_UTF8_AVX2});
+#endif
+    std::cout << std::setw(10) << "validator" << std::setw(10) << "GB/s" << std::endl;
+    for(const auto& validator : validators)
+    {
+        bool valid = true;
+        auto validate_start = benchmark_clock::now();
+        for(int i=0;i<rounds_num;++i)
+            valid = validator.second(text.data(),text.size()) && valid;
+        double validate_time = Benchmark_Seconds(validate_start);
+        EXPECT_TRUE(valid);
+        std::cout << std::setw(10) << validator.first << std::setw(10) << std::fixed << std::setprecision(2)
+                  << double(text.size())*rounds_num/validate_time/1e9 << std::endl;
+    }
+}
+/*=====================================================================================================================*/
+/************************************************************************************************************************
+ *                     					WEBSOCKET SECURE BENCHMARKS
+ ***********************************************************************************************************************/
+TEST(WSBENCHMARK, DISABLED_SessionResumption)  //reconnections per second and CPU time per handshake with full and resumed TLS handshakes
+{
+    const int reconnects_num = 100;
+    server_secured->start();
+    ASSERT_TRUE(server_secured->is_running());
+    std::cout << std::setw(12) << "mode" << std::setw(18) << "connections/s" << std::setw(18) << "CPU ms/connect"
+              << std::setw(10) << "resumed" << std::endl;
+    for(bool resumption : {false,true})
+    {
+        std::shared_ptr<tls_session_cache> shared_cache = resumption ? std::make_shared<tls_session_cache>() : nullptr;
+        std::shared_ptr<client_abstract> warmup = std::make_shared<wss_client>(client_key_file_path,client_certificate_file_path,server_certificate_file_path);
+        warmup->set_session_cache(shared_cache);    //first full handshake fills the cache
+        ASSERT_TRUE(warmup->connect(ip,8082));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        warmup->disconnect();
+        tls_stats before = server_secured->handshake_stats();
+        std::clock_t cpu_start = std::clock();
+        auto connect_start = benchmark_clock::now();
+        for(int i=0;i<reconnects_num;++i)   //clients reconnecting after a failover, client and server of this process
+        {
+            std::shared_ptr<client_abstract> client = std::make_shared<wss_client>(client_key_file_path,client_certificate_file_path,server_certificate_file_path);
+            client->set_session_cache(shared_cache);
+            EXPECT_TRUE(client->connect(ip,8082));
+            client->disconnect();
+        }
+        double connect_time = Benchmark_Seconds(connect_start);
+        double cpu_time = double(std::clock()-cpu_start)/CLOCKS_PER_SEC;
+        tls_stats after = server_secured->handshake_stats();
+        std::cout << std::setw(12) << (resumption ? "resumed" : "full") << std::setw(18) << std::fixed << std::setprecision(1)
+                  << reconnects_num/connect_time << std::setw(18) << std::setprecision(3) << cpu_time*1e3/reconnects_num
+                  << std::setw(10) << after.resumed_handshakes - before.resumed_handshakes << std::endl;
+    }
+    server_secured->stop();
+}
+/*=====================================================================================================================*/
+TEST(WSBENCHMARK, DISABLED_ClientConstruction)  //secure clients constructed per second with their own TLS context and with a shared one
+{
+    const int clients_num = 1000;
+    std::shared_ptr<const tls_context> shared_tls = tls_context::FromFiles(client_key_file_path,client_certificate_file_path,server_certificate_file_path);
+    std::cout << std::setw(12) << "context" << std::setw(15) << "clients/s" << std::setw(15) << "us/client" << std::endl;
+    for(bool shared : {false,true})
+    {
+        std::vector<std::shared_ptr<client_abstract>> clients;
+        clients.reserve(clients_num);
+        auto construct_start = benchmark_clock::now();
+        for(int i=0;i<clients_num;++i)  //load generator clients, kept alive as they would be
+        {
+            if(shared)
+                clients.push_back(std::make_shared<wss_client>(shared_tls));
+            else
+                clients.push_back(std::make_shared<wss_client>(client_key_file_path,client_certificate_file_path,server_certificate_file_path));
+        }
+        double construct_time = Benchmark_Seconds(construct_start);
+        std::cout << std::setw(12) << (shared ? "shared" : "own") << std::setw(15) << std::fixed << std::setprecision(1)
+                  << clients_num/construct_time << std::setw(15) << construct_time*1e6/clients_num << std::endl;
+    }
+}
@@ -0,0 +1,125 @@
+/************************************************************************************************************************
+ * 	Module: WebSocket Compression Options and Configurations
+ * 	File Name: deflate_conf.h
+ *  Authors: Ahmed Desoky
+ *	Date: 19/1/2025
+ *	*********************************************************************************************************************
+ *	Description: This file includes the compression options shared by the server and the client and the function that
+ *               applies them on a websocket stream. Compression is the "permessage-deflate" extension (RFC 7692),
+ *               negotiated during the websocket handshake, it is used only if both peers offer/accept it.
+ *               Default options:
+ *                          - Compression disabled.
+ *                          - Maximum window bits of 15 (32KB window), the largest and the best compression.
+ *                          - Memory level of 4, compression level of 6.
+ *                          - Context takeover allowed, each message is compressed using the history of former ones.
+ *                          - No minimum message size, all messages are compressed.
+ *               A minimum message size needs a Boost.Beast version supporting it, not 1.74, refer to "Deflate_Supported".
+ *               Text/JSON messages usually compress several times, but every message costs deflate/inflate CPU time,
+ *               and every session allocates its own deflate and inflate states (~ window size + 2^(memory level + 9))
+ *               for its lifetime unless context takeover is disabled.
+ ***********************************************************************************************************************/
+#pragma once
+/************************************************************************************************************************
+ *                     							   INCLUDES
+ ***********************************************************************************************************************/
+#include <cstddef>
+#include <type_traits>
+#include <boost/beast/websocket.hpp>
+/************************************************************************************************************************
+ *                     							   NAMESPACES
+ ***********************************************************************************************************************/
+namespace websocket = boost::beast::websocket;
+/***********************************************************************************************************************
+ *                                                  STRUCTURES
+ ***********************************************************************************************************************/
+struct deflate_options    //permessage-deflate options, the same options are offered by the client and accepted by the server
+{
+    bool enabled = false;   //offer/accept the extension
+    int max_window_bits = 15;   //9..15, LZ77 window size as power of 2 of both directions, smaller saves memory
+    int memory_level = 4;   //1..9, deflate internal state memory, larger is faster with better compression
+    int compression_level = 6;  //0..9, 0 no compression, 1 fastest, 9 best compression
+    bool no_context_takeover = false;   //reset compression history after every message of both directions
+    std::size_t min_message_size = 0;   //messages smaller than this size are sent uncompressed, refused if not supported by Boost
+};
+/************************************************************************************************************************
+* Function Name: Set_Size_Threshold
+* Class name: NONE
+* Access: Public
+* Specifiers: template
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): websocket options reference
+*                  minimum size of compressed messages
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Sets the minimum size of compressed messages if the used Boost.Beast version supports it, its
+*              "permessage_deflate" has "msg_size_threshold" in newer Boost releases. Older versions (as 1.74) have
+*              no way to send a message uncompressed on a compressed stream, the threshold is refused by
+*              "Deflate_Supported" before it gets here.
+************************************************************************************************************************/
+template<typename options_type, typename = void>
+struct has_size_threshold : std::false_type {};
+template<typename options_type>
+struct has_size_threshold<options_type,std::void_t<decltype(std::declval<options_type&>().msg_size_threshold)>> : std::true_type {};
+template<typename options_type>
+void Set_Size_Threshold(options_type& options,std::size_t min_message_size)
+{
+    if constexpr(has_size_threshold<options_type>::value)
+        options.msg_size_threshold = min_message_size;
+}
+/************************************************************************************************************************
+* Function Name: Deflate_Supported
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): compression options as const reference
+* Parameters (out): NONE
+* Return value: false if the options can't be applied by the used Boost.Beast version, else true
+* Description: Checks the compression options before they are set by "set_compression" of the server or the client.
+*              A minimum compressed message size is refused if "permessage_deflate" has no "msg_size_threshold".
+************************************************************************************************************************/
+inline bool Deflate_Supported(const deflate_options& options)
+{
+    return options.min_message_size == 0 || has_size_threshold<websocket::permessage_deflate>::value;
+}
+/************************************************************************************************************************
+* Function Name: Set_Deflate
+* Class name: NONE
+* Access: Public
+* Specifiers: template
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): websocket stream reference
+*                  compression options as const reference
+*                  true for server role, false for client role
+* Parameters (out): NONE
+* Return value: NONE
+* Description: This function sets the permessage-deflate options of a websocket stream according to the given input.
+*              It must be called before the websocket handshake. The server accepts the extension only if enabled and
+*              offered by the client, the client offers it only if enabled. Window bits and context takeover are set for
+*              both directions, out of range values are clamped to their valid ranges.
+************************************************************************************************************************/
+template<typename stream_type>
+void Set_Deflate(stream_type& stream,const deflate_options& options,bool server_role)
+{
+    websocket::permessage_deflate deflate;
+    int window_bits = options.max_window_bits < 9 ? 9 : (options.max_window_bits > 15 ? 15 : options.max_window_bits);
+    deflate.server_enable = server_role && options.enabled;
+    deflate.client_enable = !server_role && options.enabled;
+    deflate.server_max_window_bits = window_bits;
+    deflate.client_max_window_bits = window_bits;
+    deflate.server_no_context_takeover = options.no_context_takeover;
+    deflate.client_no_context_takeover = options.no_context_takeover;
+    deflate.compLevel = options.compression_level < 0 ? 0 : (options.compression_level > 9 ? 9 : options.compression_level);
+    deflate.memLevel = options.memory_level < 1 ? 1 : (options.memory_level > 9 ? 9 : options.memory_level);
+    Set_Size_Threshold(deflate,options.min_message_size);
+    stream.set_option(deflate);
+}
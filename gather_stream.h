@@ -0,0 +1,173 @@
+/************************************************************************************************************************
+ * 	Module: Gathered Writes Stream
+ * 	File Name: gather_stream.h
+ *  Authors: Ahmed Desoky
+ *	Date: 19/1/2025
+ *	*********************************************************************************************************************
+ *	Description: This file includes the stream layer placed beneath the websocket stream of the server sessions and
+ *               the clients, over the TCP socket or over the TLS/SSL stream. It passes reads and writes through to
+ *               its next layer, unless the writes are gathered: between "gather" and "async_flush" the frames
+ *               written by the websocket stream are appended to one buffer and completed at once, then they are
+ *               written together by a single write, one syscall, and over TLS/SSL the least number of records.
+ *               The write pumps gather the small queued messages, refer to "write_gathered".
+ *               The websocket stream writes one frame at a time, so frames it writes by itself while gathering, as
+ *               the pong replying a ping, are appended in order and flushed with the gathered messages.
+ ***********************************************************************************************************************/
+#pragma once
+/************************************************************************************************************************
+ *                     							   INCLUDES
+ ***********************************************************************************************************************/
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/bind_handler.hpp>
+#include <boost/beast/core/role.hpp>
+#include <boost/beast/websocket/teardown.hpp>
+#include <boost/core/ignore_unused.hpp>
+/***********************************************************************************************************************
+ *                                                  CLASSES
+ ***********************************************************************************************************************/
+template<typename next_layer_type>
+class gather_stream //stream layer gathering the written frames on demand, used from its strand only
+{
+private:
+    next_layer_type next;   //TCP socket or TLS/SSL stream
+    std::vector<unsigned char> gathered;    //frames written since "gather" or during the flush, not sent yet
+    std::vector<unsigned char> flushing;    //frames being sent by the flush, its capacity is kept for the next ones
+    bool gathering = false; //frames are appended to "gathered" until "async_flush"
+    bool flush_in_progress = false; //frames written meanwhile are appended and sent by the same flush
+    template<typename buffers_type>
+    std::size_t append(const buffers_type& buffers)
+    {
+        std::size_t size = boost::asio::buffer_size(buffers);
+        std::size_t offset = gathered.size();
+        gathered.resize(offset + size);
+        boost::asio::buffer_copy(boost::asio::buffer(gathered.data() + offset,size),buffers);
+        return size;
+    }
+    struct flush_op //writes the gathered frames until none is left, then completes the flush
+    {
+        gather_stream& stream;
+        template<typename self_type>
+        void operator()(self_type& self, boost::system::error_code errcode = {}, std::size_t bytes_sent = 0)
+        {
+            boost::ignore_unused(bytes_sent);
+            if(!errcode && !stream.gathered.empty())
+            {
+                stream.flushing.clear();
+                stream.flushing.swap(stream.gathered);
+                boost::asio::async_write(stream.next,boost::asio::buffer(stream.flushing),std::move(self));
+                return;
+            }
+            stream.flush_in_progress = false;
+            stream.gathered.clear();    //not sent after a failure
+            self.complete(errcode);
+        }
+    };
+public:
+    using executor_type = typename next_layer_type::executor_type;
+    template<typename... args_type>
+    explicit gather_stream(args_type&&... args) : next(std::forward<args_type>(args)...) {}
+    executor_type get_executor(void) {return next.get_executor();}
+    next_layer_type& next_layer(void) {return next;}
+    const next_layer_type& next_layer(void) const {return next;}
+    void gather(void) {gathering = true;}   //frames written next are gathered until "async_flush"
+/************************************************************************************************************************
+* Function Name: async_flush
+* Class name: gather_stream
+* Access: Public
+* Specifiers: template
+* Running Thread: Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Non-Reentrant, called from the strand of the stream only
+* Expected  Exception: No
+* Parameters (in): completion handler, called with the error code of the write
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Stops gathering and writes the gathered frames in one write. Frames written by the websocket stream
+*              before it completes are appended and written by the same flush, in order.
+************************************************************************************************************************/
+    template<typename handler_type>
+    auto async_flush(handler_type&& handler)
+    {
+        gathering = false;
+        flush_in_progress = true;
+        return boost::asio::async_compose<handler_type,void(boost::system::error_code)>(flush_op{*this},handler,next);
+    }
+    template<typename buffers_type, typename handler_type>
+    auto async_write_some(const buffers_type& buffers, handler_type&& handler)
+    {
+        return boost::asio::async_initiate<handler_type,void(boost::system::error_code,std::size_t)>(
+            [this](auto&& write_handler, const buffers_type& frame_buffers)
+        {
+            if(!gathering && !flush_in_progress)
+            {
+                next.async_write_some(frame_buffers,std::move(write_handler));
+                return;
+            }
+            std::size_t size = append(frame_buffers);   //completed at once, sent by the flush
+            boost::asio::post(get_executor(),boost::beast::bind_front_handler(std::move(write_handler),boost::system::error_code(),size));
+        },handler,buffers);
+    }
+    template<typename buffers_type, typename handler_type>
+    auto async_read_some(const buffers_type& buffers, handler_type&& handler)
+    {
+        return next.async_read_some(buffers,std::forward<handler_type>(handler));
+    }
+    template<typename buffers_type>
+    std::size_t write_some(const buffers_type& buffers, boost::system::error_code& errcode)
+    {
+        if(!gathering && !flush_in_progress)
+            return next.write_some(buffers,errcode);
+        errcode = {};
+        return append(buffers);
+    }
+    template<typename buffers_type>
+    std::size_t write_some(const buffers_type& buffers)
+    {
+        if(!gathering && !flush_in_progress)
+            return next.write_some(buffers);
+        return append(buffers);
+    }
+    template<typename buffers_type>
+    std::size_t read_some(const buffers_type& buffers, boost::system::error_code& errcode)
+    {
+        return next.read_some(buffers,errcode);
+    }
+    template<typename buffers_type>
+    std::size_t read_some(const buffers_type& buffers)
+    {
+        return next.read_some(buffers);
+    }
+};
+/************************************************************************************************************************
+* Function Name: teardown, async_teardown
+* Class name: NONE
+* Access: Public
+* Specifiers: template
+* Running Thread: Pool thread or Caller thread
+* Sync/Async: Synchronous, Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): role of the websocket stream, the gather stream reference, error code reference or completion handler
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Close the connection of the next layer after the websocket closing handshake, TCP shutdown or TLS/SSL
+*              shutdown then TCP shutdown. Found by the websocket stream through argument dependent lookup.
+************************************************************************************************************************/
+template<typename next_layer_type>
+void teardown(boost::beast::role_type role, gather_stream<next_layer_type>& stream, boost::system::error_code& errcode)
+{
+    using boost::beast::websocket::teardown;
+    teardown(role,stream.next_layer(),errcode);
+}
+template<typename next_layer_type, typename handler_type>
+void async_teardown(boost::beast::role_type role, gather_stream<next_layer_type>& stream, handler_type&& handler)
+{
+    using boost::beast::websocket::async_teardown;
+    async_teardown(role,stream.next_layer(),std::forward<handler_type>(handler));
+}
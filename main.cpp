@@ -1,5 +1,6 @@
 #include <QCoreApplication>
 #include "tests.h"
+#include "benchmarks.h"
 int main(int argc, char *argv[])
 {
     testing::InitGoogleTest(&argc,argv);
@@ -0,0 +1,165 @@
+/************************************************************************************************************************
+ * 	Module: Memory Mapped Files
+ * 	File Name: mapped_file.h
+ *  Authors: Ahmed Desoky
+ *	Date: 19/1/2025
+ *	*********************************************************************************************************************
+ *	Description: This file includes the read-only memory mapping of a file range and the fragments source that streams
+ *               it as a websocket message, used by "send_file" of the server and the client.
+ *               The file pages are written to the stream straight from the mapping, loaded by the kernel as they are
+ *               touched and reclaimable at any time, so a file of any size is sent without reading it into memory.
+ *               The mapping is released once the message is written or aborted. POSIX only.
+ *               Like every streamed message, the file is sent in binary frames whatever the connection's frames type.
+ *               The file must not be truncated while it is sent, accessing the truncated pages raises SIGBUS.
+ ***********************************************************************************************************************/
+#pragma once
+/************************************************************************************************************************
+ *                     							   INCLUDES
+ ***********************************************************************************************************************/
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <boost/asio/buffer.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+/***********************************************************************************************************************
+ *                                                  ALIASES
+ ***********************************************************************************************************************/
+using fragment_source = std::function<boost::asio::const_buffer(std::size_t)>; //next fragment of a streamed message of up to the given size, empty at the end
+/***********************************************************************************************************************
+ *                                                  CLASSES
+ ***********************************************************************************************************************/
+class mapped_file   //read-only mapping of a file range, unmapped at destruction
+{
+private:
+    void* mapping = MAP_FAILED; //start of the mapping, aligned to the page below the range
+    std::size_t mapping_size = 0;   //size of the mapping
+    const unsigned char* range = nullptr;   //start of the mapped range
+    std::size_t range_size = 0; //size of the mapped range
+public:
+    mapped_file(void) = default;
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file()
+    {
+        if(mapping != MAP_FAILED)
+            munmap(mapping,mapping_size);
+    }
+    const unsigned char* data(void) const {return range;}
+    std::size_t size(void) const {return range_size;}
+/************************************************************************************************************************
+* Function Name: open
+* Class name: mapped_file
+* Access: Public
+* Specifiers: static
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): file path
+*                  offset of the range in the file
+*                  size of the range, 0 for the rest of the file
+* Parameters (out): NONE
+* Return value: shared pointer to the mapped range, nullptr if the file can't be opened or mapped or the range
+*               exceeds the file
+* Description: This function maps a file range for reading. The mapping starts at the page holding the offset, as
+*              required by "mmap", and the kernel is advised of sequential access to read ahead and drop pages
+*              behind. The file descriptor is closed once mapped. An empty range is valid and maps nothing.
+************************************************************************************************************************/
+    static std::shared_ptr<const mapped_file> open(const std::string& path, std::size_t offset, std::size_t length)
+    {
+        int file_descriptor = ::open(path.c_str(),O_RDONLY | O_CLOEXEC);
+        if(file_descriptor < 0)
+            return nullptr;
+        struct stat file_status;
+        if(fstat(file_descriptor,&file_status) != 0 || !S_ISREG(file_status.st_mode)
+            || offset > static_cast<std::size_t>(file_status.st_size))
+        {
+            ::close(file_descriptor);
+            return nullptr;
+        }
+        std::size_t file_size = static_cast<std::size_t>(file_status.st_size);
+        if(length == 0) //rest of the file
+            length = file_size - offset;
+        if(length > file_size - offset)
+        {
+            ::close(file_descriptor);
+            return nullptr;
+        }
+        auto file = std::make_shared<mapped_file>();
+        if(length != 0)
+        {
+            std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            std::size_t page_offset = offset - offset % page_size;  //mmap offset must be page aligned
+            file->mapping_size = length + (offset - page_offset);
+            file->mapping = mmap(nullptr,file->mapping_size,PROT_READ,MAP_PRIVATE,file_descriptor,static_cast<off_t>(page_offset));
+            if(file->mapping == MAP_FAILED)
+            {
+                ::close(file_descriptor);
+                return nullptr;
+            }
+            madvise(file->mapping,file->mapping_size,MADV_SEQUENTIAL);
+            file->range = static_cast<const unsigned char*>(file->mapping) + (offset - page_offset);
+            file->range_size = length;
+        }
+        ::close(file_descriptor);   //the mapping keeps the file
+        return file;
+    }
+};
+/************************************************************************************************************************
+* Function Name: File_Fragments
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): mapped file range
+* Parameters (out): NONE
+* Return value: fragments source of the mapped range
+* Description: This function returns the source of the fragments of a mapped file range, each fragment points into
+*              the mapping, no bytes are copied. The source holds the mapping until it is released after the message
+*              is written.
+************************************************************************************************************************/
+inline fragment_source File_Fragments(std::shared_ptr<const mapped_file> file)
+{
+    return [file = std::move(file),position = std::size_t(0)](std::size_t max_size) mutable
+    {
+        std::size_t fragment_size = std::min(max_size,file->size() - position);
+        boost::asio::const_buffer fragment(file->data() + position,fragment_size);
+        position += fragment_size;
+        return fragment;
+    };
+}
+/************************************************************************************************************************
+* Function Name: Buffered_Fragments
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): source filling a given buffer with the next fragment, returns its size, 0 at the end
+* Parameters (out): NONE
+* Return value: fragments source of the filled fragments
+* Description: This function adapts a source filling the caller's buffer to a fragments source. The buffer is
+*              allocated at the first fragment and reused for the next ones.
+************************************************************************************************************************/
+inline fragment_source Buffered_Fragments(std::function<std::size_t(unsigned char*,std::size_t)> source)
+{
+    auto chunk = std::make_shared<std::vector<unsigned char>>();
+    return [source = std::move(source),chunk](std::size_t max_size)
+    {
+        if(chunk->size() != max_size)
+            chunk->resize(max_size);
+        std::size_t fragment_size = std::min(source(chunk->data(),max_size),max_size);
+        return boost::asio::const_buffer(chunk->data(),fragment_size);
+    };
+}
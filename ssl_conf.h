@@ -12,6 +12,10 @@
  *                          - No SSL versions.
  *                          - Asymmetric private key for DH.
  *                          - Digital Certificates verification (Optional). 2 function overloaded for this option
+ *               Encryption is done in userspace by OpenSSL, kernel TLS offload (kTLS, "SSL_OP_ENABLE_KTLS") is not
+ *               supported: Boost.Asio SSL streams drive OpenSSL through a memory BIO pair, and OpenSSL hands the keys to
+ *               the kernel only through a socket BIO while it derives them during the handshake. Enabling it on these
+ *               contexts has no effect, it would need a TLS transport other than "ssl::stream".
  *               If you want to add your options and configurations please go to this webpage
  *               -> https://beta.boost.org/doc/libs/1_66_0/doc/html/boost_asio/reference/ssl__context.html
  ***********************************************************************************************************************/
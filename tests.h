@@ -13,6 +13,14 @@
 #include "websockets_server.h"
 #include "websockets_client.h"
 #include <gtest/gtest.h>
+#include <boost/asio/use_future.hpp>
+#include <fstream>
+#include <sstream>
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/detached.hpp>
+#endif
 
 
 std::string server_key_file_path = "../../credentials/server-key.pem";
@@ -152,15 +160,15 @@ TEST(WSTESTING, MultipleClientsMultipleMessages) //Test Case #5
     EXPECT_TRUE(client3->check_connection());
     EXPECT_EQ(server_secured->sessions_count(),3);
     //Server send messages
-    EXPECT_TRUE(server_secured->send_message(1,tx_sample1));
-    EXPECT_TRUE(server_secured->send_message(1,tx_sample2));
-    EXPECT_TRUE(server_secured->send_message(1,tx_sample3));
-    EXPECT_TRUE(server_secured->send_message(2,tx_sample1));
-    EXPECT_TRUE(server_secured->send_message(2,tx_sample2));
-    EXPECT_TRUE(server_secured->send_message(2,tx_sample3));
-    EXPECT_TRUE(server_secured->send_message(3,tx_sample1));
-    EXPECT_TRUE(server_secured->send_message(3,tx_sample2));
-    EXPECT_TRUE(server_secured->send_message(3,tx_sample3));
+    EXPECT_EQ(server_secured->send_message(1,tx_sample1),send_status::queued);
+    EXPECT_EQ(server_secured->send_message(1,tx_sample2),send_status::queued);
+    EXPECT_EQ(server_secured->send_message(1,tx_sample3),send_status::queued);
+    EXPECT_EQ(server_secured->send_message(2,tx_sample1),send_status::queued);
+    EXPECT_EQ(server_secured->send_message(2,tx_sample2),send_status::queued);
+    EXPECT_EQ(server_secured->send_message(2,tx_sample3),send_status::queued);
+    EXPECT_EQ(server_secured->send_message(3,tx_sample1),send_status::queued);
+    EXPECT_EQ(server_secured->send_message(3,tx_sample2),send_status::queued);
+    EXPECT_EQ(server_secured->send_message(3,tx_sample3),send_status::queued);
     EXPECT_FALSE(server_secured->check_session(4));
     EXPECT_FALSE(server_secured->check_session(5));
     EXPECT_FALSE(server_secured->check_session(6));
@@ -168,6 +176,7 @@ TEST(WSTESTING, MultipleClientsMultipleMessages) //Test Case #5
     client1->send_message(tx_sample1);
     client2->send_message(tx_sample2);
     client3->send_message(tx_sample3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); //messages are written asynchronously
     //server read clients' messages
     EXPECT_TRUE(server_secured->check_inbox(1));
     rx_sample1 = server_secured->read_message(1);
@@ -268,8 +277,9 @@ TEST(WSSTESTING, ConnectDisconnectCornerCases) //Test Case #6
     EXPECT_EQ(server_less_secure->sessions_count(),1);
     EXPECT_TRUE(server_less_secure->check_session(1));
     EXPECT_FALSE(server_less_secure->check_session(2));
-    EXPECT_TRUE(server_less_secure->send_message(1,tx_sample1));    //send message to session with id=1
-    EXPECT_FALSE(server_less_secure->send_message(2,tx_sample1));   //no session with id=2
+    EXPECT_EQ(server_less_secure->send_message(1,tx_sample1),send_status::queued);    //send message to session with id=1
+    EXPECT_EQ(server_less_secure->send_message(2,tx_sample1),send_status::not_found);   //no session with id=2
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); //messages are written asynchronously
     rx_sample1 = client1->read_message();
     rx_sample_string1 = std::string(rx_sample1.begin(),rx_sample1.end());
     EXPECT_STREQ(rx_sample_string1.c_str(),tx_sample_message1.c_str());
@@ -340,3 +350,928 @@ TEST(WSTESTING, ClientSingleConnection) //Test Case #8
     client->disconnect();
     EXPECT_FALSE(client->check_connection());
 }
+/*=====================================================================================================================*/
+TEST(WSTESTING, ShardedServer) //Test Case #9
+{
+    for(bool reuse_port : {false,true}) //single acceptor, then one SO_REUSEPORT acceptor per shard
+    {
+        std::vector<std::shared_ptr<client_abstract>> clients;
+        for(int i=0;i<4;++i)
+            clients.push_back(std::make_shared<ws_client>());
+        server->set_io_threads(2);
+        server->set_io_sharding(true);  //sessions are distributed on 2 io shards
+        server->set_reuse_port(reuse_port);
+        server->start();
+        ASSERT_TRUE(server->is_running());
+        for(auto& client : clients)
+            EXPECT_TRUE(client->connect(ip,8081));
+        EXPECT_EQ(server->sessions_count(),4);
+        for(int id=1;id<=4;++id)
+            EXPECT_EQ(server->send_message(id,tx_sample1),send_status::queued);
+        clients.at(3)->send_message(tx_sample2);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100)); //messages are written asynchronously
+        for(auto& client : clients)
+        {
+            rx_sample1 = client->read_message();
+            rx_sample_string1 = std::string(rx_sample1.begin(),rx_sample1.end());
+            EXPECT_STREQ(rx_sample_string1.c_str(),tx_sample_message1.c_str());
+        }
+        for(int id=1;id<=4;++id)    //client 4 session id depends on shards accepting order
+        {
+            if(!server->check_inbox(id))
+                continue;
+            rx_sample2 = server->read_message(id);
+            rx_sample_string2 = std::string(rx_sample2.begin(),rx_sample2.end());
+            EXPECT_STREQ(rx_sample_string2.c_str(),tx_sample_message2.c_str());
+        }
+        for(auto& client : clients)
+            client->disconnect();
+        EXPECT_EQ(server->sessions_count(),0);
+        server->stop();
+        EXPECT_FALSE(server->is_running());
+    }
+    server->set_reuse_port(false);  //back to default options
+    server->set_io_sharding(false);
+    server->set_io_threads(0);
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, SessionsIdsAllocator) //Test Case #10
+{
+    ids_allocator ids;
+    EXPECT_EQ(ids.acquire(),0); //no IDs yet
+    ids.reset(5000);    //more than one bitmap level
+    for(int id=1;id<=5000;++id)
+        EXPECT_EQ(ids.acquire(),id);
+    EXPECT_EQ(ids.acquire(),0); //all IDs taken
+    ids.release(4097);
+    ids.release(70);
+    ids.release(3);
+    EXPECT_EQ(ids.acquire(),3); //lowest released ID first
+    EXPECT_EQ(ids.acquire(),70);
+    EXPECT_EQ(ids.acquire(),4097);
+    EXPECT_EQ(ids.acquire(),0);
+    ids.clear();
+    EXPECT_EQ(ids.acquire(),0);
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, MessagesCallbacks) //Test Case #11
+{
+    std::mutex callbacks_mutex;
+    std::vector<int> opened_ids, closed_ids;
+    std::vector<std::vector<unsigned char>> server_messages, client_messages;
+    std::atomic<int> client_opened = 0, client_closed = 0;
+    server->set_on_open([&](int id){std::lock_guard<std::mutex> lock(callbacks_mutex); opened_ids.push_back(id);});
+    server->set_on_message([&](int id,std::vector<unsigned char>&& message)
+    {
+        std::lock_guard<std::mutex> lock(callbacks_mutex);
+        server_messages.push_back(std::move(message));
+        boost::ignore_unused(id);
+    });
+    server->set_on_close([&](int id){std::lock_guard<std::mutex> lock(callbacks_mutex); closed_ids.push_back(id);});
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    client->set_on_open([&](){++client_opened;});
+    client->set_on_message([&](std::vector<unsigned char>&& message)
+    {
+        std::lock_guard<std::mutex> lock(callbacks_mutex);
+        client_messages.push_back(std::move(message));
+    });
+    client->set_on_close([&](){++client_closed;});
+    EXPECT_TRUE(client->connect(ip,8081));
+    EXPECT_EQ(client_opened.load(),1);
+    client->send_message(tx_sample1);
+    EXPECT_EQ(server->send_message(1,tx_sample2),send_status::queued);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_FALSE(server->check_inbox(1));   //messages are handed to the callbacks, not queued
+    EXPECT_FALSE(client->check_inbox());
+    {
+        std::lock_guard<std::mutex> lock(callbacks_mutex);
+        ASSERT_EQ(opened_ids.size(),1);
+        EXPECT_EQ(opened_ids.at(0),1);
+        ASSERT_EQ(server_messages.size(),1);
+        EXPECT_EQ(server_messages.at(0),tx_sample1);
+        ASSERT_EQ(client_messages.size(),1);
+        EXPECT_EQ(client_messages.at(0),tx_sample2);
+    }
+    client->disconnect();
+    EXPECT_EQ(client_closed.load(),1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    {
+        std::lock_guard<std::mutex> lock(callbacks_mutex);
+        ASSERT_EQ(closed_ids.size(),1);
+        EXPECT_EQ(closed_ids.at(0),1);
+    }
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    server->set_on_open(nullptr);   //back to default options, messages are queued to the inbox
+    server->set_on_message(nullptr);
+    server->set_on_close(nullptr);
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, AsyncOperations) //Test Case #12
+{
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    EXPECT_NO_THROW(client->async_connect(ip,8081,net::use_future).get());
+    EXPECT_TRUE(client->check_connection());
+    std::future<std::vector<unsigned char>> server_read = server->async_read_message(1,net::use_future); //waits for the message
+    EXPECT_NO_THROW(client->async_send_message(tx_sample1,net::use_future).get());
+    rx_sample1 = server_read.get();
+    EXPECT_EQ(rx_sample1,tx_sample1);
+    EXPECT_NO_THROW(server->async_send_message(1,tx_sample2,net::use_future).get());
+    rx_sample2 = client->async_read_message(net::use_future).get();
+    EXPECT_EQ(rx_sample2,tx_sample2);
+    EXPECT_THROW(server->async_read_message(2,net::use_future).get(),boost::system::system_error);   //no session
+    std::future<std::vector<unsigned char>> pending_read = client->async_read_message(net::use_future);
+    client->disconnect();
+    EXPECT_THROW(pending_read.get(),boost::system::system_error);   //aborted by disconnection
+    net::io_context raw_ctx;
+    tcp::socket half_open(raw_ctx); //TCP connection that never sends the upgrade request
+    half_open.connect(tcp::endpoint(net::ip::make_address(ip),8081));
+    tcp::socket bad_request(raw_ctx);   //TCP connection whose upgrade request is not valid, its handshake fails
+    bad_request.connect(tcp::endpoint(net::ip::make_address(ip),8081));
+    net::write(bad_request,net::buffer(std::string("GET / HTTP/1.1\r\n\r\n")));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(server->sessions_count(),1);  //failed session is released, the half-open one is left
+    boost::system::error_code read_error;
+    std::vector<char> response(1024);
+    while(!read_error)  //the failed session disconnects its client
+        bad_request.read_some(net::buffer(response),read_error);
+    auto calls_start = std::chrono::steady_clock::now();
+    for(int id : {1,2})  //session of the half-open connection is not established, not waited for
+        EXPECT_EQ(server->send_message(id,tx_sample3),send_status::not_found);
+    server->stop(); //its pending handshake is cancelled
+    EXPECT_LT(std::chrono::steady_clock::now() - calls_start,std::chrono::seconds(2));
+    EXPECT_FALSE(server->is_running());
+}
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+/*=====================================================================================================================*/
+TEST(WSTESTING, Coroutines) //Test Case #13
+{
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    net::io_context user_ctx;   //the user's own context running the coroutines
+    net::co_spawn(user_ctx,[&]() -> net::awaitable<void>
+    {
+        co_await client->async_connect(ip,8081,net::use_awaitable);
+        co_await client->async_send_message(tx_sample1,net::use_awaitable);
+        rx_sample1 = co_await server->async_read_message(1,net::use_awaitable);    //request
+        co_await server->async_send_message(1,tx_sample2,net::use_awaitable);  //response
+        rx_sample2 = co_await client->async_read_message(net::use_awaitable);
+    },net::detached);
+    user_ctx.run();
+    EXPECT_EQ(rx_sample1,tx_sample1);
+    EXPECT_EQ(rx_sample2,tx_sample2);
+    client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+}
+#endif
+/*=====================================================================================================================*/
+TEST(WSTESTING, BroadcastMessages) //Test Case #14
+{
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::vector<std::shared_ptr<client_abstract>> clients;
+    for(int i=0;i<3;++i)
+    {
+        clients.push_back(std::make_shared<ws_client>());
+        EXPECT_TRUE(clients.back()->connect(ip,8081));
+    }
+    EXPECT_EQ(server->broadcast(tx_sample1),3);    //to all sessions
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for(auto& client : clients)
+    {
+        ASSERT_TRUE(client->check_inbox());
+        EXPECT_EQ(client->read_message(),tx_sample1);
+    }
+    EXPECT_EQ(server->send_to({1,3,7},tx_sample2),2);  //no session with id=7
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(clients.at(0)->read_message(),tx_sample2);
+    EXPECT_FALSE(clients.at(1)->check_inbox());
+    EXPECT_EQ(clients.at(2)->read_message(),tx_sample2);
+    clients.at(1)->disconnect();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(server->broadcast(tx_sample3),2);    //closed session is skipped
+    net::io_context raw_ctx;
+    tcp::socket half_open(raw_ctx); //TCP connection that never sends the upgrade request
+    half_open.connect(tcp::endpoint(net::ip::make_address(ip),8081));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto broadcast_start = std::chrono::steady_clock::now();
+    EXPECT_EQ(server->broadcast(tx_sample4),2);    //session not established is skipped without waiting
+    EXPECT_LT(std::chrono::steady_clock::now() - broadcast_start,std::chrono::seconds(1));
+    for(auto& client : clients)
+        client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, TopicsPublishing) //Test Case #15
+{
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::vector<std::shared_ptr<client_abstract>> clients;
+    for(int i=0;i<3;++i)
+    {
+        clients.push_back(std::make_shared<ws_client>());
+        EXPECT_TRUE(clients.back()->connect(ip,8081));
+    }
+    EXPECT_TRUE(server->subscribe(1,"prices"));
+    EXPECT_TRUE(server->subscribe(2,"prices"));
+    EXPECT_TRUE(server->subscribe(2,"news"));
+    EXPECT_FALSE(server->subscribe(7,"prices"));    //no session with id=7
+    EXPECT_EQ(server->publish("prices",tx_sample1),2);
+    EXPECT_EQ(server->publish("news",tx_sample2),1);
+    EXPECT_EQ(server->publish("weather",tx_sample3),0); //no subscribers
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(clients.at(0)->read_message(),tx_sample1);
+    EXPECT_EQ(clients.at(1)->read_message(),tx_sample1);
+    EXPECT_EQ(clients.at(1)->read_message(),tx_sample2);
+    EXPECT_FALSE(clients.at(2)->check_inbox());
+    EXPECT_TRUE(server->unsubscribe(1,"prices"));
+    EXPECT_FALSE(server->unsubscribe(1,"prices"));  //already unsubscribed
+    EXPECT_EQ(server->publish("prices",tx_sample3),1);
+    clients.at(1)->disconnect();    //closed session leaves its topics
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(server->publish("prices",tx_sample4),0);
+    EXPECT_EQ(server->publish("news",tx_sample4),0);
+    EXPECT_TRUE(clients.at(1)->connect(ip,8081));   //reconnects on the released id=2, not subscribed
+    EXPECT_EQ(server->publish("prices",tx_sample4),0);
+    for(auto& client : clients)
+        client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, MessagesBurstOrder) //Test Case #16
+{
+    const int messages_num = 200;
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    EXPECT_TRUE(client->connect(ip,8081));
+    for(int i=0;i<messages_num;++i) //back to back, queued while previous messages are written
+    {
+        std::string message = std::to_string(i);
+        client->send_message(std::vector<unsigned char>(message.begin(),message.end()));
+        EXPECT_EQ(server->send_message(1,std::vector<unsigned char>(message.begin(),message.end())),send_status::queued);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for(int i=0;i<messages_num;++i) //received in sending order
+    {
+        std::string message = std::to_string(i);
+        EXPECT_EQ(server->read_message(1),std::vector<unsigned char>(message.begin(),message.end()));
+        EXPECT_EQ(client->read_message(),std::vector<unsigned char>(message.begin(),message.end()));
+    }
+    client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, BatchSend) //Test Case #17
+{
+    std::vector<std::vector<unsigned char>> batch = {tx_sample1,tx_sample2,tx_sample3,tx_sample4};
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    EXPECT_TRUE(client->connect(ip,8081));
+    client->send_messages(batch);
+    EXPECT_EQ(server->send_messages(1,batch),send_status::queued);
+    EXPECT_EQ(server->send_messages(2,batch),send_status::not_found);   //no session with id=2
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); //messages are written asynchronously
+    for(const auto& message : batch)   //received in batch order
+    {
+        EXPECT_EQ(server->read_message(1),message);
+        EXPECT_EQ(client->read_message(),message);
+    }
+    EXPECT_FALSE(server->check_inbox(1));
+    EXPECT_FALSE(client->check_inbox());
+    client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    server_secured->start();    //batches gathered into TLS records
+    ASSERT_TRUE(server_secured->is_running());
+    std::shared_ptr<client_abstract> secured_client = std::make_shared<wss_client>(client_key_file_path,client_certificate_file_path,server_certificate_file_path);
+    EXPECT_TRUE(secured_client->connect(ip,8082));
+    secured_client->send_messages(batch);
+    EXPECT_EQ(server_secured->send_messages(1,batch),send_status::queued);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for(const auto& message : batch)
+    {
+        EXPECT_EQ(server_secured->read_message(1),message);
+        EXPECT_EQ(secured_client->read_message(),message);
+    }
+    secured_client->disconnect();
+    server_secured->stop();
+    EXPECT_FALSE(server_secured->is_running());
+}
+/*=====================================================================================================================*/
+TEST(WSSTESTING, LargeMessages) //Test Case #18
+{
+    std::vector<unsigned char> snapshot(2*1024*1024);   //2MB message, frames are sent as text so it is kept valid UTF-8
+    for(std::size_t i=0;i<snapshot.size();++i)
+        snapshot[i] = static_cast<unsigned char>('A' + i%26);
+    server_secured->start();
+    ASSERT_TRUE(server_secured->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<wss_client>(client_key_file_path,client_certificate_file_path,server_certificate_file_path);
+    EXPECT_TRUE(client->connect(ip,8082));
+    client->send_message(snapshot);
+    client->send_message(tx_sample1);  //small message after the large one
+    EXPECT_EQ(server_secured->send_message(1,snapshot),send_status::queued);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500)); //messages are written asynchronously
+    EXPECT_EQ(server_secured->read_message(1),snapshot);
+    EXPECT_EQ(server_secured->read_message(1),tx_sample1);
+    EXPECT_EQ(client->read_message(),snapshot);
+    client->disconnect();
+    server_secured->stop();
+    EXPECT_FALSE(server_secured->is_running());
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, BuffersPool) //Test Case #19
+{
+    buffer_pool pool(4096);  //cap of 4KB retained
+    std::vector<unsigned char> buffer = pool.acquire(300);  //512 bytes class
+    EXPECT_GE(buffer.capacity(),300);
+    pool.release(std::move(buffer));
+    EXPECT_EQ(pool.stats().retained_bytes,512);
+    buffer = pool.acquire(400); //same class, reused
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(pool.stats().hits,1);
+    EXPECT_EQ(pool.stats().misses,1);
+    pool.release(pool.acquire(8192));   //over the cap, freed
+    EXPECT_EQ(pool.stats().retained_bytes,0);
+    const int messages_num = 50;
+    server->set_on_message([&](int id,std::vector<unsigned char>&& message)
+    {
+        server->send_message(id,message);   //echo, the received buffer is left to the pool
+    });
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    EXPECT_TRUE(client->connect(ip,8081));
+    for(int i=0;i<messages_num;++i)
+    {
+        client->send_message(tx_sample3);
+        EXPECT_EQ(client->async_read_message(net::use_future).get(),tx_sample3);   //waits for the echo
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); //last payload is given back after its write handler
+    buffer_pool_stats stats = server->pool_stats();
+    EXPECT_GT(stats.hits,stats.misses); //buffers are reused in the steady state
+    EXPECT_GT(stats.retained_bytes,0);
+    client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    EXPECT_EQ(server->pool_stats().hits,0); //pools are released with the server
+    server->set_on_message(nullptr);
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, SharedMessages) //Test Case #20
+{
+    ws_message shared_sample(tx_sample1);
+    ws_message copied_sample = shared_sample;   //copies the reference only
+    EXPECT_EQ(copied_sample.data(),shared_sample.data());
+    EXPECT_EQ(shared_sample.use_count(),2);
+    EXPECT_EQ(shared_sample.bytes(),tx_sample1);
+    EXPECT_TRUE(ws_message().empty());
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::vector<std::shared_ptr<client_abstract>> clients;
+    for(int i=0;i<2;++i)
+    {
+        clients.push_back(std::make_shared<ws_client>());
+        EXPECT_TRUE(clients.back()->connect(ip,8081));
+    }
+    EXPECT_EQ(server->broadcast(shared_sample),2);
+    EXPECT_EQ(server->send_message(1,ws_message(tx_sample2)),send_status::queued);
+    EXPECT_EQ(server->send_messages(2,{ws_message(tx_sample3),shared_sample}),send_status::queued);
+    EXPECT_EQ(server->send_message(3,shared_sample),send_status::not_found);    //no session with id=3
+    clients.at(0)->send_message(shared_sample);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); //messages are written asynchronously
+    EXPECT_EQ(shared_sample.use_count(),2); //released by the sessions queues after writing
+    EXPECT_EQ(clients.at(0)->read_shared_message(),shared_sample);
+    EXPECT_EQ(clients.at(0)->read_message(),tx_sample2);
+    EXPECT_EQ(clients.at(1)->read_shared_message().bytes(),tx_sample1);
+    EXPECT_EQ(clients.at(1)->read_message(),tx_sample3);
+    EXPECT_EQ(clients.at(1)->read_shared_message(),shared_sample);
+    EXPECT_EQ(server->read_shared_message(1),shared_sample);
+    EXPECT_TRUE(server->read_shared_message(1).empty());
+    for(auto& client : clients)
+        client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, InboxWaterMarks) //Test Case #21
+{
+    const int messages_num = 20;
+    inbox_limits limits;
+    limits.high_messages = 4;   //reading is paused at 4 queued messages
+    limits.low_messages = 1;    //and resumed at 1 queued message
+    server->set_inbox_limits(limits);
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    EXPECT_TRUE(client->connect(ip,8081));
+    for(int i=0;i<messages_num;++i)
+    {
+        std::string message = std::to_string(i);
+        client->send_message(std::vector<unsigned char>(message.begin(),message.end()));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    inbox_stats depth = server->inbox_depth(1);
+    EXPECT_EQ(depth.messages,4);    //no more messages are read from the client
+    EXPECT_EQ(depth.bytes,4);
+    EXPECT_TRUE(depth.paused);
+    for(int i=0;i<messages_num;++i) //reading the inbox resumes reading from the client, messages keep their order
+    {
+        std::string message = std::to_string(i);
+        for(int retries=0; !server->check_inbox(1) && retries<100; ++retries)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        EXPECT_EQ(server->read_message(1),std::vector<unsigned char>(message.begin(),message.end()));
+    }
+    depth = server->inbox_depth(1);
+    EXPECT_EQ(depth.messages,0);
+    EXPECT_FALSE(depth.paused);
+    EXPECT_EQ(server->inbox_depth(2).messages,0);   //no session with id=2
+    client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    server->set_inbox_limits(inbox_limits());   //back to default options, no water marks
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, OutboxLimits) //Test Case #22
+{
+    std::vector<unsigned char> large_message(256*1024,'A');   //fills the socket buffers of a client not reading
+    outbox_limits limits;
+    limits.max_messages = 8;
+    limits.block_timeout = std::chrono::milliseconds(50);
+    for(overflow_policy policy : {overflow_policy::drop_newest,overflow_policy::drop_oldest,overflow_policy::block,overflow_policy::disconnect})
+    {
+        limits.policy = policy;
+        server->set_outbox_limits(limits);
+        server->start();
+        ASSERT_TRUE(server->is_running());
+        net::io_context stalled_ctx;
+        websocket::stream<tcp::socket> stalled_client(stalled_ctx);    //handshakes then never reads
+        stalled_client.next_layer().connect(tcp::endpoint(net::ip::make_address(ip),8081));
+        stalled_client.handshake(ip,"/");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::vector<send_status> results;
+        for(int i=0;i<100;++i)
+        {
+            results.push_back(server->send_message(1,large_message));
+            if(results.back() != send_status::queued)   //outbox limit is reached
+                break;
+        }
+        EXPECT_EQ(results.front(),send_status::queued);
+        EXPECT_GT(results.size(),8u);   //the socket buffers take some messages first
+        switch(policy)
+        {
+        case overflow_policy::drop_newest:
+        case overflow_policy::block:    //timed out
+            EXPECT_EQ(results.back(),send_status::dropped);
+            break;
+        case overflow_policy::drop_oldest:
+            EXPECT_EQ(results.back(),send_status::dropped_oldest);
+            break;
+        case overflow_policy::disconnect:
+            EXPECT_EQ(results.back(),send_status::disconnected);
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            EXPECT_FALSE(server->check_session(1)); //slow consumer is closed
+            EXPECT_EQ(server->send_message(1,large_message),send_status::not_found);
+            break;
+        }
+        boost::system::error_code errcode;
+        stalled_client.next_layer().close(errcode);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        server->stop();
+        EXPECT_FALSE(server->is_running());
+    }
+    limits.max_messages = 1;
+    limits.policy = overflow_policy::block;
+    limits.block_timeout = std::chrono::seconds(5);
+    server->set_outbox_limits(limits);
+    server->set_io_threads(1);  //the writes making room would be queued behind the callback
+    std::vector<send_status> callback_results;
+    std::atomic<bool> callback_done = false;
+    server->set_on_message([&](int id,std::vector<unsigned char>&&)
+    {
+        if(id != 1)
+            return;
+        for(int i=0;i<4;++i)
+            callback_results.push_back(server->send_message(2,tx_sample2));
+        callback_done = true;
+    });
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    auto sender = std::make_shared<ws_client>();
+    auto receiver = std::make_shared<ws_client>();
+    EXPECT_TRUE(sender->connect(ip,8081));
+    EXPECT_TRUE(receiver->connect(ip,8081));
+    auto send_start = std::chrono::steady_clock::now();
+    sender->send_message(tx_sample1);
+    while(!callback_done.load() && std::chrono::steady_clock::now() - send_start < std::chrono::seconds(10))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_LT(std::chrono::steady_clock::now() - send_start,std::chrono::seconds(2));   //not blocked in the callback
+    ASSERT_TRUE(callback_done.load());
+    EXPECT_EQ(callback_results,(std::vector<send_status>{send_status::queued,send_status::dropped,
+        send_status::dropped,send_status::dropped}));
+    EXPECT_EQ(receiver->async_read_message(net::use_future).get(),tx_sample2);
+    sender->disconnect();
+    receiver->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    server->set_on_message(nullptr);
+    server->set_io_threads(0);
+    server->set_outbox_limits(outbox_limits()); //back to default options, no limits
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, Compression) //Test Case #23
+{
+    std::string json_record = "{\"symbol\":\"ABC\",\"price\":101.25,\"volume\":5000,\"side\":\"buy\"},";
+    std::string json_feed = "[";
+    while(json_feed.size() < 64*1024)
+        json_feed += json_record;
+    json_feed.back() = ']';
+    std::vector<unsigned char> feed_message(json_feed.begin(),json_feed.end());
+    deflate_options compression;
+    compression.enabled = true;
+    compression.max_window_bits = 12;
+    compression.memory_level = 6;
+    deflate_options small_uncompressed = compression;
+    small_uncompressed.min_message_size = 256;
+    bool threshold_supported = has_size_threshold<websocket::permessage_deflate>::value;
+    EXPECT_EQ(server->set_compression(small_uncompressed),threshold_supported);  //refused if it can't be applied
+    EXPECT_EQ(std::make_shared<ws_client>()->set_compression(small_uncompressed),threshold_supported);
+    EXPECT_TRUE(server->set_compression(compression));
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    net::io_context raw_ctx;
+    websocket::stream<tcp::socket> raw_client(raw_ctx); //checks the server response of the negotiation
+    websocket::permessage_deflate offer;
+    offer.client_enable = true;
+    raw_client.set_option(offer);
+    websocket::response_type response;
+    raw_client.next_layer().connect(tcp::endpoint(net::ip::make_address(ip),8081));
+    raw_client.handshake(response,ip,"/");
+    EXPECT_NE(std::string(response[http::field::sec_websocket_extensions]).find("permessage-deflate"),std::string::npos);
+    raw_client.close(websocket::close_code::normal);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::vector<std::shared_ptr<client_abstract>> clients;
+    for(int i=0;i<2;++i)    //compressed and uncompressed clients
+    {
+        clients.push_back(std::make_shared<ws_client>());
+        if(i == 0)
+            clients.back()->set_compression(compression);
+        EXPECT_TRUE(clients.back()->connect(ip,8081));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(server->broadcast(feed_message),2);
+    for(auto& client : clients)
+    {
+        client->send_message(feed_message);
+        client->send_message(tx_sample1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    for(int id=1;id<=2;++id)
+    {
+        EXPECT_EQ(server->read_message(id),feed_message);
+        EXPECT_EQ(server->read_message(id),tx_sample1);
+    }
+    for(auto& client : clients)
+    {
+        EXPECT_EQ(client->read_message(),feed_message);
+        client->disconnect();
+    }
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    server->set_compression(deflate_options()); //back to default options, no compression
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, FrameOptions) //Test Case #24
+{
+    std::string text_message = "caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80";    //2, 3 and 4 bytes sequences
+    std::vector<unsigned char> valid_text(text_message.begin(),text_message.end());
+    std::vector<unsigned char> binary_message = {0x00,0xFF,0x80,0xC0,0xED,0xA0,0x80};
+    std::string long_message = std::string(4096,'a') + text_message;   //ASCII blocks then multibyte sequences
+    std::vector<unsigned char> long_text(long_message.begin(),long_message.end());
+    EXPECT_TRUE(Validate_UTF8(valid_text.data(),valid_text.size()));
+    EXPECT_TRUE(Validate_UTF8(long_text.data(),long_text.size()));
+    EXPECT_FALSE(Validate_UTF8(binary_message.data(),binary_message.size()));
+    long_text.pop_back();   //truncated sequence at the end
+    EXPECT_FALSE(Validate_UTF8(long_text.data(),long_text.size()));
+    frame_options binary_frames;
+    binary_frames.mode = frame_mode::binary;
+    server->set_frame_options(binary_frames);
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    client->set_frame_options(binary_frames);
+    EXPECT_TRUE(client->connect(ip,8081));
+    EXPECT_EQ(server->send_message(1,binary_message),send_status::queued);
+    client->send_message(binary_message);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(client->read_message(),binary_message);
+    EXPECT_EQ(server->read_message(1),binary_message);
+    client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    frame_options strict_text;
+    strict_text.validate_utf8 = true;
+    server->set_frame_options(strict_text);
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    client = std::make_shared<ws_client>();
+    client->set_frame_options(strict_text);
+    EXPECT_TRUE(client->connect(ip,8081));
+    EXPECT_EQ(server->send_message(1,binary_message),send_status::invalid);
+    EXPECT_EQ(server->send_messages(1,{binary_message,valid_text}),send_status::invalid);   //valid message is still sent
+    client->send_message(binary_message);   //not sent
+    client->send_message(valid_text);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(client->read_message(),valid_text);
+    EXPECT_TRUE(client->read_message().empty());
+    EXPECT_EQ(server->read_message(1),valid_text);
+    EXPECT_TRUE(server->read_message(1).empty());
+    EXPECT_EQ(server->broadcast(binary_message),0);    //validated once, refused by all sessions
+    EXPECT_EQ(server->broadcast(valid_text),1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(client->read_message(),valid_text);
+    EXPECT_TRUE(client->read_message().empty());
+    net::io_context raw_ctx;
+    websocket::stream<tcp::socket> raw_client(raw_ctx); //sends binary frames that are not valid text
+    raw_client.next_layer().connect(tcp::endpoint(net::ip::make_address(ip),8081));
+    raw_client.handshake(ip,"/");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_TRUE(server->check_session(2));
+    raw_client.binary(true);
+    raw_client.write(net::buffer(binary_message));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_FALSE(server->check_session(2)); //text session with validation is closed
+    EXPECT_TRUE(server->check_session(1));
+    boost::system::error_code errcode;
+    raw_client.next_layer().close(errcode);
+    client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    server->set_frame_options(frame_options()); //back to default options, text frames without validation
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, StreamedMessages) //Test Case #25
+{
+    const std::size_t stream_size = 4*1024*1024 + 123;  //several fragments with a short last one
+    auto make_source = [stream_size](std::shared_ptr<std::size_t> position)
+    {
+        return [stream_size,position](unsigned char* data,std::size_t size) -> std::size_t
+        {
+            std::size_t fragment = std::min(size,stream_size - *position);
+            for(std::size_t i = 0; i < fragment; i++)
+                data[i] = static_cast<unsigned char>((*position + i) % 251);
+            *position += fragment;
+            return fragment;
+        };
+    };
+    std::mutex sink_mutex;
+    std::vector<std::size_t> server_sizes;  //sizes of the messages received by the server, in order
+    std::size_t server_received = 0, server_chunks = 0;
+    bool server_pattern = true;
+    server->set_on_chunk([&](int,const unsigned char* data,std::size_t size,bool last)
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        for(std::size_t i = 0; i < size; i++)
+            server_pattern = server_pattern && (data[i] == static_cast<unsigned char>((server_received + i) % 251));
+        server_received += size;
+        server_chunks++;
+        if(last)
+        {
+            server_sizes.push_back(server_received);
+            server_received = 0;
+            throw std::runtime_error("sink failure");   //suppressed, the session keeps receiving
+        }
+    });
+    server->start();    //text frames by default, streamed messages are still sent in binary frames
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    std::size_t client_received = 0;
+    bool client_last = false;
+    client->set_on_chunk([&](const unsigned char* data,std::size_t size,bool last)
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        boost::ignore_unused(data);
+        client_received += size;
+        client_last = client_last || last;
+    });
+    EXPECT_TRUE(client->connect(ip,8081));
+    std::vector<unsigned char> small_message = {0,1,2};   //same pattern as the streamed message
+    client->send_message(small_message);
+    std::future<void> client_sent = client->async_send_stream(make_source(std::make_shared<std::size_t>(0)),net::use_future);
+    client->send_message(small_message);    //written after the streamed message
+    EXPECT_NO_THROW(client_sent.get());
+    EXPECT_NO_THROW(server->async_send_stream(1,make_source(std::make_shared<std::size_t>(0)),net::use_future).get());
+    EXPECT_THROW(server->async_send_stream(2,make_source(std::make_shared<std::size_t>(0)),net::use_future).get(),
+        boost::system::system_error);   //no session
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        EXPECT_EQ(server_sizes,std::vector<std::size_t>({3,stream_size,3}));
+        EXPECT_TRUE(server_pattern);
+        EXPECT_GT(server_chunks,3u);    //streamed message is received in several chunks
+        EXPECT_EQ(client_received,stream_size);
+        EXPECT_TRUE(client_last);
+    }
+    EXPECT_TRUE(server->read_message(1).empty());   //chunks are not assembled in the inbox
+    auto failed_source = [](unsigned char*,std::size_t) -> std::size_t {throw std::runtime_error("source failure");};
+    EXPECT_THROW(server->async_send_stream(1,failed_source,net::use_future).get(),boost::system::system_error);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_FALSE(server->check_session(1)); //message can't be completed, session is closed
+    client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    server->set_on_chunk(nullptr);
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, SendFile) //Test Case #26
+{
+    std::string file_path = "ws_send_file_test.bin";
+    std::vector<unsigned char> file_data(3*1024*1024 + 77);    //several fragments, range offsets not page aligned
+    for(std::size_t i = 0; i < file_data.size(); i++)
+        file_data[i] = static_cast<unsigned char>((i * 31) % 256);
+    FILE* file = fopen(file_path.c_str(),"wb");
+    ASSERT_NE(file,nullptr);
+    fwrite(file_data.data(),1,file_data.size(),file);
+    fclose(file);
+    server->start();    //text frames by default, files are still sent in binary frames
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    EXPECT_TRUE(client->connect(ip,8081));
+    EXPECT_EQ(server->send_file(1,file_path),send_status::queued);
+    EXPECT_EQ(server->send_file(1,file_path,5000,100000),send_status::queued);
+    EXPECT_EQ(server->send_file(1,"no_such_file.bin"),send_status::unreadable);
+    EXPECT_EQ(server->send_file(1,file_path,file_data.size(),1),send_status::unreadable);  //range exceeds the file
+    EXPECT_EQ(server->send_file(2,file_path),send_status::not_found);
+    EXPECT_TRUE(client->send_file(file_path,4097));
+    EXPECT_FALSE(client->send_file("no_such_file.bin"));
+    EXPECT_NO_THROW(client->async_send_file(file_path,0,10,net::use_future).get());
+    EXPECT_THROW(client->async_send_file("no_such_file.bin",0,0,net::use_future).get(),boost::system::system_error);
+    EXPECT_NO_THROW(server->async_send_file(1,file_path,file_data.size(),0,net::use_future).get());  //empty range
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(client->read_message(),file_data);
+    EXPECT_EQ(client->read_message(),std::vector<unsigned char>(file_data.begin() + 5000,file_data.begin() + 105000));
+    EXPECT_TRUE(client->read_message().empty());    //empty range message
+    EXPECT_EQ(server->read_message(1),std::vector<unsigned char>(file_data.begin() + 4097,file_data.end()));
+    EXPECT_EQ(server->read_message(1),std::vector<unsigned char>(file_data.begin(),file_data.begin() + 10));
+    EXPECT_FALSE(server->check_inbox(1));
+    client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    EXPECT_FALSE(client->send_file(file_path)); //not connected
+    std::remove(file_path.c_str());
+}
+/*=====================================================================================================================*/
+TEST(WSSTESTING, SessionResumption) //Test Case #27
+{
+    server_secured->start();
+    ASSERT_TRUE(server_secured->is_running());
+    tls_stats server_before = server_secured->handshake_stats();
+    std::shared_ptr<client_abstract> client = std::make_shared<wss_client>(client_key_file_path,client_certificate_file_path,server_certificate_file_path);
+    for(int i=0;i<3;++i)    //first connection makes a full handshake, reconnections resume its session
+    {
+        EXPECT_TRUE(client->connect(ip,8082));
+        client->send_message(tx_sample1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));    //session ticket is received after the handshake
+        EXPECT_EQ(server_secured->read_message(1),tx_sample1);
+        client->disconnect();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_EQ(client->handshake_stats().full_handshakes,1u);
+    EXPECT_EQ(client->handshake_stats().resumed_handshakes,2u);
+    std::shared_ptr<tls_session_cache> shared_cache = std::make_shared<tls_session_cache>();
+    std::shared_ptr<client_abstract> first_client = std::make_shared<wss_client>(client_key_file_path,client_certificate_file_path,server_certificate_file_path);
+    std::shared_ptr<client_abstract> second_client = std::make_shared<wss_client>(client_key_file_path,client_certificate_file_path,server_certificate_file_path);
+    first_client->set_session_cache(shared_cache);
+    second_client->set_session_cache(shared_cache);
+    EXPECT_TRUE(first_client->connect(ip,8082));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_TRUE(second_client->connect(ip,8082));   //resumes the session of the first client
+    EXPECT_EQ(first_client->handshake_stats().full_handshakes,1u);
+    EXPECT_EQ(second_client->handshake_stats().resumed_handshakes,1u);
+    first_client->disconnect();
+    second_client->disconnect();
+    client->set_session_cache(nullptr); //resumption disabled
+    EXPECT_TRUE(client->connect(ip,8082));
+    client->disconnect();
+    EXPECT_EQ(client->handshake_stats().full_handshakes,2u);
+    tls_stats server_after = server_secured->handshake_stats();
+    EXPECT_EQ(server_after.full_handshakes - server_before.full_handshakes,3u);
+    EXPECT_EQ(server_after.resumed_handshakes - server_before.resumed_handshakes,3u);
+    server_secured->stop();
+    EXPECT_FALSE(server_secured->is_running());
+    EXPECT_EQ(server->handshake_stats().full_handshakes,0u);    //no TLS/SSL
+}
+/*=====================================================================================================================*/
+TEST(WSSTESTING, SharedTLSContext) //Test Case #28
+{
+    auto read_pem = [](const std::string& path)
+    {
+        std::ifstream file(path);
+        std::stringstream pem;
+        pem << file.rdbuf();
+        return pem.str();
+    };
+    std::shared_ptr<const tls_context> from_files = tls_context::FromFiles(client_key_file_path,client_certificate_file_path,server_certificate_file_path);
+    std::shared_ptr<const tls_context> from_memory = tls_context::FromMemory(read_pem(client_key_file_path),
+        read_pem(client_certificate_file_path),read_pem(server_certificate_file_path));
+    std::shared_ptr<const tls_context> no_verification = tls_context::FromMemory(read_pem(client_key_file_path),
+        read_pem(client_certificate_file_path),"");
+    EXPECT_THROW(tls_context::FromMemory("not a key","not a certificate",""),boost::system::system_error);
+    EXPECT_THROW(tls_context::FromFiles("no_such_key.pem"),boost::system::system_error);
+    std::vector<std::shared_ptr<client_abstract>> clients;
+    for(int i=0;i<20;++i)   //no file I/O per client
+        clients.push_back(std::make_shared<wss_client>(from_files));
+    server_secured->start();
+    ASSERT_TRUE(server_secured->is_running());
+    std::shared_ptr<client_abstract> memory_client = std::make_shared<wss_client>(from_memory);
+    EXPECT_TRUE(clients[0]->connect(ip,8082));
+    EXPECT_TRUE(clients[1]->connect(ip,8082));
+    EXPECT_TRUE(memory_client->connect(ip,8082));
+    clients[0]->send_message(tx_sample1);
+    clients[1]->send_message(tx_sample2);
+    memory_client->send_message(tx_sample3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(server_secured->read_message(1),tx_sample1);
+    EXPECT_EQ(server_secured->read_message(2),tx_sample2);
+    EXPECT_EQ(server_secured->read_message(3),tx_sample3);
+    clients[0]->disconnect();
+    clients[1]->disconnect();
+    memory_client->disconnect();
+    clients.clear();    //the shared configuration outlives its clients
+    server_secured->stop();
+    EXPECT_FALSE(server_secured->is_running());
+    server_less_secure->start();
+    ASSERT_TRUE(server_less_secure->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<wss_client>(no_verification);
+    EXPECT_TRUE(client->connect(ip,8083));
+    client->disconnect();
+    server_less_secure->stop();
+    EXPECT_FALSE(server_less_secure->is_running());
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, SendFromOnOpen) //Test Case #29
+{
+    std::atomic<int> open_status = -1;
+    server->set_on_open([&](int id){open_status = static_cast<int>(server->send_message(id,tx_sample1));});
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::shared_ptr<client_abstract> client = std::make_shared<ws_client>();
+    auto connect_start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(client->connect(ip,8081));
+    rx_sample1 = client->async_read_message(net::use_future).get(); //sent by "on_open" from the session's strand
+    EXPECT_LT(std::chrono::steady_clock::now() - connect_start,std::chrono::seconds(2));
+    EXPECT_EQ(rx_sample1,tx_sample1);
+    EXPECT_EQ(open_status.load(),static_cast<int>(send_status::queued));
+    client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    server->set_on_open(nullptr);
+}
+/*=====================================================================================================================*/
+TEST(WSTESTING, CloseFromCallback) //Test Case #30
+{
+    std::atomic<int> close_calls = 0;
+    server->set_io_threads(1);  //the callback runs on the only io thread, which also closes the other session
+    server->set_on_message([&](int id,std::vector<unsigned char>&&)
+    {
+        if(id == 1)
+        {
+            server->close_session(2);
+            ++close_calls;
+        }
+    });
+    server->start();
+    ASSERT_TRUE(server->is_running());
+    std::vector<std::shared_ptr<client_abstract>> clients;
+    for(int i=0;i<3;++i)
+    {
+        clients.push_back(std::make_shared<ws_client>());
+        EXPECT_TRUE(clients.back()->connect(ip,8081));
+    }
+    auto close_start = std::chrono::steady_clock::now();
+    clients.at(0)->send_message(tx_sample1);
+    while(close_calls.load() == 0 && std::chrono::steady_clock::now() - close_start < std::chrono::seconds(5))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_LT(std::chrono::steady_clock::now() - close_start,std::chrono::seconds(2));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_FALSE(server->check_session(2));
+    EXPECT_FALSE(clients.at(1)->check_connection());    //closed by the server
+    EXPECT_EQ(server->send_message(3,tx_sample2),send_status::queued);  //io thread is not held by the close
+    EXPECT_EQ(clients.at(2)->async_read_message(net::use_future).get(),tx_sample2);
+    for(auto& client : clients)
+        client->disconnect();
+    server->stop();
+    EXPECT_FALSE(server->is_running());
+    server->set_on_message(nullptr);
+    server->set_io_threads(0);
+}
@@ -0,0 +1,134 @@
+/************************************************************************************************************************
+ * 	Module: Shared TLS Context
+ * 	File Name: tls_context.h
+ *  Authors: Ahmed Desoky
+ *	Date: 19/1/2025
+ *	*********************************************************************************************************************
+ *	Description: This file includes the TLS configuration of the secure clients, built once and shared immutably by
+ *               any number of "wss_client" objects. Building it parses the private key, the certificate and the
+ *               Certificate Authority certificates, from files or from in-memory PEM, and creates the certificates
+ *               store. Clients created with it make no file I/O and no SSL context allocation, they create their
+ *               SSL connections from the shared context.
+ *               OpenSSL contexts are thread-safe for creating connections once configured, the configuration is
+ *               never changed after it is built.
+ ***********************************************************************************************************************/
+#pragma once
+/************************************************************************************************************************
+ *                     							   INCLUDES
+ ***********************************************************************************************************************/
+#include <memory>
+#include <string>
+#include "ssl_conf.h"
+#include "tls_session.h"
+/***********************************************************************************************************************
+ *                                                  CLASSES
+ ***********************************************************************************************************************/
+/************************************************************************************************************************
+* Class Name: tls_context
+* Purpose: TLS configuration shared by secure clients
+* Abstract/Concrete: Concrete / created dynamically only, by factory functions
+* #Instances: Unlimited
+* Exception Expected: Yes, due to invalid keys or certificates - only at factory functions
+* Inherited Classes: NONE
+* Constructors:
+*               1- Default Non-parameterized constructor - Private, used by factory functions
+*               2- Copy constructor - Deleted
+*
+* Description: Immutable TLS configuration of the secure clients. Created only by its factory functions, shared by
+*              a shared pointer to const object, the SSL context is exposed for creating connections only.
+************************************************************************************************************************/
+class tls_context final
+{
+private:
+    mutable ssl::context ssl_ctx{ssl::context::tls};    //mutable for creating connections only, never reconfigured
+    tls_context(void) = default;
+    static std::shared_ptr<const tls_context> Finish(std::unique_ptr<tls_context> context)
+    {
+        Set_Session_Resumption(context->ssl_ctx,false); //sessions are stored in the cache of each client connection
+        return std::shared_ptr<const tls_context>(std::move(context));
+    }
+public:
+    tls_context(const tls_context&) = delete;   //delete copy constructor
+    tls_context& operator=(const tls_context&) = delete;    //delete copy assignment operator
+    ssl::context& native(void) const {return ssl_ctx;}  //context of the clients SSL streams
+/************************************************************************************************************************
+* Function Name: FromFiles
+* Class name: tls_context
+* Access: Public
+* Specifiers: static
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: Yes
+* Parameters (in): user asymmetric private key path as const string reference
+*                  user digital certificate path as const string reference
+*                  Certificate Authority digital certificate path as const string reference
+* Parameters (out): NONE
+* Return value: shared immutable TLS configuration
+* Description: Factory function to build the TLS configuration of clients with peer verification from files,
+*              the same configuration as "Set_SSL_CTX (1)". It throws if a file can't be read or parsed.
+************************************************************************************************************************/
+    static std::shared_ptr<const tls_context> FromFiles(const std::string& key, const std::string& certificate, const std::string& CA)
+    {
+        std::unique_ptr<tls_context> context(new tls_context());
+        Set_SSL_CTX(context->ssl_ctx,key,certificate,CA);
+        return Finish(std::move(context));
+    }
+/************************************************************************************************************************
+* Function Name: FromFiles (2)
+* Class name: tls_context
+* Access: Public
+* Specifiers: static
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: Yes
+* Parameters (in): user asymmetric private key path as const string reference
+* Parameters (out): NONE
+* Return value: shared immutable TLS configuration
+* Description: Factory function to build the TLS configuration of clients with no peer verification from the key
+*              file, the same configuration as "Set_SSL_CTX (2)". It throws if a file can't be read or parsed.
+************************************************************************************************************************/
+    static std::shared_ptr<const tls_context> FromFiles(const std::string& key)
+    {
+        std::unique_ptr<tls_context> context(new tls_context());
+        Set_SSL_CTX(context->ssl_ctx,key);
+        return Finish(std::move(context));
+    }
+/************************************************************************************************************************
+* Function Name: FromMemory
+* Class name: tls_context
+* Access: Public
+* Specifiers: static
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: Yes
+* Parameters (in): user asymmetric private key in PEM format as const string reference
+*                  user digital certificate in PEM format as const string reference
+*                  Certificate Authority digital certificates in PEM format as const string reference, one or more,
+*                  empty for no peer verification
+* Parameters (out): NONE
+* Return value: shared immutable TLS configuration
+* Description: Factory function to build the TLS configuration of clients from in-memory PEM, for keys and
+*              certificates not stored in files, with the options of "Set_SSL_CTX". It throws if a PEM can't be parsed.
+************************************************************************************************************************/
+    static std::shared_ptr<const tls_context> FromMemory(const std::string& key, const std::string& certificate, const std::string& CA)
+    {
+        std::unique_ptr<tls_context> context(new tls_context());
+        context->ssl_ctx.set_options(ssl::context::default_workarounds | //set options, Enables workarounds for known bugs in SSL libraries.
+                                     net::ssl::context::no_sslv2 |   //Disable the deprecated SSLv2 protocol.
+                                     net::ssl::context::no_sslv3 |   //Disable the deprecated SSLv3 protocol.
+                                     net::ssl::context::single_dh_use); //use a new key for each key exchange (session) in Diffie-Helman (DH).
+        context->ssl_ctx.use_private_key(net::buffer(key),ssl::context::pem);  //set private key
+        context->ssl_ctx.use_certificate(net::buffer(certificate),ssl::context::pem);  //set certificate
+        if(CA.empty())
+            context->ssl_ctx.set_verify_mode(ssl::verify_none);    //no certificate verification, only DH key exchange
+        else
+        {
+            context->ssl_ctx.add_certificate_authority(net::buffer(CA));   //set the verification certificates (CA certificates)
+            context->ssl_ctx.set_verify_mode(ssl::verify_peer);    //certificate verification enabled
+        }
+        return Finish(std::move(context));
+    }
+};
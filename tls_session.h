@@ -0,0 +1,196 @@
+/************************************************************************************************************************
+ * 	Module: TLS Session Resumption
+ * 	File Name: tls_session.h
+ *  Authors: Ahmed Desoky
+ *	Date: 19/1/2025
+ *	*********************************************************************************************************************
+ *	Description: This file includes the TLS session resumption of the secure server and client and its counters.
+ *               A resumed connection makes an abbreviated handshake with the keys of a former session instead of a
+ *               full handshake, skipping the certificates exchange and the asymmetric key operations, the most
+ *               expensive part of a TLS connection.
+ *               Server side: session tickets (TLS 1.2 and TLS 1.3) and the session cache (TLS 1.2 session ids).
+ *               Tickets are encrypted by keys of the server's SSL context, kept while the server object exists.
+ *               Client side: a cache of the last session of every host, filled as the server sends its tickets and
+ *               offered at the next connection to the same host. A cache can be shared by many clients.
+ *               Counters of full and resumed handshakes are kept by the server and by every client.
+ ***********************************************************************************************************************/
+#pragma once
+/************************************************************************************************************************
+ *                     							   INCLUDES
+ ***********************************************************************************************************************/
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <boost/asio/ssl.hpp>
+/************************************************************************************************************************
+ *                     							   NAMESPACES
+ ***********************************************************************************************************************/
+namespace ssl = boost::asio::ssl;
+/***********************************************************************************************************************
+ *                                                  STRUCTS
+ ***********************************************************************************************************************/
+struct tls_stats    //handshakes counters of a server or a client
+{
+    std::size_t full_handshakes = 0;    //handshakes with certificates exchange and new keys
+    std::size_t resumed_handshakes = 0; //abbreviated handshakes resuming a former session
+};
+struct tls_counters //thread-safe handshakes counters, updated after every successful TLS handshake
+{
+    std::atomic<std::size_t> full{0};
+    std::atomic<std::size_t> resumed{0};
+    void count(SSL* ssl_handle)
+    {
+        if(SSL_session_reused(ssl_handle))
+            resumed.fetch_add(1);
+        else
+            full.fetch_add(1);
+    }
+    tls_stats stats(void) const
+    {
+        tls_stats counted;
+        counted.full_handshakes = full.load();
+        counted.resumed_handshakes = resumed.load();
+        return counted;
+    }
+};
+/***********************************************************************************************************************
+ *                                                  CLASSES
+ ***********************************************************************************************************************/
+class tls_session_cache //last resumable session of every host, shared by clients, thread-safe
+{
+private:
+    std::mutex cache_mutex;
+    std::unordered_map<std::string,std::shared_ptr<SSL_SESSION>> sessions;  //sessions by "host:port"
+public:
+    void store(const std::string& host, SSL_SESSION* session)  //takes the session reference
+    {
+        std::shared_ptr<SSL_SESSION> stored(session,SSL_SESSION_free);
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        sessions[host] = std::move(stored);
+    }
+    std::shared_ptr<SSL_SESSION> find(const std::string& host)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto session = sessions.find(host);
+        if(session == sessions.end())
+            return nullptr;
+        return session->second;
+    }
+    void clear(void)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        sessions.clear();
+    }
+};
+struct tls_session_slot //cache and host of a client connection, attached to its SSL object
+{
+    std::shared_ptr<tls_session_cache> cache;   //cache of the client, empty if resumption is disabled
+    std::string host;   //"host:port" of the connection
+};
+/************************************************************************************************************************
+* Function Name: TLS_Slot_Index
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread or Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: index of the "tls_session_slot" pointer in the extra data of SSL objects
+* Description: This function allocates the extra data index once. The application data of SSL objects is not used,
+*              Boost.Asio keeps its verification callback there. Inline, not static, for one index shared by all the
+*              translation units.
+************************************************************************************************************************/
+inline int TLS_Slot_Index(void)
+{
+    static const int slot_index = SSL_get_ex_new_index(0,nullptr,nullptr,nullptr,nullptr);
+    return slot_index;
+}
+/************************************************************************************************************************
+* Function Name: Store_TLS_Session
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): SSL connection handle
+*                  new session established by the connection
+* Parameters (out): NONE
+* Return value: 1 if the session is stored in the connection's cache and its reference is taken, else 0
+* Description: OpenSSL new session callback of client contexts, called when a session becomes resumable, after the
+*              handshake or when a TLS 1.3 ticket is received. The session is stored in the cache of the connection's
+*              "tls_session_slot", replacing the former session of the host.
+************************************************************************************************************************/
+inline int Store_TLS_Session(SSL* ssl_handle, SSL_SESSION* session)
+{
+    auto slot = static_cast<tls_session_slot*>(SSL_get_ex_data(ssl_handle,TLS_Slot_Index()));
+    if(slot == nullptr || !slot->cache || !SSL_SESSION_is_resumable(session))
+        return 0;   //not kept, freed by OpenSSL
+    slot->cache->store(slot->host,session);
+    return 1;
+}
+/************************************************************************************************************************
+* Function Name: Set_Session_Resumption
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): ssl_context reference
+*                  true for server role, false for client role
+* Parameters (out): NONE
+* Return value: NONE
+* Description: This function enables TLS session resumption on a SSL context. The server context issues session
+*              tickets and caches its sessions, its session id context is set as OpenSSL refuses to resume sessions
+*              of contexts verifying peers without it. The client context reports its new sessions to
+*              "Store_TLS_Session" and keeps none internally, sessions are offered by "Resume_TLS_Session".
+************************************************************************************************************************/
+inline void Set_Session_Resumption(ssl::context& ssl_ctx, bool server_role)
+{
+    static const unsigned char session_id_context[] = "websockets-server";
+    SSL_CTX* context = ssl_ctx.native_handle();
+    if(server_role)
+    {
+        SSL_CTX_clear_options(context,SSL_OP_NO_TICKET);    //session tickets
+        SSL_CTX_set_session_cache_mode(context,SSL_SESS_CACHE_SERVER);
+        SSL_CTX_set_session_id_context(context,session_id_context,sizeof(session_id_context) - 1);
+    }
+    else
+    {
+        SSL_CTX_set_session_cache_mode(context,SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(context,Store_TLS_Session);
+    }
+}
+/************************************************************************************************************************
+* Function Name: Resume_TLS_Session
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): SSL connection handle of a client, before its handshake
+*                  cache and host of the connection, must outlive the SSL object
+* Parameters (out): NONE
+* Return value: true if a former session of the host is offered, else false
+* Description: This function attaches the slot to the connection, so its new sessions are stored in the cache, and
+*              offers the cached session of the host if any. The server resumes it or falls back to a full handshake
+*              if it doesn't know it anymore.
+************************************************************************************************************************/
+inline bool Resume_TLS_Session(SSL* ssl_handle, tls_session_slot& slot)
+{
+    SSL_set_ex_data(ssl_handle,TLS_Slot_Index(),&slot);
+    if(!slot.cache)
+        return false;
+    std::shared_ptr<SSL_SESSION> session = slot.cache->find(slot.host);
+    return session && SSL_set_session(ssl_handle,session.get()) == 1;  //OpenSSL takes its own reference
+}
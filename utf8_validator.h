@@ -0,0 +1,296 @@
+/************************************************************************************************************************
+ * 	Module: UTF-8 Validation
+ * 	File Name: utf8_validator.h
+ *  Authors: Ahmed Desoky
+ *	Date: 19/1/2025
+ *	*********************************************************************************************************************
+ *	Description: This file includes the UTF-8 validator of text messages, used by the server and the client when
+ *               strict text validation is enabled. Text frames received are validated by Boost.Beast itself, this
+ *               validator checks the messages sent as text and the messages received in binary frames by a text
+ *               session, so a peer never receives a text frame it would reject.
+ *               The validator checks 32 bytes (AVX2) or 16 bytes (SSSE3) per step using the lookup algorithm of
+ *               "Validating UTF-8 In Less Than One Instruction Per Byte" (J. Keiser, D. Lemire), with an ASCII
+ *               fast path. The instructions set is selected once at run time, the scalar validator is used on CPUs
+ *               and compilers without them.
+ ***********************************************************************************************************************/
+#pragma once
+/************************************************************************************************************************
+ *                     							   INCLUDES
+ ***********************************************************************************************************************/
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define UTF8_SIMD_VALIDATOR
+#include <immintrin.h>
+#endif
+/************************************************************************************************************************
+* Function Name: Validate_UTF8_Scalar
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): pointer to the bytes and their count
+* Parameters (out): NONE
+* Return value: true if the bytes are valid UTF-8, false otherwise
+* Description: Byte by byte validator, skipping 8 ASCII bytes at a time. It rejects overlong encodings, surrogates,
+*              code points above U+10FFFF and truncated sequences, as RFC 3629.
+************************************************************************************************************************/
+inline bool Validate_UTF8_Scalar(const unsigned char* data, std::size_t size)
+{
+    std::size_t index = 0;
+    while(index < size)
+    {
+        if(index + 8 <= size)  //ASCII fast path
+        {
+            std::uint64_t block;
+            std::memcpy(&block,data+index,8);
+            if((block & 0x8080808080808080ULL) == 0)
+            {
+                index += 8;
+                continue;
+            }
+        }
+        unsigned char byte = data[index];
+        if(byte < 0x80)
+        {
+            ++index;
+            continue;
+        }
+        std::size_t length;
+        unsigned char low = 0x80, high = 0xBF;  //valid range of the second byte
+        if(byte >= 0xC2 && byte <= 0xDF)
+            length = 2;
+        else if(byte >= 0xE0 && byte <= 0xEF)
+        {
+            length = 3;
+            if(byte == 0xE0)
+                low = 0xA0;     //overlong
+            else if(byte == 0xED)
+                high = 0x9F;    //surrogates
+        }
+        else if(byte >= 0xF0 && byte <= 0xF4)
+        {
+            length = 4;
+            if(byte == 0xF0)
+                low = 0x90;     //overlong
+            else if(byte == 0xF4)
+                high = 0x8F;    //above U+10FFFF
+        }
+        else
+            return false;   //continuation byte, overlong 2 bytes lead or out of range lead
+        if(index + length > size || data[index+1] < low || data[index+1] > high)
+            return false;
+        for(std::size_t next=2;next<length;++next)
+            if((data[index+next] & 0xC0) != 0x80)
+                return false;
+        index += length;
+    }
+    return true;
+}
+#ifdef UTF8_SIMD_VALIDATOR
+/***********************************************************************************************************************
+ *                                        SIMD VALIDATORS, KEISER-LEMIRE LOOKUP
+ * Every byte is checked with its 3 previous bytes: the nibbles of the byte and of its previous byte index 3 tables of
+ * error bits, their AND is non zero for invalid 2 bytes sequences. The 3rd and 4th bytes of longer sequences must be
+ * continuations, checked against the 2nd and 3rd previous bytes. A sequence truncated at the end of a block is
+ * carried to the next block.
+ ***********************************************************************************************************************/
+namespace utf8_lookup
+{
+constexpr std::uint8_t TOO_SHORT = 1<<0;    //11______ 0_______ or 11______ 11______
+constexpr std::uint8_t TOO_LONG = 1<<1;     //0_______ 10______
+constexpr std::uint8_t OVERLONG_3 = 1<<2;   //11100000 100_____
+constexpr std::uint8_t TOO_LARGE = 1<<3;    //11110100 1001____ or 11110100 101_____ or 11110101+
+constexpr std::uint8_t SURROGATE = 1<<4;    //11101101 101_____
+constexpr std::uint8_t OVERLONG_2 = 1<<5;   //1100000_ 10______
+constexpr std::uint8_t TOO_LARGE_1000 = 1<<6;   //11110101+ 1000____
+constexpr std::uint8_t OVERLONG_4 = 1<<6;   //11110000 1000____
+constexpr std::uint8_t TWO_CONTS = 1<<7;    //10______ 10______
+constexpr std::uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+constexpr std::uint8_t byte_1_high[16] = {  //by the high nibble of the previous byte
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    TOO_SHORT | OVERLONG_2,
+    TOO_SHORT,
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4};
+constexpr std::uint8_t byte_1_low[16] = {   //by the low nibble of the previous byte
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    CARRY | OVERLONG_2,
+    CARRY,
+    CARRY,
+    CARRY | TOO_LARGE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000};
+constexpr std::uint8_t byte_2_high[16] = {  //by the high nibble of the byte
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT};
+constexpr std::uint8_t incomplete_max[32] = {   //bytes above these values start a sequence not ended in the block
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0xF0-1, 0xE0-1, 0xC0-1};
+}
+/************************************************************************************************************************
+* Function Name: Validate_UTF8_AVX2
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): pointer to the bytes and their count
+* Parameters (out): NONE
+* Return value: true if the bytes are valid UTF-8, false otherwise
+* Description: AVX2 validator, 32 bytes per step. The last partial block is copied into a zero padded block.
+*              Called only on CPUs supporting AVX2, refer to "Validate_UTF8".
+************************************************************************************************************************/
+__attribute__((target("avx2"))) inline bool Validate_UTF8_AVX2(const unsigned char* data, std::size_t size)
+{
+    using namespace utf8_lookup;
+    const __m256i high_1_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(byte_1_high)));
+    const __m256i low_1_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(byte_1_low)));
+    const __m256i high_2_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(byte_2_high)));
+    const __m256i max_value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(incomplete_max));
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+    __m256i error = _mm256_setzero_si256();
+    __m256i previous_input = _mm256_setzero_si256();
+    __m256i previous_incomplete = _mm256_setzero_si256();
+    unsigned char last_block[32];
+    for(std::size_t index=0;index<size;index+=32)
+    {
+        __m256i input;
+        if(index + 32 <= size)
+            input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data+index));
+        else    //last partial block, zero bytes are valid ASCII
+        {
+            std::memset(last_block,0,sizeof(last_block));
+            std::memcpy(last_block,data+index,size-index);
+            input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(last_block));
+        }
+        if(_mm256_movemask_epi8(input) == 0)    //ASCII block, only a sequence left by the previous block is an error
+        {
+            error = _mm256_or_si256(error,previous_incomplete);
+            previous_incomplete = _mm256_setzero_si256();
+            previous_input = input;
+            continue;
+        }
+        //previous bytes of every byte, from this block and the end of the previous one
+        __m256i previous_block = _mm256_permute2x128_si256(previous_input,input,0x21);
+        __m256i previous_1 = _mm256_alignr_epi8(input,previous_block,15);
+        __m256i previous_2 = _mm256_alignr_epi8(input,previous_block,14);
+        __m256i previous_3 = _mm256_alignr_epi8(input,previous_block,13);
+        __m256i special_cases = _mm256_and_si256(
+            _mm256_and_si256(_mm256_shuffle_epi8(high_1_table,_mm256_and_si256(_mm256_srli_epi16(previous_1,4),nibble_mask)),
+                             _mm256_shuffle_epi8(low_1_table,_mm256_and_si256(previous_1,nibble_mask))),
+            _mm256_shuffle_epi8(high_2_table,_mm256_and_si256(_mm256_srli_epi16(input,4),nibble_mask)));
+        __m256i third_byte = _mm256_subs_epu8(previous_2,_mm256_set1_epi8(char(0xE0-0x80)));    //0x80+ after 111_____
+        __m256i fourth_byte = _mm256_subs_epu8(previous_3,_mm256_set1_epi8(char(0xF0-0x80)));   //0x80+ after 1111____
+        __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third_byte,fourth_byte),_mm256_set1_epi8(char(0x80)));
+        error = _mm256_or_si256(error,_mm256_xor_si256(must_continue,special_cases));
+        previous_incomplete = _mm256_subs_epu8(input,max_value);
+        previous_input = input;
+    }
+    error = _mm256_or_si256(error,previous_incomplete);
+    return _mm256_testz_si256(error,error) != 0;
+}
+/************************************************************************************************************************
+* Function Name: Validate_UTF8_SSSE3
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): pointer to the bytes and their count
+* Parameters (out): NONE
+* Return value: true if the bytes are valid UTF-8, false otherwise
+* Description: SSSE3 validator, 16 bytes per step, refer to "Validate_UTF8_AVX2".
+*              Called only on CPUs supporting SSSE3, refer to "Validate_UTF8".
+************************************************************************************************************************/
+__attribute__((target("ssse3"))) inline bool Validate_UTF8_SSSE3(const unsigned char* data, std::size_t size)
+{
+    using namespace utf8_lookup;
+    const __m128i high_1_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(byte_1_high));
+    const __m128i low_1_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(byte_1_low));
+    const __m128i high_2_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(byte_2_high));
+    const __m128i max_value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(incomplete_max+16));
+    const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+    __m128i error = _mm_setzero_si128();
+    __m128i previous_input = _mm_setzero_si128();
+    __m128i previous_incomplete = _mm_setzero_si128();
+    unsigned char last_block[16];
+    for(std::size_t index=0;index<size;index+=16)
+    {
+        __m128i input;
+        if(index + 16 <= size)
+            input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data+index));
+        else    //last partial block, zero bytes are valid ASCII
+        {
+            std::memset(last_block,0,sizeof(last_block));
+            std::memcpy(last_block,data+index,size-index);
+            input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(last_block));
+        }
+        if(_mm_movemask_epi8(input) == 0)   //ASCII block, only a sequence left by the previous block is an error
+        {
+            error = _mm_or_si128(error,previous_incomplete);
+            previous_incomplete = _mm_setzero_si128();
+            previous_input = input;
+            continue;
+        }
+        __m128i previous_1 = _mm_alignr_epi8(input,previous_input,15);
+        __m128i previous_2 = _mm_alignr_epi8(input,previous_input,14);
+        __m128i previous_3 = _mm_alignr_epi8(input,previous_input,13);
+        __m128i special_cases = _mm_and_si128(
+            _mm_and_si128(_mm_shuffle_epi8(high_1_table,_mm_and_si128(_mm_srli_epi16(previous_1,4),nibble_mask)),
+                          _mm_shuffle_epi8(low_1_table,_mm_and_si128(previous_1,nibble_mask))),
+            _mm_shuffle_epi8(high_2_table,_mm_and_si128(_mm_srli_epi16(input,4),nibble_mask)));
+        __m128i third_byte = _mm_subs_epu8(previous_2,_mm_set1_epi8(char(0xE0-0x80)));  //0x80+ after 111_____
+        __m128i fourth_byte = _mm_subs_epu8(previous_3,_mm_set1_epi8(char(0xF0-0x80))); //0x80+ after 1111____
+        __m128i must_continue = _mm_and_si128(_mm_or_si128(third_byte,fourth_byte),_mm_set1_epi8(char(0x80)));
+        error = _mm_or_si128(error,_mm_xor_si128(must_continue,special_cases));
+        previous_incomplete = _mm_subs_epu8(input,max_value);
+        previous_input = input;
+    }
+    error = _mm_or_si128(error,previous_incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error,_mm_setzero_si128())) == 0xFFFF;
+}
+#endif
+/************************************************************************************************************************
+* Function Name: Validate_UTF8
+* Class name: NONE
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): pointer to the bytes and their count
+* Parameters (out): NONE
+* Return value: true if the bytes are valid UTF-8, false otherwise
+* Description: Validates the bytes with the widest validator supported by the CPU, selected at the first call.
+************************************************************************************************************************/
+inline bool Validate_UTF8(const unsigned char* data, std::size_t size)
+{
+#ifdef UTF8_SIMD_VALIDATOR
+    static bool (*const validator)(const unsigned char*, std::size_t) =
+        __builtin_cpu_supports("avx2") ? Validate_UTF8_AVX2 :
+        __builtin_cpu_supports("ssse3") ? Validate_UTF8_SSSE3 : Validate_UTF8_Scalar;
+    return validator(data,size);
+#else
+    return Validate_UTF8_Scalar(data,size);
+#endif
+}
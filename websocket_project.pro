@@ -1,6 +1,6 @@
 QT = core
 
-CONFIG += c++17 cmdline
+CONFIG += c++2a cmdline
 
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
@@ -35,7 +35,15 @@ LIBS += -L/usr/local/lib \  #for both Boost and OpenCV
         -pthread
 
 HEADERS += \
+    benchmarks.h \
+    deflate_conf.h \
+    gather_stream.h \
+    mapped_file.h \
     ssl_conf.h \
     tests.h \
+    tls_context.h \
+    tls_session.h \
+    utf8_validator.h \
     websockets_client.h \
-    websockets_server.h
+    websockets_server.h \
+    ws_message.h
@@ -30,19 +30,40 @@ constexpr int connection_timeout = 30;  //in seconds
 * Return value: vector of unsigned char (message)
 * Description: User function to read messages received and stored in the queue
 *              access to the queue and shared variables is secured by "read_mutex" mutex
+*              The message is moved out of the queue, not copied.
 ************************************************************************************************************************/
 std::vector<unsigned char> ws_client_base::read_message(void)
 {
     std::vector<unsigned char> message;
-    if(read_messages_queue.size() == 0)
-        return message;
     read_mutex.lock();
-    message = read_messages_queue.front();
-    read_messages_queue.pop_front();
+    if(!read_messages_queue.empty())    //checked under the mutex
+    {
+        message = std::move(read_messages_queue.front());
+        read_messages_queue.pop_front();
+    }
     read_mutex.unlock();
     return message;
 }
 /************************************************************************************************************************
+* Function Name: read_shared_message
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): read message if there's one in the queue or empty message
+* Return value: read message as "ws_message"
+* Description: User function to read messages received and stored in the queue as a shared message.
+*              The received bytes are moved into the message, not copied. Refer to "read_message".
+************************************************************************************************************************/
+ws_message ws_client_base::read_shared_message(void)
+{
+    return ws_message(this->read_message());
+}
+/************************************************************************************************************************
 * Function Name: send_message
 * Class name: ws_client_base
 * Access: Public
@@ -54,19 +75,108 @@ std::vector<unsigned char> ws_client_base::read_message(void)
 * Parameters (in): message to send as vector of unsigned characters
 * Parameters (out): NONE
 * Return value: NONE
+* Description: User function to send messages, the message is copied once into a shared message.
+*              Refer to "send_message (2)".
+************************************************************************************************************************/
+void ws_client_base::send_message(const std::vector<unsigned char>& message)
+{
+    this->send_message(ws_message(message));
+}
+/************************************************************************************************************************
+* Function Name: send_message (2)
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): shared message to send as const reference to "ws_message"
+* Parameters (out): NONE
+* Return value: NONE
 * Description: User function to send messages, first stored in the queue then written to the stream
 *              access to the queue and shared varibales is secured by "send_mutex" mutex
+*              Only a reference to the message is queued, its bytes are never copied.
+*              A message that is not valid text for a text connection with validation is not sent.
+*              The write order is given only if no write is in flight, else the message is written after the
+*              queued messages by the write handler.
 ************************************************************************************************************************/
-void ws_client_base::send_message(const std::vector<unsigned char>& message)
+void ws_client_base::send_message(const ws_message& message)
 {
+    if(!valid_text(message.bytes()))
+        return;
     send_mutex.lock();
-    send_messages_queue.push_back(std::move(message));
+    send_messages_queue.push_back(message.payload());
+    sent_handlers.push_back(nullptr);   //no completion handler
+    bool start_write = !write_in_progress;  //no write in flight to continue with this message
+    write_in_progress = true;
     send_mutex.unlock();
-    this->write_message();  //call write message and give the write order
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending and writing
+    if(start_write)
+        this->write_message();  //call write message and give the write order
     return;
 }
 /************************************************************************************************************************
+* Function Name: send_messages
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): batch of messages to send as vector of vectors of unsigned characters
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to send a batch of messages in order, each message is copied once into a shared
+*              message before taking the lock. Refer to "send_messages (2)".
+************************************************************************************************************************/
+void ws_client_base::send_messages(const std::vector<std::vector<unsigned char>>& messages)
+{
+    std::vector<ws_message> shared_messages;
+    shared_messages.reserve(messages.size());
+    for(const auto& message : messages)
+        shared_messages.emplace_back(message);
+    this->send_messages(shared_messages);
+}
+/************************************************************************************************************************
+* Function Name: send_messages (2)
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): batch of shared messages to send as const reference to vector of "ws_message"
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to send a batch of shared messages in order, all stored in the queue under one lock
+*              then written to the stream back to back by the write handler, with a single write order.
+*              access to the queue and shared varibales is secured by "send_mutex" mutex
+*              Messages that are not valid text for a text connection with validation are left out of the batch.
+************************************************************************************************************************/
+void ws_client_base::send_messages(const std::vector<ws_message>& messages)
+{
+    if(messages.empty())
+        return;
+    std::vector<bool> valid_messages(messages.size());  //validated before taking the lock
+    for(std::size_t index=0;index<messages.size();++index)
+        valid_messages[index] = valid_text(messages[index].bytes());
+    send_mutex.lock();
+    for(std::size_t index=0;index<messages.size();++index)
+    {
+        if(!valid_messages[index])
+            continue;
+        send_messages_queue.push_back(messages[index].payload());
+        sent_handlers.push_back(nullptr);   //no completion handler
+    }
+    bool start_write = !write_in_progress;  //no write in flight to continue with these messages
+    write_in_progress = true;
+    send_mutex.unlock();
+    if(start_write)
+        this->write_message();  //call write message and give the write order
+}
+/************************************************************************************************************************
 * Function Name: check_connection
 * Class name: ws_client_base
 * Access: Public
@@ -128,7 +238,841 @@ inline bool ws_client_base::check_failed_connection(void)
     return self_disconnected.load();
 }
 /************************************************************************************************************************
-* Function Name: receive_message
+* Function Name: set_on_open
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant
+* Expected  Exception: No
+* Parameters (in): callback called after the connection handshake, empty function to remove it
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the callback called from the client's strand once the connection handshake is done.
+*              Applied at next "connect" call.
+************************************************************************************************************************/
+void ws_client_base::set_on_open(std::function<void(void)> on_open)
+{
+    callbacks.on_open = std::move(on_open);
+}
+/************************************************************************************************************************
+* Function Name: set_on_message
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant
+* Expected  Exception: No
+* Parameters (in): callback called with the received message, empty function to remove it
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the callback called from the client's strand as soon as a message is received.
+*              The message is moved to the callback and never pushed to the client inbox, so "check_inbox"
+*              and "read_message" are not needed. Without it messages are queued to the inbox as before.
+*              Applied at next "connect" call.
+************************************************************************************************************************/
+void ws_client_base::set_on_message(std::function<void(std::vector<unsigned char>&&)> on_message)
+{
+    callbacks.on_message = std::move(on_message);
+}
+/************************************************************************************************************************
+* Function Name: set_on_close
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant
+* Expected  Exception: No
+* Parameters (in): callback called after the connection closure, empty function to remove it
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the callback called once an opened connection is closed.
+*              It is called from the client's strand if the connection is closed by the server or by an error,
+*              and from the caller thread if it is closed by "disconnect".
+*              Applied at next "connect" call.
+************************************************************************************************************************/
+void ws_client_base::set_on_close(std::function<void(void)> on_close)
+{
+    callbacks.on_close = std::move(on_close);
+}
+/************************************************************************************************************************
+* Function Name: set_on_chunk
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant
+* Expected  Exception: No
+* Parameters (in): callback called with the received chunk, its size and true with the last chunk of the message,
+*                  empty function to remove it
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to receive messages incrementally instead of complete messages. The client reads up to
+*              64KB at a time and hands every chunk to the callback from the client's strand as it arrives, so
+*              messages of any size are received with bounded memory, to be written to disk as they arrive.
+*              The chunk is valid during the call only. The next chunk is read once the callback returns.
+*              "on_message" and the inbox are not used. Applied at next "connect" call.
+************************************************************************************************************************/
+void ws_client_base::set_on_chunk(std::function<void(const unsigned char*,std::size_t,bool)> on_chunk)
+{
+    callbacks.on_chunk = std::move(on_chunk);
+}
+/************************************************************************************************************************
+* Function Name: set_compression
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant
+* Expected  Exception: No
+* Parameters (in): permessage-deflate options, window bits, memory level, context takeover and minimum message size
+* Parameters (out): options status whether they are set or not
+* Return value: false if the options are refused and the former ones are kept, else true
+* Description: User function to offer the permessage-deflate extension to the server during the handshake.
+*              The connection is compressed only if the server accepts it, otherwise it is uncompressed.
+*              A minimum message size is refused by Boost versions without it, as 1.74, refer to "Deflate_Supported".
+*              Refer to "deflate_conf.h". Default is disabled, applied at next "connect" call.
+************************************************************************************************************************/
+bool ws_client_base::set_compression(const deflate_options& options)
+{
+    if(!Deflate_Supported(options))
+        return false;
+    compression = options;
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: set_frame_options
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant
+* Expected  Exception: No
+* Parameters (in): frames type of the sent messages and text validation
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the frames type of the messages sent by the client, text or binary frames.
+*              With text validation, messages that are not valid UTF-8 are not sent and the connection is closed if
+*              they are received in binary frames. Text frames received are always validated by Boost.Beast.
+*              Default is text frames without validation, applied at next "connect" call.
+************************************************************************************************************************/
+void ws_client_base::set_frame_options(const frame_options& options)
+{
+    framing = options;
+}
+/************************************************************************************************************************
+* Function Name: set_session_cache
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant
+* Expected  Exception: No
+* Parameters (in): TLS sessions cache shared with other clients, empty to disable session resumption
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the cache of the TLS sessions offered at reconnections. By default every secure
+*              client resumes with its own cache, sharing one cache lets new clients resume the sessions of others
+*              connected to the same host. Refer to "tls_session.h". It has no effect on clients with no TLS/SSL.
+*              Applied at next "connect" call.
+************************************************************************************************************************/
+void ws_client_base::set_session_cache(std::shared_ptr<tls_session_cache> cache)
+{
+    session_resumption = cache != nullptr;
+    session_cache = std::move(cache);
+}
+/************************************************************************************************************************
+* Function Name: handshake_stats
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): counters of the TLS handshakes
+* Return value: full and resumed TLS handshakes of the client connections, zeros with no TLS/SSL
+* Description: User function to monitor TLS session resumption of the client reconnections. Failed handshakes are
+*              not counted.
+************************************************************************************************************************/
+tls_stats ws_client_base::handshake_stats(void)
+{
+    return handshakes.stats();
+}
+/************************************************************************************************************************
+* Function Name: valid_text
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: const
+* Running Thread: Caller thread or Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): message to be sent or received
+* Parameters (out): NONE
+* Return value: false if the connection validates text and the message is not valid UTF-8, else true
+* Description: Internal function to check sent messages and messages received in binary frames by a text connection
+*              with validation, refer to "Validate_UTF8". Connections sending binary frames accept any message.
+************************************************************************************************************************/
+bool ws_client_base::valid_text(const std::vector<unsigned char>& message) const
+{
+    if(active_framing.mode != frame_mode::text || !active_framing.validate_utf8)
+        return true;
+    return Validate_UTF8(message.data(),message.size());
+}
+/************************************************************************************************************************
+* Function Name: notify_open
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called from the client's strand after the connection handshake.
+*              It marks the connection as opened and calls user "on_open" callback if set.
+*              Exceptions thrown by the user callback are suppressed, not to break the io thread.
+************************************************************************************************************************/
+void ws_client_base::notify_open(void)
+{
+    opened = true;
+    if(!active_callbacks || !active_callbacks->on_open)
+        return;
+    try{active_callbacks->on_open();}
+    catch(...){} //suppress user callback exceptions
+}
+/************************************************************************************************************************
+* Function Name: notify_message
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): received message as rvalue reference
+* Parameters (out): whether the message is handed to the user callback or not
+* Return value: boolean, false if no "on_message" callback is set and the message is left to the caller to queue
+* Description: Internal function called from the client's strand as soon as a message is received.
+*              The message is moved to user "on_message" callback if set.
+*              Exceptions thrown by the user callback are suppressed, not to break the io thread.
+************************************************************************************************************************/
+bool ws_client_base::notify_message(std::vector<unsigned char>&& message)
+{
+    if(!active_callbacks || !active_callbacks->on_message)
+        return false;
+    try{active_callbacks->on_message(std::move(message));}
+    catch(...){} //suppress user callback exceptions
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: notify_chunk
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): received chunk data and size
+*                  boolean set at the last chunk of the message
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called from the client's strand as soon as a chunk is received.
+*              It calls user "on_chunk" callback, set when the client reads chunks.
+*              Exceptions thrown by the user callback are suppressed, not to break the io thread.
+************************************************************************************************************************/
+void ws_client_base::notify_chunk(const unsigned char* chunk, std::size_t size, bool last_chunk)
+{
+    try{active_callbacks->on_chunk(chunk,size,last_chunk);}
+    catch(...) {} //suppress user callback exceptions
+}
+/************************************************************************************************************************
+* Function Name: next_fragment
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, called from the strand by the writes only
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): next fragment of the streamed message, empty at its end
+* Return value: false if the source of the streamed message threw, else true
+* Description: Internal function to get the next fragment from "writing_source", user sources included.
+*              Exceptions thrown by the source are suppressed, not to break the io thread, the message is aborted.
+************************************************************************************************************************/
+bool ws_client_base::next_fragment(net::const_buffer& fragment)
+{
+    try{fragment = writing_source(stream_chunk_size);}
+    catch(...) {return false;} //suppress user source exceptions
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: notify_close
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread or Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by the disconnect functions after the connection closure.
+*              It calls user "on_close" callback if set, only once and only if the connection was opened.
+*              Exceptions thrown by the user callback are suppressed, not to break the io thread.
+************************************************************************************************************************/
+void ws_client_base::notify_close(void)
+{
+    if(!opened.exchange(false) || !active_callbacks || !active_callbacks->on_close)
+        return;
+    try{active_callbacks->on_close();}
+    catch(...){} //suppress user callback exceptions
+}
+/************************************************************************************************************************
+* Function Name: connect
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): Server's IP address/host as string reference
+*                  Server's port dedicated for WebSocket connections
+* Parameters (out): connection status, successful/failed
+* Return value: connection status as boolean
+* Description: User function to connect to a host server. It tries to connect, if its timeout (30 seconds by default)
+*              passed or the connection failed it will reset connection and release resources and return false.
+*              If connection is successful, it returns true as soon as the connection is ready.
+************************************************************************************************************************/
+bool ws_client_base::connect(std::string& ip_address, unsigned short port)
+{
+    if(connected_ip == ip_address && connected_port == port && ongoing_connection.load() == true)
+        return true;    //if I tried to connect to already connected endpoint
+    else if(ongoing_connection.load() == true)
+        return false;   //if I tried to connect to another endpoint while I am connected to some endpoint
+    auto connect_promise = std::make_shared<std::promise<boost::system::error_code>>();
+    std::future<boost::system::error_code> connect_result = connect_promise->get_future();
+    start_connect(ip_address,port,[connect_promise](boost::system::error_code errcode){connect_promise->set_value(errcode);});
+    //Boost's default handshake timeout connection for websocket is 30seconds
+    if(connect_result.wait_for(std::chrono::seconds(connection_timeout)) != std::future_status::ready || connect_result.get())
+    {
+        complete_connect(net::error::timed_out);    //drop the completion handler if still pending
+        ongoing_connection = true; //setting "ongoing_connection" by true, to be able to run disconnect
+        disconnect(); //disconnect if not disconnected and reset
+        return false;
+    }
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: complete_connect
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread or Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): connection result
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function to call the pending connection completion handler once, with the connection result.
+*              Access to the handler is secured by "connect_mutex" mutex.
+************************************************************************************************************************/
+void ws_client_base::complete_connect(boost::system::error_code errcode)
+{
+    connect_mutex.lock();
+    sent_handler handler = std::move(connect_handler);
+    connect_handler = nullptr;
+    connect_mutex.unlock();
+    if(handler)
+        handler(errcode);
+}
+/************************************************************************************************************************
+* Function Name: deliver_message
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): received message as rvalue reference
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called from the client's strand for each received message.
+*              The message goes to user "on_message" callback if set, else to the oldest pending asynchronous read,
+*              else it is pushed to the queue. Access to the queue is secured by "read_mutex" mutex.
+************************************************************************************************************************/
+void ws_client_base::deliver_message(std::vector<unsigned char>&& message)
+{
+    if(notify_message(std::move(message)))  //handed to user callback
+        return;
+    read_mutex.lock();
+    if(!read_waiters.empty())   //pending asynchronous read, hand the message directly
+    {
+        message_handler waiter = std::move(read_waiters.front());
+        read_waiters.pop_front();
+        read_mutex.unlock();
+        waiter(boost::system::error_code(),std::move(message));
+        return;
+    }
+    read_messages_queue.push_back(std::move(message));  //push received data into the queue
+    read_mutex.unlock();
+}
+/************************************************************************************************************************
+* Function Name: abort_waiters
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread or Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by disconnect functions to fail pending asynchronous reads and
+*              unwritten asynchronous sends with "operation_aborted" error.
+*              Access to shared variables is secured by "read_mutex" and "send_mutex" mutexes.
+************************************************************************************************************************/
+void ws_client_base::abort_waiters(void)
+{
+    read_mutex.lock();
+    std::deque<message_handler> waiters = std::move(read_waiters);
+    read_waiters.clear();
+    read_mutex.unlock();
+    send_mutex.lock();
+    std::deque<sent_handler> handlers = std::move(sent_handlers);
+    sent_handlers.clear();
+    send_messages_queue.clear();
+    stream_sources.clear();
+    write_in_progress = false;
+    send_mutex.unlock();
+    for(auto& waiter : waiters)
+        waiter(net::error::operation_aborted,std::vector<unsigned char>());
+    for(auto& handler : handlers)
+        if(handler)
+            handler(net::error::operation_aborted);
+}
+/************************************************************************************************************************
+* Function Name: wait_message
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): completion handler called with the read message
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "client_abstract::async_read_message". If the queue has a message,
+*              the handler is called at once with it, else it waits for the next received message.
+*              It fails with "not_connected" error if there's no connection.
+*              Messages handed to user "on_message" callback never reach pending reads.
+*              Access to the queue is secured by "read_mutex" mutex.
+************************************************************************************************************************/
+void ws_client_base::wait_message(message_handler handler)
+{
+    read_mutex.lock();
+    if(!read_messages_queue.empty())
+    {
+        std::vector<unsigned char> message = std::move(read_messages_queue.front());
+        read_messages_queue.pop_front();
+        read_mutex.unlock();
+        handler(boost::system::error_code(),std::move(message));
+        return;
+    }
+    if(!ongoing_connection.load())  //checked under the mutex, not to miss "abort_waiters" at disconnection
+    {
+        read_mutex.unlock();
+        handler(net::error::not_connected,std::vector<unsigned char>());
+        return;
+    }
+    read_waiters.push_back(std::move(handler));
+    read_mutex.unlock();
+}
+/************************************************************************************************************************
+* Function Name: send_message (2)
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): message to send as vector of unsigned characters
+*                  completion handler called once the message is written
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "client_abstract::async_send_message". The message is stored in the queue
+*              with its handler then written to the stream, the handler is called from the write handler.
+*              It fails with "not_connected" error if there's no connection.
+*              It fails with "bad_frame_payload" error if it is not valid text, refer to "valid_text".
+*              Access to the queue is secured by "send_mutex" mutex.
+*              The write order is given only if no write is in flight.
+************************************************************************************************************************/
+void ws_client_base::send_message(const std::vector<unsigned char>& message, sent_handler handler)
+{
+    if(!valid_text(message))
+    {
+        handler(websocket::error::bad_frame_payload);
+        return;
+    }
+    send_mutex.lock();
+    if(!ongoing_connection.load())  //checked under the mutex, not to miss "abort_waiters" at disconnection
+    {
+        send_mutex.unlock();
+        handler(net::error::not_connected);
+        return;
+    }
+    send_messages_queue.push_back(std::make_shared<const std::vector<unsigned char>>(message));
+    sent_handlers.push_back(std::move(handler));
+    bool start_write = !write_in_progress;  //no write in flight to continue with this message
+    write_in_progress = true;
+    send_mutex.unlock();
+    if(start_write)
+        this->write_message();  //call write message and give the write order
+}
+/************************************************************************************************************************
+* Function Name: send_stream
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): source filling the message fragments, returns 0 at the end of the message
+*                  completion handler called once the message is written
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "client_abstract::async_send_stream" to send a message of any size without
+*              holding it in memory. The source fills a buffer of up to 64KB for every fragment, refer to
+*              "send_fragments". It fails with "not_connected" error if there's no connection.
+*              Streamed messages are sent in binary frames whatever the connection's frames type, refer to "write_stream".
+************************************************************************************************************************/
+void ws_client_base::send_stream(stream_source source, sent_handler handler)
+{
+    send_fragments(Buffered_Fragments(std::move(source)),std::move(handler));
+}
+/************************************************************************************************************************
+* Function Name: send_file
+* Class name: ws_client_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): file path
+*                  offset of the range in the file, 0 by default
+*                  size of the range, 0 for the rest of the file by default
+* Parameters (out): NONE
+* Return value: true if the file is queued, false if there's no connection or the file can't be mapped or the range
+*               exceeds it
+* Description: User function to send a file range as one message without reading it into memory. The range is memory
+*              mapped and written in fragments of up to 64KB straight from the mapping, in order with the other
+*              messages, the mapping is released once it is written. Refer to "mapped_file.h".
+*              Files are sent in binary frames whatever the connection's frames type, refer to "write_stream".
+************************************************************************************************************************/
+bool ws_client_base::send_file(const std::string& path, std::size_t offset, std::size_t length)
+{
+    std::shared_ptr<const mapped_file> file = mapped_file::open(path,offset,length);
+    if(!file)
+        return false;
+    return send_fragments(File_Fragments(std::move(file)),nullptr);
+}
+/************************************************************************************************************************
+* Function Name: send_file (2)
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): file path
+*                  offset of the range in the file
+*                  size of the range, 0 for the rest of the file
+*                  completion handler called once the file is written
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "client_abstract::async_send_file", refer to "send_file". It fails with
+*              "bad_descriptor" error if the file can't be mapped or the range exceeds it, and with "not_connected"
+*              error if there's no connection.
+************************************************************************************************************************/
+void ws_client_base::send_file(const std::string& path, std::size_t offset, std::size_t length, sent_handler handler)
+{
+    std::shared_ptr<const mapped_file> file = mapped_file::open(path,offset,length);
+    if(!file)
+    {
+        handler(net::error::bad_descriptor);
+        return;
+    }
+    send_fragments(File_Fragments(std::move(file)),std::move(handler));
+}
+/************************************************************************************************************************
+* Function Name: send_fragments
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): source of the message fragments, returns an empty fragment at the end of the message
+*                  completion handler called once the message is written, may be empty
+* Parameters (out): NONE
+* Return value: true if the message is queued, false if there's no connection
+* Description: Internal function to queue a streamed message. A "stream_marker" takes its place in the queue, so it is
+*              written in order with the other messages, and its source is stored in "stream_sources". Once its turn
+*              comes, the source is called from the strand for every fragment of up to 64KB, refer to "write_stream".
+*              It fails with "not_connected" error if there's no connection.
+************************************************************************************************************************/
+bool ws_client_base::send_fragments(fragment_source source, sent_handler handler)
+{
+    send_mutex.lock();
+    if(!ongoing_connection.load())  //checked under the mutex, not to miss "abort_waiters" at disconnection
+    {
+        send_mutex.unlock();
+        if(handler)
+            handler(net::error::not_connected);
+        return false;
+    }
+    send_messages_queue.push_back(stream_marker());
+    sent_handlers.push_back(std::move(handler));
+    stream_sources.push_back(std::move(source));
+    bool start_write = !write_in_progress;  //no write in flight to continue with this message
+    write_in_progress = true;
+    send_mutex.unlock();
+    if(start_write)
+        this->write_message();  //call write message and give the write order
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: stream_marker
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: static
+* Running Thread: Caller thread or Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: empty payload marking a streamed message in "send_messages_queue"
+* Description: Internal function returning the payload queued for streamed messages, compared by address.
+************************************************************************************************************************/
+const shared_payload& ws_client_base::stream_marker(void)
+{
+    static const shared_payload marker = std::make_shared<const std::vector<unsigned char>>();
+    return marker;
+}
+/************************************************************************************************************************
+* Function Name: take_message
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, called from the strand by the writes only
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): next message to write and its completion handler
+* Return value: false if the queue is empty and the writes stop, else true
+* Description: Internal function to take the front message of "send_messages_queue" to be written.
+*              If it is a streamed message, its source is moved to "writing_source". Secured by "send_mutex" mutex.
+************************************************************************************************************************/
+bool ws_client_base::take_message(shared_payload& message, sent_handler& handler)
+{
+    send_mutex.lock();
+    if(send_messages_queue.empty()) //all messages are written, or aborted by disconnection
+    {
+        write_in_progress = false;  //next message gives the write order again
+        send_mutex.unlock();
+        return false;
+    }
+    message = std::move(send_messages_queue.front());
+    send_messages_queue.pop_front();    //read front then pop
+    handler = std::move(sent_handlers.front());
+    sent_handlers.pop_front();
+    if(message == stream_marker())
+    {
+        writing_source = std::move(stream_sources.front());
+        stream_sources.pop_front();
+    }
+    send_mutex.unlock();
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: take_batch
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, called from the strand by the writes only
+* Expected  Exception: No
+* Parameters (in): message taken by "take_message" and its completion handler, not a streamed message
+* Parameters (out): NONE
+* Return value: true if messages are gathered to "writing_batch" with the given one, else false
+* Description: Internal function to gather the given message and the small messages queued after it in
+*              "writing_batch", as long as they are not streamed messages and don't exceed "gather_size" bytes all.
+*              Otherwise the given message is left to be written alone, straight from its payload.
+*              Secured by "send_mutex" mutex.
+************************************************************************************************************************/
+bool ws_client_base::take_batch(shared_payload& message, sent_handler& handler)
+{
+    std::size_t batch_bytes = message->size();
+    send_mutex.lock();
+    while(!send_messages_queue.empty() && send_messages_queue.front() != stream_marker()
+        && batch_bytes + send_messages_queue.front()->size() <= gather_size)
+    {
+        if(writing_batch.empty())
+        {
+            writing_batch.push_back(std::move(message));
+            writing_batch_handlers.push_back(std::move(handler));
+        }
+        batch_bytes += send_messages_queue.front()->size();
+        writing_batch.push_back(std::move(send_messages_queue.front()));
+        send_messages_queue.pop_front();
+        writing_batch_handlers.push_back(std::move(sent_handlers.front()));
+        sent_handlers.pop_front();
+    }
+    send_mutex.unlock();
+    return !writing_batch.empty();
+}
+/************************************************************************************************************************
+* Function Name: settle_batch
+* Class name: ws_client_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, called from the strand by the writes only
+* Expected  Exception: No
+* Parameters (in): error code of the write
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function to release the written or failed messages of "writing_batch" and call their
+*              completion handlers, if any, with the error code of the write.
+************************************************************************************************************************/
+void ws_client_base::settle_batch(boost::system::error_code errcode)
+{
+    std::vector<sent_handler> handlers = std::move(writing_batch_handlers);
+    writing_batch_handlers.clear();
+    writing_batch.clear();
+    for(auto& handler : handlers)
+        if(handler) //asynchronous send, message is written or failed
+            handler(errcode);
+}
+/************************************************************************************************************************
+* Function Name: receive_message
+* Class name: ws_client
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Parameters (in): NONE
+* Expected  Exception: No
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal Asynchronous function called after a connection establishment.
+*              It contains its own handler as Lambda functions called upon receiving new message then
+*              "ws_client::receive_message" is called again after handler execution.
+*              This function exits completely at connection closure.
+*              The message is read into "read_data" vector and moved to the application without copying.
+*              A message of a binary frame that is not valid text for a text connection with validation closes it.
+*              Access to the queue and shared variables is secured by "read_mutex" mutex
+************************************************************************************************************************/
+void ws_client::receive_message(void)
+{
+    if(!stream->is_open())   //if stream is closed or there's no connection
+    {
+        this->disconnect(-1);
+        return;
+    }
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(active_callbacks && active_callbacks->on_chunk)  //chunks are handed to the user as they arrive, messages are not assembled
+    {
+        if(read_chunk.size() != stream_chunk_size)
+            read_chunk.resize(stream_chunk_size);
+        stream->async_read_some(net::buffer(read_chunk),net::bind_executor(*strand,[self_object](beast::error_code errcode,std::size_t bytes_received)
+        {
+            if(errcode == boost::beast::websocket::error::closed)
+            {
+                self_object->disconnect(0);   //stop session
+                return;
+            }
+            else if(errcode == boost::asio::error::eof)
+            {
+                self_object->disconnect(0);   //stop session
+                return;
+            }
+            else if(errcode)
+            {
+                self_object->disconnect(-1);
+                return;
+            }
+            self_object->notify_chunk(self_object->read_chunk.data(),bytes_received,self_object->stream->is_message_done());
+            self_object->receive_message(); //receive the next chunk
+        }));
+        return;
+    }
+    read_buffer.emplace(read_data); //dynamic buffer over the empty "read_data", the stream reads the message into it
+    stream->async_read(*read_buffer,net::bind_executor(*strand,[self_object](beast::error_code errcode,std::size_t bytes_received)
+    {
+        if(errcode == boost::beast::websocket::error::closed)
+        {
+            self_object->disconnect(0);   //stop session
+            return;
+        }
+        else if(errcode == boost::asio::error::eof)
+        {
+            self_object->disconnect(0);   //stop session
+            return;
+        }
+        else if(errcode)
+        {
+            self_object->disconnect(-1);
+            return;
+        }
+        boost::ignore_unused(bytes_received);   //the message size is the size of "read_data"
+        if (self_object->read_data.empty()) //empty message, receive again
+        {
+            self_object->receive_message();
+            return;
+        }
+        if(!self_object->stream->got_text() && !self_object->valid_text(self_object->read_data))    //text frames are validated by the stream
+        {
+            self_object->disconnect(-1);    //not valid text for a text connection with validation
+            return;
+        }
+        std::vector<unsigned char> received_data = std::move(self_object->read_data);   //take the received bytes, no copy
+        self_object->deliver_message(std::move(received_data)); //to user callback, pending read or the queue
+        self_object->receive_message(); //receive again
+    }));
+}
+/************************************************************************************************************************
+* Function Name: write_message
 * Class name: ws_client
 * Access: Protected
 * Specifiers: NONE
@@ -139,24 +1083,52 @@ inline bool ws_client_base::check_failed_connection(void)
 * Expected  Exception: No
 * Parameters (out): NONE
 * Return value: NONE
-* Description: Internal Asynchronous function called after a connection establishment.
-*              It contains its own handler as Lambda functions called upon receiving new message then
-*              "ws_client::receive_message" is called again after handler execution.
-*              This function exits completely at connection closure.
-*              Access to the queue and shared variables is secured by "read_mutex" mutex
+* Description: Internal Asynchronous function called by the first queued message when no write is in flight,
+*              then by its own write handler until the queue is drained, so only one write is in flight at a time.
+*              It runs on the strand, it is posted to it if called from another thread.
+*              It contains its own handler as Lambda functions called upon sending the new message to handle any error occurs.
+*              Access to the queue and shared variables is secured by "send_mutex" mutex
+*              The message's completion handler, if any, is called from the write handler.
+*              A streamed message is written by "write_stream", which calls this function after its last fragment.
+*              Small messages queued together are gathered and written by one write, refer to "write_gathered".
 ************************************************************************************************************************/
-void ws_client::receive_message(void)
+void ws_client::write_message(void)
 {
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(!strand->running_in_this_thread())   //stream operations run on the strand, beside the read
+    {
+        net::post(*strand,[self_object](){self_object->write_message();});
+        return;
+    }
     if(!stream->is_open())   //if stream is closed or there's no connection
     {
         this->disconnect(-1);
         return;
     }
-    std::shared_ptr<beast::flat_buffer> buffer = std::make_shared<beast::flat_buffer>();
-    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
-    auto self_object = shared_from_this();
-    stream->async_read(*buffer,net::bind_executor(*strand,[buffer,self_object](beast::error_code errcode,std::size_t bytes_received) mutable //mutable lambda expression
+    shared_payload message;
+    sent_handler handler;
+    if(!take_message(message,handler))  //all messages are written, or aborted by disconnection
+        return;
+    if(message == stream_marker())  //streamed message, written fragment by fragment from its source
+    {
+        writing_handler = std::move(handler);
+        stream->binary(true);   //any bytes, sent in binary frames whatever the frames type of the connection
+        this->write_stream();
+        return;
+    }
+    if(take_batch(message,handler)) //small queued messages, gathered and written together
+    {
+        stream->next_layer().gather();
+        this->write_gathered(0);
+        return;
+    }
+    net::const_buffer buffer(message->data(), message->size());
+    //the payload is captured to keep it alive until it is written
+    stream->async_write(buffer,net::bind_executor(*strand,[self_object,handler,message](beast::error_code errcode, std::size_t bytes_sent_dummy)
     {
+        if(handler) //asynchronous send, message is written or failed
+            handler(errcode);
         if(errcode == boost::beast::websocket::error::closed)
         {
             self_object->disconnect(0);   //stop session
@@ -167,57 +1139,129 @@ void ws_client::receive_message(void)
             self_object->disconnect(0);   //stop session
             return;
         }
-        else if(errcode)
+        else if(errcode) //failed to send, disconnect
         {
             self_object->disconnect(-1);
             return;
         }
-        if (buffer->size() == 0) //empty buffer, do nothing
-            self_object->receive_message();
-        auto date_buffer_ptr = net::buffer_cast<unsigned char*>(buffer->data()); //get ptr to the buffer for the "vector of unsigned char"
-        std::size_t data_size = buffer->size();
-        std::vector<unsigned char> received_data(date_buffer_ptr,date_buffer_ptr + data_size);  //store
-        self_object->read_mutex.lock();
-        self_object->read_messages_queue.push_back(received_data);  //push received data into the queue
-         self_object->read_mutex.unlock();
-        buffer->consume(bytes_received);   //clear the buffer
-        buffer->clear();
-        std::string rec_string(received_data.begin(),received_data.end());
-        self_object->receive_message();
+        boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        self_object->write_message();   //write the next queued message, one write in flight at a time
     }));
 }
 /************************************************************************************************************************
-* Function Name: write_message
+* Function Name: write_gathered
 * Class name: ws_client
 * Access: Protected
 * Specifiers: NONE
 * Running Thread: Pool thread
 * Sync/Async: Asynchronous
-* Reentrancy: Reentrant
-* Parameters (in): NONE
+* Reentrancy: Non-Reentrant, called from the strand by the writes only
+* Parameters (in): index of the next message of "writing_batch" to be framed
 * Expected  Exception: No
 * Parameters (out): NONE
 * Return value: NONE
-* Description: Internal Asynchronous function called after a each "ws_client_base::send_message" function call
-*              It contains its own handler as Lambda functions called upon sending the new message to handle any error occurs.
-*              Access to the queue and shared variables is secured by "send_mutex" mutex
+* Description: Internal Asynchronous function framing the messages of "writing_batch" one per call while the stream
+*              gathers them, each frame is appended to the gathering buffer and completed at once. After the last
+*              one, all frames are written by a single write of "gather_stream::async_flush", one syscall, then the
+*              messages handlers are called, refer to "settle_batch", and "write_message" writes the next queued
+*              messages.
 ************************************************************************************************************************/
-void ws_client::write_message(void)
+void ws_client::write_gathered(std::size_t index)
 {
-    if(!stream->is_open())   //if stream is closed or there's no connection
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(index == writing_batch.size())   //all messages are framed, write them at once
     {
-        this->disconnect(-1);
+        stream->next_layer().async_flush(net::bind_executor(*strand,[self_object](beast::error_code errcode)
+        {
+            self_object->settle_batch(errcode);
+            if(errcode == boost::beast::websocket::error::closed)
+            {
+                self_object->disconnect(0);   //stop session
+                return;
+            }
+            else if(errcode == boost::asio::error::eof)
+            {
+                self_object->disconnect(0);   //stop session
+                return;
+            }
+            else if(errcode) //failed to send, disconnect
+            {
+                self_object->disconnect(-1);
+                return;
+            }
+            self_object->write_message();   //write the next queued messages, one write in flight at a time
+        }));
         return;
     }
-    send_mutex.lock();
-    std::vector<unsigned char> message = send_messages_queue.front();
-    send_messages_queue.pop_front();    //read front then pop
-    send_mutex.unlock();
-    net::const_buffer buffer(message.data(), message.size());
+    net::const_buffer buffer(writing_batch[index]->data(), writing_batch[index]->size());
+    stream->async_write(buffer,net::bind_executor(*strand,[self_object,index](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    {
+        boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        if(!errcode)
+        {
+            self_object->write_gathered(index+1);   //frame the next message
+            return;
+        }
+        self_object->settle_batch(errcode);
+        //frames gathered before the failure are flushed, then the client is disconnected
+        self_object->stream->next_layer().async_flush(net::bind_executor(*self_object->strand,[self_object,errcode](beast::error_code)
+        {
+            if(errcode == boost::beast::websocket::error::closed || errcode == boost::asio::error::eof)
+                self_object->disconnect(0);   //stop session
+            else
+                self_object->disconnect(-1);
+        }));
+    }));
+}
+/************************************************************************************************************************
+* Function Name: write_stream
+* Class name: ws_client
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Non-Reentrant, called from the strand by the writes only
+* Parameters (in): NONE
+* Expected  Exception: No
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal Asynchronous function writing the streamed message of "writing_source", one fragment per
+*              call. The source returns the next fragment, written as a websocket frame without ending the message,
+*              its write handler calls this function again. Once the source returns an empty fragment, the
+*              final empty frame ends the message, "writing_handler" is called and "write_message" writes the next
+*              queued message. Only one fragment is held in memory. The message is sent in binary frames, the
+*              frames type of the connection is set back after its last fragment.
+*              A source that throws aborts the message, its handler fails and the connection is closed.
+************************************************************************************************************************/
+void ws_client::write_stream(void)
+{
     //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
     auto self_object = shared_from_this();
-    stream->async_write(buffer,net::bind_executor(*strand,[self_object](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    net::const_buffer fragment; //valid until "writing_source" is released
+    if(!next_fragment(fragment))    //user source failed, the message can't be completed
+    {
+        writing_source = nullptr;
+        sent_handler handler = std::move(writing_handler);
+        writing_handler = nullptr;
+        if(handler)
+            handler(net::error::operation_aborted);
+        this->disconnect(-1);
+        return;
+    }
+    bool last_fragment = fragment.size() == 0;
+    stream->async_write_some(last_fragment,fragment,
+        net::bind_executor(*strand,[self_object,last_fragment](beast::error_code errcode, std::size_t bytes_sent_dummy)
     {
+        if(errcode || last_fragment)    //message is written or failed
+        {
+            self_object->stream->binary(self_object->active_framing.mode == frame_mode::binary);  //back to the frames type of the connection
+            self_object->writing_source = nullptr;
+            sent_handler handler = std::move(self_object->writing_handler);
+            self_object->writing_handler = nullptr;
+            if(handler)
+                handler(errcode);
+        }
         if(errcode == boost::beast::websocket::error::closed)
         {
             self_object->disconnect(0);   //stop session
@@ -234,6 +1278,10 @@ void ws_client::write_message(void)
             return;
         }
         boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        if(last_fragment)
+            self_object->write_message();   //write the next queued message
+        else
+            self_object->write_stream();    //write the next fragment
     }));
 }
 /************************************************************************************************************************
@@ -275,40 +1323,58 @@ void ws_client::disconnect(int code)
         }
         catch(...){} //suppress exceptions, object is deleted afterwards
     }
+    abort_waiters();    //fail pending asynchronous operations
     read_messages_queue.clear();
     send_messages_queue.clear();
     connected_ip.clear();
     connected_port = 0;
     self_disconnected = true;
+    notify_close(); //connection is closed, notify the user
     std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending
 }
 /************************************************************************************************************************
-* Function Name: connect
+* Function Name: start_connect
 * Class name: ws_client
-* Access: Public
+* Access: Protected
 * Specifiers: NONE
 * Running Thread: Caller thread
-* Sync/Async: Synchronous
+* Sync/Async: Asynchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
-* Parameters (in): Server's IP address/host as string reference
+* Parameters (in): Server's IP address/host as string
 *                  Server's port dedicated for WebSocket connections
-* Parameters (out): connection status, successful/failed
-* Return value: connection status as boolean
-* Description: User function to connect to a host server. It tries to connect, if its timeout (30 seconds by default)
-*              passed it will reset connection and release resources and return false indicating failed connection.
-*              If connection is successful, it returns true.
+*                  completion handler called with the connection result
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "ws_client_base::connect" and "client_abstract::async_connect" to start
+*              connecting to a host server. It resolves, connects and handshakes asynchronously then calls the handler
+*              from the client's strand, with success once the connection is ready or with the error at failure.
 ************************************************************************************************************************/
-bool ws_client::connect(std::string& ip_address, unsigned short port)
+void ws_client::start_connect(std::string host_ip, unsigned short port, sent_handler handler)
 {
-    std::string host_ip = ip_address;
-    std::string host_port = std::to_string(port);
-    if(connected_ip == ip_address && connected_port == port && ongoing_connection.load() == true)
-        return true;    //if I tried to connect to already connected endpoint
-    else if(ongoing_connection.load() == true)
-        return false;   //if I tried to connect to another endpoint while I am connected to some endpoint
+    if(ongoing_connection.load() == true)
+    {
+        //connecting to already connected endpoint succeeds, to another endpoint while connected to some endpoint fails
+        handler((connected_ip == host_ip && connected_port == port) ? boost::system::error_code() : net::error::already_connected);
+        return;
+    }
+    connect_mutex.lock();
+    if(connect_handler) //another connection is pending
+    {
+        connect_mutex.unlock();
+        handler(net::error::already_started);
+        return;
+    }
+    connect_handler = std::move(handler);
+    connect_mutex.unlock();
     if(self_disconnected.load() == true)
         reset();    //if previous connection failed, reset resources
+    std::string host_port = std::to_string(port);
+    connected_ip = host_ip;
+    connected_port = port;
+    active_callbacks = std::make_shared<const client_callbacks>(callbacks);  //callbacks of this connection
+    active_compression = compression;   //compression options of this connection
+    active_framing = framing;   //frames type of this connection
     //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
     auto self_object = shared_from_this();
     resolver.async_resolve(host_ip,host_port,[host_ip,self_object](boost::system::error_code errcode, tcp::resolver::results_type result)   //resolve IP and port
@@ -317,19 +1383,17 @@ bool ws_client::connect(std::string& ip_address, unsigned short port)
         {
             self_object->ongoing_connection = true;
             self_object->disconnect(-1); //setting "ongoing_connection" by true, to be able to disconnect
+            self_object->complete_connect(errcode);
             return;
         }
-        net::async_connect(self_object->stream->next_layer(),result,    //TCP async connection (start connection)
+        net::async_connect(beast::get_lowest_layer(*self_object->stream),result,    //TCP async connection (start connection)
         [host_ip,self_object](boost::system::error_code errcode2, const tcp::endpoint endpoint)
         {
-            if(errcode2 == net::error::connection_refused)
-            {
-                return;
-            }
-            else if(errcode2)
+            if(errcode2)
             {
                 self_object->ongoing_connection = true;
                 self_object->disconnect(-1); //setting "ongoing_connection" by true, to be able to disconnect
+                self_object->complete_connect(errcode2);
                 return;
             }
             //**update host string, to provide the Host HTTP header during the websocket handshake**
@@ -340,37 +1404,29 @@ bool ws_client::connect(std::string& ip_address, unsigned short port)
             {
                 request.set(http::field::user_agent,std::string(BOOST_BEAST_VERSION_STRING)+"websocket-client-async");
             }));
-            self_object->stream->async_handshake(http_header,"/",[self_object](boost::system::error_code errcode3)   //websocket handshake
+            Set_Deflate(*self_object->stream,self_object->active_compression,false);    //offer permessage-deflate if enabled
+            self_object->stream->binary(self_object->active_framing.mode == frame_mode::binary);    //frames type of sent messages
+            self_object->stream->async_handshake(http_header,"/",net::bind_executor(*self_object->strand,[self_object](boost::system::error_code errcode3)   //websocket handshake
             {
                 if(errcode3)
                 {
                     self_object->ongoing_connection = true;
                     self_object->disconnect(-1); //setting "ongoing_connection" by true, to be able to disconnect
+                    self_object->complete_connect(errcode3);
                     return;
                 }
                 self_object->ongoing_connection = true;
                 //all function are successfull
+                self_object->notify_open();
                 self_object->receive_message(); //trigger receive message call
-            });
+                self_object->complete_connect(boost::system::error_code());  //connection is ready
+            }));
         });
     });
     client_pool = std::make_unique<net::thread_pool>(2); //create thread pool object of 2 threads, 1read/1write
     //run client context in different threads for read and write
     net::post(*client_pool,[this](){io_ctx->run();});
     net::post(*client_pool,[this](){io_ctx->run();});
-    //Boost's default handshake timeout connection for websocket is 30seconds
-    int i = 0;  //timeout check loop
-    while((i++<connection_timeout) && (!ongoing_connection.load()))
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    if(!ongoing_connection.load())  //if connection is not successfull
-    {
-        self_object->ongoing_connection = true; //setting "ongoing_connection" by true, to be able to run disconnect
-        self_object->disconnect(); //disconnect if not disconnected and reset
-        return false;
-    }
-    connected_ip = ip_address;
-    connected_port = port;
-    return true;
 }
 /************************************************************************************************************************
 * Function Name: disconnect (2)
@@ -402,15 +1458,18 @@ void ws_client::disconnect(void)
     client_pool.reset();    //destory/delete threads pool object
     stream.reset(); //reset stream
     strand.reset();//reset strand
-    io_ctx.reset(); //reset the unique pointer to destroy the underlaying object
-    io_ctx = std::make_unique<net::io_context>();   //create new object
+    std::unique_ptr<net::io_context> new_io_ctx = std::make_unique<net::io_context>();   //create new object
+    resolver = tcp::resolver(*new_io_ctx);  //rebind the resolver before destroying its io_context, to connect again
+    io_ctx = std::move(new_io_ctx); //destroy the underlaying object
     strand = std::make_unique<net::strand<net::io_context::executor_type>>(io_ctx->get_executor());
     stream = std::make_unique<ws_stream>(*io_ctx);//create new stream binded to the new io_context
+    abort_waiters();    //fail pending asynchronous operations
     read_messages_queue.clear();
     send_messages_queue.clear();
     connected_ip.clear();
     connected_port = 0;
     self_disconnected = false;
+    notify_close(); //connection is closed, notify the user
     std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending
 }
 /************************************************************************************************************************
@@ -438,8 +1497,9 @@ void ws_client::reset(void)
     client_pool.reset();    //destory/delete threads pool object
     stream.reset(); //reset stream
     strand.reset();
-    io_ctx.reset(); //reset the unique pointer to destroy the underlaying object
-    io_ctx = std::make_unique<net::io_context>();   //create new object
+    std::unique_ptr<net::io_context> new_io_ctx = std::make_unique<net::io_context>();   //create new object
+    resolver = tcp::resolver(*new_io_ctx);  //rebind the resolver before destroying its io_context, to connect again
+    io_ctx = std::move(new_io_ctx); //destroy the underlaying object
     strand = std::make_unique<net::strand<net::io_context::executor_type>>(io_ctx->get_executor());
     stream = std::make_unique<ws_stream>(*io_ctx);//create new stream binded to the new io_context
     self_disconnected = false;  //reset the boolean
@@ -461,6 +1521,8 @@ void ws_client::reset(void)
 *              It contains its own handler as Lambda functions called upon receiving new message then
 *              "wss_client::receive_message" is called again after handler execution.
 *              This function exits completely at connection closure.
+*              The message is read into "read_data" vector and moved to the application without copying.
+*              A message of a binary frame that is not valid text for a text connection with validation closes it.
 *              Access to the queue and shared variables is secured by "read_mutex" mutex
 ************************************************************************************************************************/
 void wss_client::receive_message(void)
@@ -470,10 +1532,36 @@ void wss_client::receive_message(void)
         this->disconnect(-1);
         return;
     }
-    std::shared_ptr<beast::flat_buffer> buffer = std::make_shared<beast::flat_buffer>();
     //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
     auto self_object = shared_from_this();
-    stream->async_read(*buffer,net::bind_executor(*strand,[buffer,self_object](beast::error_code errcode,std::size_t bytes_received) mutable //mutable lambda expression
+    if(active_callbacks && active_callbacks->on_chunk)  //chunks are handed to the user as they arrive, messages are not assembled
+    {
+        if(read_chunk.size() != stream_chunk_size)
+            read_chunk.resize(stream_chunk_size);
+        stream->async_read_some(net::buffer(read_chunk),net::bind_executor(*strand,[self_object](beast::error_code errcode,std::size_t bytes_received)
+        {
+            if(errcode == boost::beast::websocket::error::closed)
+            {
+                self_object->disconnect(0);   //stop session
+                return;
+            }
+            else if(errcode == boost::asio::error::eof)
+            {
+                self_object->disconnect(0);   //stop session
+                return;
+            }
+            else if(errcode)
+            {
+                self_object->disconnect(-1);
+                return;
+            }
+            self_object->notify_chunk(self_object->read_chunk.data(),bytes_received,self_object->stream->is_message_done());
+            self_object->receive_message(); //receive the next chunk
+        }));
+        return;
+    }
+    read_buffer.emplace(read_data); //dynamic buffer over the empty "read_data", the stream reads the message into it
+    stream->async_read(*read_buffer,net::bind_executor(*strand,[self_object](beast::error_code errcode,std::size_t bytes_received)
     {
         if(errcode == boost::beast::websocket::error::closed)
         {
@@ -490,18 +1578,20 @@ void wss_client::receive_message(void)
             self_object->disconnect(-1);
             return;
         }
-        if (buffer->size() == 0) //empty buffer, do nothing
+        boost::ignore_unused(bytes_received);   //the message size is the size of "read_data"
+        if (self_object->read_data.empty()) //empty message, receive again
+        {
             self_object->receive_message();
-        auto date_buffer_ptr = net::buffer_cast<unsigned char*>(buffer->data()); //get ptr to the buffer for the "vector of unsigned char"
-        std::size_t data_size = buffer->size();
-        std::vector<unsigned char> received_data(date_buffer_ptr,date_buffer_ptr + data_size);  //store
-        self_object->read_mutex.lock();
-        self_object->read_messages_queue.push_back(received_data);  //push received data into the queue
-        self_object->read_mutex.unlock();
-        buffer->consume(bytes_received);   //clear the buffer
-        buffer->clear();
-        std::string rec_string(received_data.begin(),received_data.end());
-        self_object->receive_message();
+            return;
+        }
+        if(!self_object->stream->got_text() && !self_object->valid_text(self_object->read_data))    //text frames are validated by the stream
+        {
+            self_object->disconnect(-1);    //not valid text for a text connection with validation
+            return;
+        }
+        std::vector<unsigned char> received_data = std::move(self_object->read_data);   //take the received bytes, no copy
+        self_object->deliver_message(std::move(received_data)); //to user callback, pending read or the queue
+        self_object->receive_message(); //receive again
     }));
 }
 /************************************************************************************************************************
@@ -516,26 +1606,185 @@ void wss_client::receive_message(void)
 * Expected  Exception: No
 * Parameters (out): NONE
 * Return value: NONE
-* Description: Internal Asynchronous function called after a each "ws_client_base::send_message" function call
+* Description: Internal Asynchronous function called by the first queued message when no write is in flight,
+*              then by its own write handler until the queue is drained, so only one write is in flight at a time.
+*              It runs on the strand, it is posted to it if called from another thread.
 *              It contains its own handler as Lambda functions called upon sending the new message to handle any error occurs.
 *              Access to the queue and shared variables is secured by "send_mutex" mutex
+*              The message's completion handler, if any, is called from the write handler.
+*              A streamed message is written by "write_stream", which calls this function after its last fragment.
+*              Small messages queued together are gathered and written by one write, refer to "write_gathered".
 ************************************************************************************************************************/
 void wss_client::write_message(void)
 {
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(!strand->running_in_this_thread())   //stream operations run on the strand, beside the read
+    {
+        net::post(*strand,[self_object](){self_object->write_message();});
+        return;
+    }
     if(!stream->is_open())   //if stream is closed or there's no connection
     {
         this->disconnect(-1);
         return;
     }
-    send_mutex.lock();
-    std::vector<unsigned char> message = send_messages_queue.front();
-    send_messages_queue.pop_front();    //read front then pop
-    send_mutex.unlock();
-    net::const_buffer buffer(message.data(), message.size());
+    shared_payload message;
+    sent_handler handler;
+    if(!take_message(message,handler))  //all messages are written, or aborted by disconnection
+        return;
+    if(message == stream_marker())  //streamed message, written fragment by fragment from its source
+    {
+        writing_handler = std::move(handler);
+        stream->binary(true);   //any bytes, sent in binary frames whatever the frames type of the connection
+        this->write_stream();
+        return;
+    }
+    if(take_batch(message,handler)) //small queued messages, gathered and written together
+    {
+        stream->next_layer().gather();
+        this->write_gathered(0);
+        return;
+    }
+    net::const_buffer buffer(message->data(), message->size());
+    //the payload is captured to keep it alive until it is written
+    stream->async_write(buffer,net::bind_executor(*strand,[self_object,handler,message](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    {
+        if(handler) //asynchronous send, message is written or failed
+            handler(errcode);
+        if(errcode == boost::beast::websocket::error::closed)
+        {
+            self_object->disconnect(0);   //stop session
+            return;
+        }
+        else if(errcode == boost::asio::error::eof)
+        {
+            self_object->disconnect(0);   //stop session
+            return;
+        }
+        else if(errcode) //failed to send, disconnect
+        {
+            self_object->disconnect(-1);
+            return;
+        }
+        boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        self_object->write_message();   //write the next queued message, one write in flight at a time
+    }));
+}
+/************************************************************************************************************************
+* Function Name: write_gathered
+* Class name: wss_client
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Non-Reentrant, called from the strand by the writes only
+* Parameters (in): index of the next message of "writing_batch" to be framed
+* Expected  Exception: No
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal Asynchronous function framing the messages of "writing_batch" one per call while the stream
+*              gathers them, each frame is appended to the gathering buffer and completed at once. After the last
+*              one, all frames are written by a single write of "gather_stream::async_flush", one syscall, then the
+*              messages handlers are called, refer to "settle_batch", and "write_message" writes the next queued
+*              messages.
+************************************************************************************************************************/
+void wss_client::write_gathered(std::size_t index)
+{
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(index == writing_batch.size())   //all messages are framed, write them at once
+    {
+        stream->next_layer().async_flush(net::bind_executor(*strand,[self_object](beast::error_code errcode)
+        {
+            self_object->settle_batch(errcode);
+            if(errcode == boost::beast::websocket::error::closed)
+            {
+                self_object->disconnect(0);   //stop session
+                return;
+            }
+            else if(errcode == boost::asio::error::eof)
+            {
+                self_object->disconnect(0);   //stop session
+                return;
+            }
+            else if(errcode) //failed to send, disconnect
+            {
+                self_object->disconnect(-1);
+                return;
+            }
+            self_object->write_message();   //write the next queued messages, one write in flight at a time
+        }));
+        return;
+    }
+    net::const_buffer buffer(writing_batch[index]->data(), writing_batch[index]->size());
+    stream->async_write(buffer,net::bind_executor(*strand,[self_object,index](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    {
+        boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        if(!errcode)
+        {
+            self_object->write_gathered(index+1);   //frame the next message
+            return;
+        }
+        self_object->settle_batch(errcode);
+        //frames gathered before the failure are flushed, then the client is disconnected
+        self_object->stream->next_layer().async_flush(net::bind_executor(*self_object->strand,[self_object,errcode](beast::error_code)
+        {
+            if(errcode == boost::beast::websocket::error::closed || errcode == boost::asio::error::eof)
+                self_object->disconnect(0);   //stop session
+            else
+                self_object->disconnect(-1);
+        }));
+    }));
+}
+/************************************************************************************************************************
+* Function Name: write_stream
+* Class name: wss_client
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Non-Reentrant, called from the strand by the writes only
+* Parameters (in): NONE
+* Expected  Exception: No
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal Asynchronous function writing the streamed message of "writing_source", one fragment per
+*              call. The source returns the next fragment, written as a websocket frame without ending the message,
+*              its write handler calls this function again. Once the source returns an empty fragment, the
+*              final empty frame ends the message, "writing_handler" is called and "write_message" writes the next
+*              queued message. Only one fragment is held in memory. The message is sent in binary frames, the
+*              frames type of the connection is set back after its last fragment.
+*              A source that throws aborts the message, its handler fails and the connection is closed.
+************************************************************************************************************************/
+void wss_client::write_stream(void)
+{
     //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
     auto self_object = shared_from_this();
-    stream->async_write(buffer,net::bind_executor(*strand,[self_object](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    net::const_buffer fragment; //valid until "writing_source" is released
+    if(!next_fragment(fragment))    //user source failed, the message can't be completed
     {
+        writing_source = nullptr;
+        sent_handler handler = std::move(writing_handler);
+        writing_handler = nullptr;
+        if(handler)
+            handler(net::error::operation_aborted);
+        this->disconnect(-1);
+        return;
+    }
+    bool last_fragment = fragment.size() == 0;
+    stream->async_write_some(last_fragment,fragment,
+        net::bind_executor(*strand,[self_object,last_fragment](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    {
+        if(errcode || last_fragment)    //message is written or failed
+        {
+            self_object->stream->binary(self_object->active_framing.mode == frame_mode::binary);  //back to the frames type of the connection
+            self_object->writing_source = nullptr;
+            sent_handler handler = std::move(self_object->writing_handler);
+            self_object->writing_handler = nullptr;
+            if(handler)
+                handler(errcode);
+        }
         if(errcode == boost::beast::websocket::error::closed)
         {
             self_object->disconnect(0);   //stop session
@@ -552,6 +1801,10 @@ void wss_client::write_message(void)
             return;
         }
         boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        if(last_fragment)
+            self_object->write_message();   //write the next queued message
+        else
+            self_object->write_stream();    //write the next fragment
     }));
 }
 /************************************************************************************************************************
@@ -593,40 +1846,63 @@ void wss_client::disconnect(int code)
         }
         catch(...){} //suppress exceptions, object is deleted afterwards
     }
+    abort_waiters();    //fail pending asynchronous operations
     read_messages_queue.clear();
     send_messages_queue.clear();
     connected_ip.clear();
     connected_port = 0;
     self_disconnected = true;
+    notify_close(); //connection is closed, notify the user
     std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending
 }
 /************************************************************************************************************************
-* Function Name: connect
+* Function Name: start_connect
 * Class name: wss_client
-* Access: Public
+* Access: Protected
 * Specifiers: NONE
 * Running Thread: Caller thread
-* Sync/Async: Synchronous
+* Sync/Async: Asynchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
-* Parameters (in): Server's IP address/host as string reference
+* Parameters (in): Server's IP address/host as string
 *                  Server's port dedicated for WebSocket connections
-* Parameters (out): connection status, successful/failed
-* Return value: connection status as boolean
-* Description: User function to connect to a host server. It tries to connect, if its timeout (30 seconds by default)
-*              passed it will reset connection and release resources and return false indicating failed connection.
-*              If connection is successful, it returns true.
+*                  completion handler called with the connection result
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "ws_client_base::connect" and "client_abstract::async_connect" to start
+*              connecting to a host server. It resolves, connects and handshakes asynchronously then calls the handler
+*              from the client's strand, with success once the connection is ready or with the error at failure.
 ************************************************************************************************************************/
-bool wss_client::connect(std::string& ip_address, unsigned short port)
+void wss_client::start_connect(std::string host_ip, unsigned short port, sent_handler handler)
 {
-    std::string host_ip = ip_address;
-    std::string host_port = std::to_string(port);
-    if(connected_ip == ip_address && connected_port == port && ongoing_connection.load() == true)
-        return true;    //if I tried to connect to already connected endpoint
-    else if(ongoing_connection.load() == true)
-        return false;   //if I tried to connect to another endpoint while I am connected to some endpoint
+    if(ongoing_connection.load() == true)
+    {
+        //connecting to already connected endpoint succeeds, to another endpoint while connected to some endpoint fails
+        handler((connected_ip == host_ip && connected_port == port) ? boost::system::error_code() : net::error::already_connected);
+        return;
+    }
+    connect_mutex.lock();
+    if(connect_handler) //another connection is pending
+    {
+        connect_mutex.unlock();
+        handler(net::error::already_started);
+        return;
+    }
+    connect_handler = std::move(handler);
+    connect_mutex.unlock();
     if(self_disconnected.load() == true)
         reset();    //if previous connection failed, reset resources
+    std::string host_port = std::to_string(port);
+    connected_ip = host_ip;
+    connected_port = port;
+    active_callbacks = std::make_shared<const client_callbacks>(callbacks);  //callbacks of this connection
+    active_compression = compression;   //compression options of this connection
+    active_framing = framing;   //frames type of this connection
+    if(session_resumption && !session_cache)
+        session_cache = std::make_shared<tls_session_cache>();  //own cache, kept across reconnections
+    session_slot.cache = session_resumption ? session_cache : nullptr;
+    session_slot.host = host_ip + ':' + host_port;
+    Resume_TLS_Session(stream->next_layer().next_layer().native_handle(),session_slot);    //offer the former session of the host
     //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
     auto self_object = shared_from_this();
     resolver.async_resolve(host_ip,host_port,[host_ip,self_object](boost::system::error_code errcode, tcp::resolver::results_type result)   //resolve IP and port
@@ -635,57 +1911,63 @@ bool wss_client::connect(std::string& ip_address, unsigned short port)
         {
             self_object->ongoing_connection = true;
             self_object->disconnect(-1); //setting "ongoing_connection" by true, to be able to disconnect
+            self_object->complete_connect(errcode);
             return;
         }
-        net::async_connect(self_object->stream->next_layer().next_layer(),result,    //TCP async connection (start connection)
+        net::async_connect(beast::get_lowest_layer(*self_object->stream),result,    //TCP async connection (start connection)
         [host_ip,self_object](boost::system::error_code errcode2, const tcp::endpoint endpoint)
         {
-            if(errcode2 == net::error::connection_refused)
-            {
-                return;
-            }
-            else if(errcode2)
+            if(errcode2)
             {
                 self_object->ongoing_connection = true;
                 self_object->disconnect(-1); //setting "ongoing_connection" by true, to be able to disconnect
+                self_object->complete_connect(errcode2);
                 return;
             }
             //**update host string, to provide the Host HTTP header during the websocket handshake**
             std::string http_header = host_ip + ':' + std::to_string(endpoint.port());
             //**Set Server Name Indication (SNI) hostname, (many hosts need this to handshake successfully)**
-            if(!SSL_set_tlsext_host_name(self_object->stream->next_layer().native_handle(),http_header.c_str()))
+            if(!SSL_set_tlsext_host_name(self_object->stream->next_layer().next_layer().native_handle(),http_header.c_str()))
             {
                 self_object->ongoing_connection = true;
                 self_object->disconnect(-1); //setting "ongoing_connection" by true, to be able to disconnect
+                self_object->complete_connect(net::error::invalid_argument);
                 return;
             }
             //SSL handshake, client side
-            self_object->stream->next_layer().async_handshake(ssl::stream_base::client,[http_header,self_object](boost::system::error_code errcode3)
+            self_object->stream->next_layer().next_layer().async_handshake(ssl::stream_base::client,[http_header,self_object](boost::system::error_code errcode3)
             {
                 if(errcode3)
                 {
                     self_object->ongoing_connection = true;
                     self_object->disconnect(-1); //setting "ongoing_connection" by true, to be able to disconnect
+                    self_object->complete_connect(errcode3);
                     return;
                 }
+                self_object->handshakes.count(self_object->stream->next_layer().next_layer().native_handle());   //full or resumed handshake
                 //set the suggested timeout settings for the websocket as the client
                 self_object->stream->set_option(websocket::stream_base::timeout::suggested(beast::role_type::client));
                 self_object->stream->set_option(websocket::stream_base::decorator([](websocket::request_type& request) //***
                 {
                     request.set(http::field::user_agent,std::string(BOOST_BEAST_VERSION_STRING)+"websocket-client-async-ssl");
                 }));
-                self_object->stream->async_handshake(http_header,"/",[self_object](boost::system::error_code errcode4) //websocket handshake
+                Set_Deflate(*self_object->stream,self_object->active_compression,false);    //offer permessage-deflate if enabled
+                self_object->stream->binary(self_object->active_framing.mode == frame_mode::binary);    //frames type of sent messages
+                self_object->stream->async_handshake(http_header,"/",net::bind_executor(*self_object->strand,[self_object](boost::system::error_code errcode4) //websocket handshake
                 {
                     if(errcode4)
                     {
                         self_object->ongoing_connection = true;
                         self_object->disconnect(-1); //setting "ongoing_connection" by true, to be able to disconnect
+                        self_object->complete_connect(errcode4);
                         return;
                     }
                     self_object->ongoing_connection = true;
                     //all function are successfull
+                    self_object->notify_open();
                     self_object->receive_message(); //trigger receive message call
-                });
+                    self_object->complete_connect(boost::system::error_code());  //connection is ready
+                }));
             });
         });
     });
@@ -693,19 +1975,6 @@ bool wss_client::connect(std::string& ip_address, unsigned short port)
     //run client context in different threads for read and write
     net::post(*client_pool,[this](){io_ctx->run();});
     net::post(*client_pool,[this](){io_ctx->run();});
-    //Boost's default handshake timeout connection for websocket is 30seconds
-    int i = 0; //timeout check loop
-    while((i++<connection_timeout) && (!ongoing_connection.load()))
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    if(!ongoing_connection.load())  //if connection is not successfull
-    {
-        self_object->ongoing_connection = true; //setting "ongoing_connection" by true, to be able to run disconnect
-        self_object->disconnect(); //disconnect if not disconnected and reset
-        return false;
-    }
-    connected_ip = ip_address;
-    connected_port = port;
-    return true;
 }
 /************************************************************************************************************************
 * Function Name: disconnect (2)
@@ -737,15 +2006,18 @@ void wss_client::disconnect(void)
     client_pool.reset();    //destory/delete threads pool object
     stream.reset(); //reset stream
     strand.reset(); //reset strand
-    io_ctx.reset(); //reset the unique pointer to destroy the underlaying object
-    io_ctx = std::make_unique<net::io_context>();   //create new object
+    std::unique_ptr<net::io_context> new_io_ctx = std::make_unique<net::io_context>();   //create new object
+    resolver = tcp::resolver(*new_io_ctx);  //rebind the resolver before destroying its io_context, to connect again
+    io_ctx = std::move(new_io_ctx); //destroy the underlaying object
     strand = std::make_unique<net::strand<net::io_context::executor_type>>(io_ctx->get_executor());
-    stream = std::make_unique<wss_stream>(*io_ctx,ssl_ctx);//create new stream binded to the new io_context
+    stream = std::make_unique<wss_stream>(*io_ctx,tls->native());//create new stream binded to the new io_context
+    abort_waiters();    //fail pending asynchronous operations
     read_messages_queue.clear();
     send_messages_queue.clear();
     connected_ip.clear();
     connected_port = 0;
     self_disconnected = false;
+    notify_close(); //connection is closed, notify the user
     std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending
 }
 /************************************************************************************************************************
@@ -773,10 +2045,11 @@ void wss_client::reset(void)
     client_pool.reset();    //destory/delete threads pool object
     stream.reset(); //reset stream
     strand.reset();
-    io_ctx.reset(); //reset the unique pointer to destroy the underlaying object
-    io_ctx = std::make_unique<net::io_context>();   //create new object
+    std::unique_ptr<net::io_context> new_io_ctx = std::make_unique<net::io_context>();   //create new object
+    resolver = tcp::resolver(*new_io_ctx);  //rebind the resolver before destroying its io_context, to connect again
+    io_ctx = std::move(new_io_ctx); //destroy the underlaying object
     strand = std::make_unique<net::strand<net::io_context::executor_type>>(io_ctx->get_executor());
-    stream = std::make_unique<wss_stream>(*io_ctx,ssl_ctx);//create new stream binded to the new io_context
+    stream = std::make_unique<wss_stream>(*io_ctx,tls->native());//create new stream binded to the new io_context
     self_disconnected = false;  //reset the boolean
     std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before reseting
 }
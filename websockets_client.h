@@ -43,10 +43,20 @@
 #include <unordered_set>
 #include <memory>
 #include <deque>
+#include <optional>
 #include <chrono>
 #include <thread>
 #include <functional>
+#include <future>
+#include <mutex>
 #include "ssl_conf.h"
+#include "ws_message.h"
+#include "deflate_conf.h"
+#include "utf8_validator.h"
+#include "mapped_file.h"
+#include "tls_session.h"
+#include "tls_context.h"
+#include "gather_stream.h"
 #include <iostream>
 /************************************************************************************************************************
  *                     							   NAMESPACES
@@ -67,8 +77,22 @@ class wss_client;
 /***********************************************************************************************************************
  *                                                  ALIASES
  ***********************************************************************************************************************/
-using ws_stream = websocket::stream<tcp::socket>;   //stream type for websockets
-using wss_stream = websocket::stream<beast::ssl_stream<tcp::socket>>; //stream type for websockets secure
+using ws_stream = websocket::stream<gather_stream<tcp::socket>>;   //stream type for websockets
+using wss_stream = websocket::stream<gather_stream<beast::ssl_stream<tcp::socket>>>; //stream type for websockets secure
+using message_handler = std::function<void(boost::system::error_code,std::vector<unsigned char>)>;   //completion of a message read
+using sent_handler = std::function<void(boost::system::error_code)>;    //completion of a message write or a connection
+using received_buffer = net::dynamic_vector_buffer<unsigned char,std::allocator<unsigned char>>;   //dynamic buffer reading a message into a vector
+using stream_source = std::function<std::size_t(unsigned char*,std::size_t)>;  //fills the next fragment of a streamed message, returns its size, 0 ends the message
+/***********************************************************************************************************************
+ *                                                  STRUCTS
+ ***********************************************************************************************************************/
+struct client_callbacks    //user callbacks of the client, called from the client's strand
+{
+    std::function<void(void)> on_open;  //called after the connection handshake
+    std::function<void(std::vector<unsigned char>&&)> on_message;  //called with received message, message is not queued
+    std::function<void(void)> on_close; //called after an opened connection closure
+    std::function<void(const unsigned char*,std::size_t,bool)> on_chunk;   //called with each received chunk, true at the end of the message, messages are not assembled
+};
 /***********************************************************************************************************************
  *                                                  CLASSES
  ***********************************************************************************************************************/
@@ -95,10 +119,32 @@ protected:
     std::mutex read_mutex;      //mutex for reading buffer
     std::mutex send_mutex;      //mutex for sending buffer
     std::deque<std::vector<unsigned char>> read_messages_queue;  //queue to store messages to read
-    std::deque<std::vector<unsigned char>> send_messages_queue;  //queue to store messages to send
+    std::deque<shared_payload> send_messages_queue;  //queue to store messages to send
+    client_callbacks callbacks; //user callbacks set by the user, applied at next connect
+    std::shared_ptr<const client_callbacks> active_callbacks;   //user callbacks of the current connection
+    deflate_options compression;    //permessage-deflate options set by the user, applied at next connect
+    deflate_options active_compression; //permessage-deflate options offered by the current connection
+    frame_options framing;  //frames type and text validation set by the user, applied at next connect
+    frame_options active_framing;   //frames type and text validation of the current connection
+    bool session_resumption = true; //resume former TLS sessions, set by the user, applied at next connect
+    std::shared_ptr<tls_session_cache> session_cache;   //TLS sessions cache set by the user, created at first connect if empty
+    tls_session_slot session_slot;  //TLS sessions cache and host of the current connection
+    tls_counters handshakes;    //full and resumed TLS handshakes of the client connections
+    std::atomic<bool> opened = false;   //boolean set after "on_open" call, "on_close" is called only for opened connections
+    std::deque<message_handler> read_waiters;   //pending asynchronous reads waiting for messages, secured by "read_mutex"
+    std::deque<sent_handler> sent_handlers;     //completions of "send_messages_queue" messages, secured by "send_mutex"
+    std::deque<fragment_source> stream_sources;   //sources of the streamed messages queued as "stream_marker", secured by "send_mutex"
+    bool write_in_progress = false; //a write is in flight and its handler writes the next message, secured by "send_mutex"
+    std::mutex connect_mutex;   //mutex for "connect_handler"
+    sent_handler connect_handler;   //completion of the pending connection
 protected:
     client_abstract(void) = default;    //default non-parameterized constructor
     virtual ~client_abstract(void) = default;
+    virtual void start_connect(std::string, unsigned short, sent_handler) = 0;  //start connection, handler is called at its end
+    virtual void wait_message(message_handler) = 0; //read message from Queue, or wait for the next one
+    virtual void send_message(const std::vector<unsigned char>&, sent_handler) = 0; //send message, handler is called once written
+    virtual void send_stream(stream_source, sent_handler) = 0;  //send streamed message in fragments, handler is called once written
+    virtual void send_file(const std::string&, std::size_t, std::size_t, sent_handler) = 0;    //send file range, handler is called once written
     virtual void receive_message(void) = 0; //receive message from stream
     virtual void write_message(void) = 0;   //write message into stream
     virtual void disconnect(int) = 0;   //self disconnection
@@ -109,8 +155,89 @@ public:
     virtual void disconnect(void) = 0;  //gracefull disconnection
     virtual std::vector<unsigned char> read_message(void) = 0;  //read message from Queue
     virtual void send_message(const std::vector<unsigned char>&) = 0; //send message to Queue
+    virtual void send_messages(const std::vector<std::vector<unsigned char>>&) = 0;   //send batch of messages to Queue at once
+    virtual bool send_file(const std::string&, std::size_t = 0, std::size_t = 0) = 0;  //send file range from its mapping to Queue
+    virtual ws_message read_shared_message(void) = 0;   //read message from Queue as shared message
+    virtual void send_message(const ws_message&) = 0;   //send shared message to Queue, its bytes are not copied
+    virtual void send_messages(const std::vector<ws_message>&) = 0;  //send batch of shared messages to Queue at once
     virtual bool check_connection(void) = 0;    // check client connection
     virtual bool check_inbox(void) = 0; //check read inbox
+    virtual void set_on_open(std::function<void(void)>) = 0;   //set callback of connection opening, applied at next connect
+    virtual void set_on_message(std::function<void(std::vector<unsigned char>&&)>) = 0;   //set callback of received messages instead of inbox, applied at next connect
+    virtual void set_on_close(std::function<void(void)>) = 0;  //set callback of connection closure, applied at next connect
+    virtual void set_on_chunk(std::function<void(const unsigned char*,std::size_t,bool)>) = 0;  //set callback of received chunks instead of messages, applied at next connect
+    virtual bool set_compression(const deflate_options&) = 0;   //set permessage-deflate options offered to server, applied at next connect
+    virtual void set_frame_options(const frame_options&) = 0;   //set frames type of sent messages and text validation, applied at next connect
+    virtual void set_session_cache(std::shared_ptr<tls_session_cache>) = 0; //share TLS sessions cache, empty disables resumption, applied at next connect
+    virtual tls_stats handshake_stats(void) = 0;    //full and resumed TLS handshakes of the client connections
+    /*====================== Asynchronous operations, for any completion token such as "net::use_awaitable" =========*/
+    template<typename CompletionToken>
+    auto async_connect(std::string host, unsigned short port, CompletionToken&& token)   //completion: void(error_code)
+    {
+        return net::async_initiate<CompletionToken,void(boost::system::error_code)>([this](auto handler,std::string host_ip,unsigned short host_port)
+        {
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            auto handler_executor = net::get_associated_executor(*shared_handler);
+            this->start_connect(std::move(host_ip),host_port,[shared_handler,handler_executor](boost::system::error_code errcode)
+            {
+                net::post(handler_executor,[shared_handler,errcode](){(*shared_handler)(errcode);});
+            });
+        },token,std::move(host),port);
+    }
+    template<typename CompletionToken>
+    auto async_read_message(CompletionToken&& token)   //completion: void(error_code, std::vector<unsigned char>)
+    {
+        return net::async_initiate<CompletionToken,void(boost::system::error_code,std::vector<unsigned char>)>([this](auto handler)
+        {
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            auto handler_executor = net::get_associated_executor(*shared_handler);
+            this->wait_message([shared_handler,handler_executor](boost::system::error_code errcode,std::vector<unsigned char> message)
+            {
+                net::post(handler_executor,[shared_handler,errcode,message = std::move(message)]() mutable
+                    {(*shared_handler)(errcode,std::move(message));});
+            });
+        },token);
+    }
+    template<typename CompletionToken>
+    auto async_send_message(const std::vector<unsigned char>& message, CompletionToken&& token)   //completion: void(error_code)
+    {
+        return net::async_initiate<CompletionToken,void(boost::system::error_code)>([this](auto handler,const std::vector<unsigned char>& msg)
+        {
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            auto handler_executor = net::get_associated_executor(*shared_handler);
+            this->send_message(msg,[shared_handler,handler_executor](boost::system::error_code errcode)
+            {
+                net::post(handler_executor,[shared_handler,errcode](){(*shared_handler)(errcode);});
+            });
+        },token,message);
+    }
+    template<typename CompletionToken>
+    auto async_send_stream(stream_source source, CompletionToken&& token)   //completion: void(error_code)
+    {
+        return net::async_initiate<CompletionToken,void(boost::system::error_code)>([this](auto handler,stream_source message_source)
+        {
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            auto handler_executor = net::get_associated_executor(*shared_handler);
+            this->send_stream(std::move(message_source),[shared_handler,handler_executor](boost::system::error_code errcode)
+            {
+                net::post(handler_executor,[shared_handler,errcode](){(*shared_handler)(errcode);});
+            });
+        },token,std::move(source));
+    }
+    template<typename CompletionToken>
+    auto async_send_file(const std::string& path, std::size_t offset, std::size_t length, CompletionToken&& token)   //completion: void(error_code)
+    {
+        return net::async_initiate<CompletionToken,void(boost::system::error_code)>([this](auto handler,
+            const std::string& file_path,std::size_t file_offset,std::size_t file_length)
+        {
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            auto handler_executor = net::get_associated_executor(*shared_handler);
+            this->send_file(file_path,file_offset,file_length,[shared_handler,handler_executor](boost::system::error_code errcode)
+            {
+                net::post(handler_executor,[shared_handler,errcode](){(*shared_handler)(errcode);});
+            });
+        },token,path,offset,length);
+    }
 };
 /************************************************************************************************************************
 * Class Name: ws_client_base
@@ -134,16 +261,57 @@ protected:
     tcp::resolver resolver;     //ip and port resolver
     std::unique_ptr<net::thread_pool> client_pool;  //threads pool the client (unique pointer), default=2, 1read/1write
     std::unique_ptr<net::strand<net::io_context::executor_type>> strand;//strand to io_context to prevent racing between the threads for the async operations
+    std::vector<unsigned char> read_data;   //bytes of the message being received, moved to the application at its end
+    std::optional<received_buffer> read_buffer; //dynamic buffer over "read_data", the stream reads into it
+    std::vector<unsigned char> read_chunk;  //chunk of the message being received, with "on_chunk" callback
+    fragment_source writing_source; //source of the streamed message being written, used on the strand only
+    sent_handler writing_handler;   //completion of the streamed message being written
+    static constexpr std::size_t stream_chunk_size = 64*1024;   //size of streamed chunks and fragments, memory used per client
+    std::vector<shared_payload> writing_batch;  //small queued messages being written together by one gathered write
+    std::vector<sent_handler> writing_batch_handlers;   //completions of "writing_batch" messages
+    static constexpr std::size_t gather_size = 64*1024; //most bytes of small queued messages written together
 protected:
     explicit ws_client_base(void)
         : io_ctx(std::make_unique<net::io_context>()), resolver(*io_ctx), strand(std::make_unique<net::strand<net::io_context::executor_type>>(io_ctx->get_executor())) {}
     virtual ~ws_client_base(void) = default;//join threads until all finish their work
     bool check_failed_connection(void) override;
+    void notify_open(void);
+    bool notify_message(std::vector<unsigned char>&&);
+    void notify_close(void);
+    void notify_chunk(const unsigned char*, std::size_t, bool);
+    bool next_fragment(net::const_buffer&);
+    void complete_connect(boost::system::error_code);
+    void deliver_message(std::vector<unsigned char>&&);
+    bool valid_text(const std::vector<unsigned char>&) const;
+    static const shared_payload& stream_marker(void);
+    bool take_message(shared_payload&, sent_handler&);
+    bool take_batch(shared_payload&, sent_handler&);
+    void settle_batch(boost::system::error_code);
+    bool send_fragments(fragment_source, sent_handler);
+    void abort_waiters(void);
+    void wait_message(message_handler) override;
+    void send_message(const std::vector<unsigned char>&, sent_handler) override;
+    void send_stream(stream_source, sent_handler) override;
+    void send_file(const std::string&, std::size_t, std::size_t, sent_handler) override;
 public:
+    bool connect(std::string&, unsigned short) override;
     std::vector<unsigned char> read_message(void) override;
     void send_message(const std::vector<unsigned char>&) override;
+    void send_messages(const std::vector<std::vector<unsigned char>>&) override;
+    bool send_file(const std::string&, std::size_t = 0, std::size_t = 0) override;
+    ws_message read_shared_message(void) override;
+    void send_message(const ws_message&) override;
+    void send_messages(const std::vector<ws_message>&) override;
     bool check_connection(void) override;
     bool check_inbox(void) override;
+    void set_on_open(std::function<void(void)>) override;
+    void set_on_message(std::function<void(std::vector<unsigned char>&&)>) override;
+    void set_on_close(std::function<void(void)>) override;
+    void set_on_chunk(std::function<void(const unsigned char*,std::size_t,bool)>) override;
+    bool set_compression(const deflate_options&) override;
+    void set_frame_options(const frame_options&) override;
+    void set_session_cache(std::shared_ptr<tls_session_cache>) override;
+    tls_stats handshake_stats(void) override;
 };
 /************************************************************************************************************************
 * Class Name: ws_client
@@ -167,12 +335,14 @@ private:
 protected:
     void receive_message(void) override;
     void write_message(void) override;
+    void write_stream(void);
+    void write_gathered(std::size_t);
     void disconnect(int) override;
     void reset(void) override;
+    void start_connect(std::string, unsigned short, sent_handler) override;
 public:
     explicit ws_client(void) : ws_client_base(), stream(std::make_unique<ws_stream>(*io_ctx)) {}
     ~ws_client(void){this->disconnect();} //disconnect before destruction
-    bool connect(std::string&, unsigned short) override;
     void disconnect(void) override;
 };
 /************************************************************************************************************************
@@ -188,6 +358,10 @@ public:
 *                       - user private key file path as constant string
 *                       - user digital certificate file path as constant string
 *                       - Certificate Authority digital certificate file path as constant string
+*               3- Constructor for SSL input with no verification: - public
+*                       - user private key file path as constant string
+*               4- Constructor for shared TLS configuration: - public
+*                       - shared immutable TLS configuration built once by "tls_context" factory functions
 *
 * Description: derived final class for WebSocket Secure client operations with a SSL/TLS underlayer.
 *              It defines new member variables dedicated to its functionality.
@@ -198,34 +372,36 @@ class wss_client : public ws_client_base, public std::enable_shared_from_this<ws
 {
 private:
     std::unique_ptr<wss_stream> stream; //I/O stream, unique pointer
-    ssl::context ssl_ctx{ssl::context::tls};  //SSL context reference
+    std::shared_ptr<const tls_context> tls; //TLS configuration, shared with other clients or built by the constructor
     const std::string key;  //key file path
     const std::string certificate;  //certificate file path
     const std::string CA_certificate;   //Certificate Authority certificate file path
 protected:
     void receive_message(void) override;
     void write_message(void) override;
+    void write_stream(void);
+    void write_gathered(std::size_t);
     void disconnect(int) override;
     void reset(void) override;
+    void start_connect(std::string, unsigned short, sent_handler) override;
 public:
     wss_client(void) = delete;   //default non-parameterized constructor
     explicit wss_client(const std::string key_file,const std::string certificate_file,const std::string CA_cert_file) :
-        ws_client_base()
+        ws_client_base(), tls(tls_context::FromFiles(key_file,certificate_file,CA_cert_file)),
+        key(key_file), certificate(certificate_file), CA_certificate(CA_cert_file)
         {
-            key = key_file;
-            certificate = certificate_file;
-            CA_certificate = CA_cert_file;
-            Set_SSL_CTX(ssl_ctx,key_file,certificate_file,CA_cert_file);
-            stream = std::make_unique<wss_stream>(*io_ctx,ssl_ctx);  //late initialization instead of the initialization list
+            stream = std::make_unique<wss_stream>(*io_ctx,tls->native());  //late initialization instead of the initialization list
         }
     explicit wss_client(const std::string key_file) :
-        ws_client_base()
+        ws_client_base(), tls(tls_context::FromFiles(key_file)), key(key_file)
     {
-        key = key_file;
-        Set_SSL_CTX(ssl_ctx,key_file);
-        stream = std::make_unique<wss_stream>(*io_ctx,ssl_ctx);  //late initialization instead of the initialization list
+        stream = std::make_unique<wss_stream>(*io_ctx,tls->native());  //late initialization instead of the initialization list
+    }
+    explicit wss_client(std::shared_ptr<const tls_context> shared_tls) :
+        ws_client_base(), tls(std::move(shared_tls))
+    {
+        stream = std::make_unique<wss_stream>(*io_ctx,tls->native());  //no file I/O, the configuration is already built
     }
     ~wss_client(void){this->disconnect();} //disconnect before destruction
-    bool connect(std::string&, unsigned short) override;
     void disconnect(void) override;
 };
@@ -24,108 +24,212 @@ constexpr int connection_timeout = 30;  //in seconds
  *                     					    FUNCTIONS DEFINTITIONS
  ***********************************************************************************************************************/
 /************************************************************************************************************************
-* Function Name: accept_connection
-* Class name: ws_server_base
-* Access: Protected
+* Function Name: reset
+* Class name: ids_allocator
+* Access: Public
 * Specifiers: NONE
-* Running Thread: Caller thread for first time only then by Pool thread
-* Sync/Async: Asynchronous
-* Reentrancy: Reentrant
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant
+* Expected  Exception: No
+* Parameters (in): number of IDs
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Function to build the bitmap levels with IDs from 1 to the given number, all available.
+*              Upper levels are added until a level fits in a single word.
+************************************************************************************************************************/
+void ids_allocator::reset(std::size_t ids_num)
+{
+    std::lock_guard<std::mutex> lock(ids_mutex);
+    levels.clear();
+    std::size_t bits_num = ids_num;
+    do
+    {
+        std::vector<std::uint64_t> level((bits_num + 63) / 64, 0);
+        for(std::size_t i=0; i < bits_num / 64; ++i)    //full words
+            level[i] = ~std::uint64_t(0);
+        if(bits_num % 64)   //last partial word
+            level[bits_num / 64] = (std::uint64_t(1) << (bits_num % 64)) - 1;
+        bits_num = level.size();    //upper level has a bit per word of this level
+        levels.push_back(std::move(level));
+    } while(bits_num > 1);
+}
+/************************************************************************************************************************
+* Function Name: acquire
+* Class name: ids_allocator
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant
 * Expected  Exception: No
 * Parameters (in): NONE
+* Parameters (out): lowest available ID
+* Return value: lowest available ID as integer, 0 if no ID is available
+* Description: Function to take the lowest available ID. It descends from the top level taking the first set bit
+*              at each level, then clears the ID bit and the bits of the words emptied by it in the upper levels.
+************************************************************************************************************************/
+int ids_allocator::acquire(void)
+{
+    std::lock_guard<std::mutex> lock(ids_mutex);
+    if(levels.empty() || levels.back().empty() || levels.back()[0] == 0) //no available IDs
+        return 0;
+    std::size_t index = 0;
+    for(std::size_t level = levels.size(); level-- > 0;)
+        index = index * 64 + __builtin_ctzll(levels[level][index]);   //first set bit in the word
+    int id = static_cast<int>(index) + 1;
+    for(auto& level : levels)   //clear the bit, go up only if its word became empty
+    {
+        level[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+        if(level[index / 64] != 0)
+            break;
+        index /= 64;
+    }
+    return id;
+}
+/************************************************************************************************************************
+* Function Name: release
+* Class name: ids_allocator
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant
+* Expected  Exception: No
+* Parameters (in): ID to release
 * Parameters (out): NONE
 * Return value: NONE
-* Description: Internal function called at first by "ws_server_base::start". Then called each time by its async handler.
-*              to accept new connection. As long as server is running.
-*              access to the async handler is secured by "session_establishment_mutex" mutex.
+* Description: Function to make an acquired ID available again. It sets the ID bit and the bits of the words
+*              that were empty before in the upper levels.
 ************************************************************************************************************************/
-void ws_server_base::accept_connection(void)
+void ids_allocator::release(int id)
 {
-    //current connection being in establishment finishes then to the next new establishment
-    if(!server_running.load())  //if server is not running. accept no more connections
+    std::lock_guard<std::mutex> lock(ids_mutex);
+    if(levels.empty() || id < 1 || static_cast<std::size_t>(id) > levels[0].size() * 64)   //ID out of range
         return;
-    session_establishment_mutex.lock();
-    tcp_acceptor.async_accept([this](boost::system::error_code errcode,tcp::socket socket)
+    std::size_t index = static_cast<std::size_t>(id) - 1;
+    for(auto& level : levels)   //set the bit, go up only if its word was empty
     {
-        if(errcode == boost::asio::error::operation_aborted)    //operation canceled
-        {
-            socket.close();
-            session_establishment_mutex.unlock();
-            return;
-        }
-        else if(errcode)    //any other error
-        {
-            socket.close();
-        }
-        else if(session_count < max_sessions)
-        {
-            //Push session metadata and handler to the map, then pop them from the session object at exit
-            session_count.fetch_add(1); //thread-safely increment the session counter, locked by mutex
-            g_sessions.lock();
-            auto min_id_iter = std::min_element(sessions_ids.begin(),sessions_ids.end());
-            int new_session_id = *min_id_iter;  //get the min available id
-            sessions_ids.erase(min_id_iter);
-            std::shared_ptr<session_abstract> new_session;  //shared_ptr to the new session
-            if(secure) //if server is secure
-                new_session = std::make_shared<wss_session>(new_session_id,session_count,sessions_ids,sessions,
-                    g_sessions,*io_ctx,std::move(socket),*ssl_ctx);
-            else    //not secure
-                new_session = std::make_shared<ws_session>(new_session_id,session_count,sessions_ids,sessions,
-                    g_sessions,*io_ctx,std::move(socket));
-            sessions.insert({new_session_id,new_session});  //push the session handler and id to the map to allow its handle
-            g_sessions.unlock();
-            try{new_session->start();}   //start session. to handle "start" exceptions running in this thread
-            catch(...)  //in case of exception and error, remove inserted metadata of the session
-            {
-                g_sessions.lock();
-                sessions.erase(new_session_id); //erase the session handler from the map
-                sessions_ids.insert(new_session_id); //insert the id back to the container to release the id
-                g_sessions.unlock();
-                session_count.fetch_sub(1);//thread-safely decrement the session counter at server class, locked by static mutex
-            }
-        }
-        else
-        {
-            socket.close();
-        }
-        session_establishment_mutex.unlock();   //if locked,
-        accept_connection();  // Continue accepting new connections
-    });
+        bool was_empty = (level[index / 64] == 0);
+        level[index / 64] |= std::uint64_t(1) << (index % 64);
+        if(!was_empty)
+            break;
+        index /= 64;
+    }
 }
 /************************************************************************************************************************
-* Function Name: start
-* Class name: ws_server_base
+* Function Name: clear
+* Class name: ids_allocator
 * Access: Public
 * Specifiers: NONE
 * Running Thread: Caller thread
 * Sync/Async: Synchronous
-* Reentrancy: Reentrant
+* Reentrancy: Non-Reentrant
 * Expected  Exception: No
 * Parameters (in): NONE
 * Parameters (out): NONE
 * Return value: NONE
-* Description: User function to start server and start server worker threads.
-*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+* Description: Function to remove all IDs, no IDs are available until "reset" is called again.
 ************************************************************************************************************************/
-void ws_server_base::start(void)
+void ids_allocator::clear(void)
 {
-    std::lock_guard<std::mutex> lock(start_mutex);
-    if(server_running)
-        return; //already running
-    server_running = true;
-    for(std::size_t k=0;k<max_sessions;++k) //initialize IDs
-        sessions_ids.insert(k+1);
-    tcp_acceptor = tcp::acceptor(*io_ctx,tcp::endpoint(tcp::v4(),server_port));  //initialze the tcp_accpetor
-    tcp_acceptor.listen();
-    this->accept_connection();
-    threads_pool = std::make_unique<net::thread_pool>(max_sessions*2);
-    for (std::size_t i=0; i < max_sessions*2; ++i)
-        net::post(*threads_pool, [this](){io_ctx->run();});
-    return;
+    std::lock_guard<std::mutex> lock(ids_mutex);
+    levels.clear();
 }
 /************************************************************************************************************************
-* Function Name: stop
-* Class name: ws_server_base
+* Function Name: insert
+* Class name: sessions_directory
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session ID
+*                  session handler
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Function to add a session handler to the directory, under exclusive lock of the ID's shard only.
+************************************************************************************************************************/
+void sessions_directory::insert(int id, session_hndl session)
+{
+    directory_shard& shard = shard_of(id);
+    std::unique_lock<std::shared_mutex> lock(shard.shard_mutex);
+    shard.sessions[id] = std::move(session);
+}
+/************************************************************************************************************************
+* Function Name: erase
+* Class name: sessions_directory
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session ID
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Function to remove a session handler from the directory, under exclusive lock of the ID's shard only.
+************************************************************************************************************************/
+void sessions_directory::erase(int id)
+{
+    directory_shard& shard = shard_of(id);
+    std::unique_lock<std::shared_mutex> lock(shard.shard_mutex);
+    shard.sessions.erase(id);
+}
+/************************************************************************************************************************
+* Function Name: find
+* Class name: sessions_directory
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session ID
+* Parameters (out): session object
+* Return value: shared_ptr to the session object, nullptr if the ID is not found or the session is destroyed
+* Description: Function to look up a session by its ID, under shared lock of the ID's shard only.
+*              The returned shared_ptr keeps the session alive after the lock is released.
+************************************************************************************************************************/
+std::shared_ptr<session_abstract> sessions_directory::find(int id) const
+{
+    const directory_shard& shard = shard_of(id);
+    std::shared_lock<std::shared_mutex> lock(shard.shard_mutex);
+    auto session_iter = shard.sessions.find(id);
+    if(session_iter == shard.sessions.end())   //id not found
+        return nullptr;
+    return session_iter->second.lock();
+}
+/************************************************************************************************************************
+* Function Name: ids
+* Class name: sessions_directory
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): IDs of the sessions in the directory
+* Return value: IDs of the sessions in the directory as vector of integers
+* Description: Function to take a snapshot of all IDs, shard by shard, to iterate over the sessions
+*              without holding any lock, as closing a session erases it from the directory.
+************************************************************************************************************************/
+std::vector<int> sessions_directory::ids(void) const
+{
+    std::vector<int> ids_list;
+    for(const directory_shard& shard : shards)
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.shard_mutex);
+        for(const auto& session_entry : shard.sessions)
+            ids_list.push_back(session_entry.first);
+    }
+    return ids_list;
+}
+/************************************************************************************************************************
+* Function Name: clear
+* Class name: sessions_directory
 * Access: Public
 * Specifiers: NONE
 * Running Thread: Caller thread
@@ -135,312 +239,2507 @@ void ws_server_base::start(void)
 * Parameters (in): NONE
 * Parameters (out): NONE
 * Return value: NONE
-* Description: User function to stop server and release are resources and stop all working threads.
-*              shared access to the function from many threads is secured by "stop_mutex" mutex. For thread safety
+* Description: Function to remove all sessions handlers from the directory.
 ************************************************************************************************************************/
-void ws_server_base::stop(void)
+void sessions_directory::clear(void)
 {
-    std::lock_guard<std::mutex> lock(stop_mutex);
-    if(!server_running)
+    for(directory_shard& shard : shards)
+    {
+        std::unique_lock<std::shared_mutex> lock(shard.shard_mutex);
+        shard.sessions.clear();
+    }
+}
+/************************************************************************************************************************
+* Function Name: subscribe
+* Class name: topics_directory
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session ID
+*                  topic name
+*                  sessions directory of the server to check the session in
+* Parameters (out): Operation status whether successful or not
+* Return value: Operation status whether successful or not as boolean, false if the session is not running
+* Description: Function to add a session to a topic, under exclusive lock.
+*              The session is checked under the lock, a session releasing erases itself from the sessions directory
+*              before removing its topics, so a closing session can't be left subscribed for its ID next owner.
+************************************************************************************************************************/
+bool topics_directory::subscribe(int id, const std::string& topic, const sessions_directory& sessions)
+{
+    std::unique_lock<std::shared_mutex> lock(topics_mutex);
+    auto session = sessions.find(id);
+    if(!session || !session->check_session())   //not found or closed
+        return false;
+    subscribers[topic].insert(id);
+    subscriptions[id].insert(topic);
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: unsubscribe
+* Class name: topics_directory
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session ID
+*                  topic name
+* Parameters (out): Operation status whether successful or not
+* Return value: Operation status whether successful or not as boolean, false if the session is not subscribed
+* Description: Function to remove a session from a topic, under exclusive lock.
+************************************************************************************************************************/
+bool topics_directory::unsubscribe(int id, const std::string& topic)
+{
+    std::unique_lock<std::shared_mutex> lock(topics_mutex);
+    auto topic_iter = subscribers.find(topic);
+    if(topic_iter == subscribers.end() || topic_iter->second.erase(id) == 0) //not subscribed
+        return false;
+    if(topic_iter->second.empty())  //last subscriber
+        subscribers.erase(topic_iter);
+    auto session_iter = subscriptions.find(id);
+    session_iter->second.erase(topic);
+    if(session_iter->second.empty())
+        subscriptions.erase(session_iter);
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: remove
+* Class name: topics_directory
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Pool thread or Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session ID
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Function to remove a session from all its topics at its closure, under exclusive lock.
+*              Only the session's own topics are visited.
+************************************************************************************************************************/
+void topics_directory::remove(int id)
+{
+    std::unique_lock<std::shared_mutex> lock(topics_mutex);
+    auto session_iter = subscriptions.find(id);
+    if(session_iter == subscriptions.end()) //no subscriptions
         return;
-    server_running = false; //stop server
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before stopping
-    tcp_acceptor.cancel();  //cancel all tcp connections
-    for(auto& sess_iter : sessions) //close all running sessions
+    for(const std::string& topic : session_iter->second)
     {
-        if(this->sessions.size() == 0)
-            break;
-        this->close_session(sess_iter.first);
+        auto topic_iter = subscribers.find(topic);
+        topic_iter->second.erase(id);
+        if(topic_iter->second.empty())  //last subscriber
+            subscribers.erase(topic_iter);
     }
-    tcp_acceptor.close();   //close port, all connections will be closed automatically
-    io_ctx->stop();  //make sure to stop context
-    threads_pool->join();    //join threads until it ends
-    threads_pool.reset();   //destory/delete threads pool object
-    io_ctx.reset();
-    io_ctx = std::make_unique<net::io_context>();
-    sessions.clear();   //clear threads pool
-    sessions_ids.clear();
-    session_count = 0;
-    if(!session_establishment_mutex.try_lock()) //unlock this mutex if it is locked, assure its unlocked
-        session_establishment_mutex.unlock();
-    else
-        session_establishment_mutex.unlock();
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));    //delay before ending
+    subscriptions.erase(session_iter);
 }
 /************************************************************************************************************************
-* Function Name: is_serving
-* Class name: ws_server_base
+* Function Name: subscribers_of
+* Class name: topics_directory
 * Access: Public
-* Specifiers: inline
+* Specifiers: NONE
 * Running Thread: Caller thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
-* Parameters (in): NONE
-* Parameters (out): server serving status
-* Return value: server serving status as boolean
-* Description: User function to check whether server is serving clients and there are ongoing sessions or not
-*              Accessing atomic variable for thread safety.
+* Parameters (in): topic name
+* Parameters (out): IDs of the topic subscribers
+* Return value: IDs of the topic subscribers as vector of integers, empty if the topic has no subscribers
+* Description: Function to take a snapshot of a topic subscribers under shared lock, publishing to them
+*              doesn't hold the lock.
 ************************************************************************************************************************/
-inline bool ws_server_base::is_serving(void)
+std::vector<int> topics_directory::subscribers_of(const std::string& topic) const
 {
-    if(session_count.load() > 0)
-        return true;
-    return false;
+    std::shared_lock<std::shared_mutex> lock(topics_mutex);
+    auto topic_iter = subscribers.find(topic);
+    if(topic_iter == subscribers.end()) //no subscribers
+        return std::vector<int>();
+    return std::vector<int>(topic_iter->second.begin(),topic_iter->second.end());
 }
 /************************************************************************************************************************
-* Function Name: is_running
-* Class name: ws_server_base
+* Function Name: clear
+* Class name: topics_directory
 * Access: Public
-* Specifiers: inline
+* Specifiers: NONE
 * Running Thread: Caller thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
 * Parameters (in): NONE
-* Parameters (out): server running status
-* Return value: server running status as boolean
-* Description: User function to check whether server is running or not
-*              Accessing atomic variable for thread safety.
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Function to remove all topics and subscriptions.
 ************************************************************************************************************************/
-inline bool ws_server_base::is_running(void)
+void topics_directory::clear(void)
 {
-    if(server_running.load())
-        return true;
-    return false;
+    std::unique_lock<std::shared_mutex> lock(topics_mutex);
+    subscribers.clear();
+    subscriptions.clear();
 }
 /************************************************************************************************************************
-* Function Name: sessions_count
-* Class name: ws_server_base
+* Function Name: acquire
+* Class name: buffer_pool
 * Access: Public
-* Specifiers: inline
+* Specifiers: NONE
+* Running Thread: Caller thread or Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): size needed in bytes
+* Parameters (out): empty buffer
+* Return value: empty buffer as vector of unsigned characters with capacity of at least the given size
+* Description: Function to take a buffer from the smallest size class fitting the size, it is a hit.
+*              Buffers grown by the stream are kept in larger classes, so up to "classes_span" larger classes are tried.
+*              If these classes have no free buffer, a buffer of the class size is allocated, it is a miss.
+*              Sizes larger than the classes are allocated as requested.
+************************************************************************************************************************/
+std::vector<unsigned char> buffer_pool::acquire(std::size_t size)
+{
+    std::size_t size_class = 0;
+    while(size_class < classes_num && (std::size_t(1) << (size_class + min_class_bits)) < size)
+        ++size_class;
+    std::vector<unsigned char> buffer;
+    if(size_class < classes_num)
+    {
+        std::size_t last_class = std::min(size_class + classes_span, classes_num - 1);
+        pool_mutex.lock();
+        for(std::size_t k = size_class; k <= last_class; ++k)  //smallest free buffer, up to "classes_span" classes larger
+        {
+            if(free_lists[k].empty())
+                continue;
+            buffer = std::move(free_lists[k].back());
+            free_lists[k].pop_back();
+            retained_bytes -= buffer.capacity();
+            pool_mutex.unlock();
+            hits.fetch_add(1,std::memory_order_relaxed);
+            return buffer;
+        }
+        pool_mutex.unlock();
+        size = std::size_t(1) << (size_class + min_class_bits);   //allocate the class size to give it back to the same class
+    }
+    misses.fetch_add(1,std::memory_order_relaxed);
+    buffer.reserve(size);
+    return buffer;
+}
+/************************************************************************************************************************
+* Function Name: release
+* Class name: buffer_pool
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread or Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): buffer to give back
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Function to give a buffer back to the largest size class its capacity fits, cleared.
+*              It is freed instead if it is out of the classes or the retained capacity would exceed the cap,
+*              freeing is done after the mutex is unlocked.
+************************************************************************************************************************/
+void buffer_pool::release(std::vector<unsigned char>&& released)
+{
+    std::vector<unsigned char> buffer = std::move(released);
+    std::size_t capacity = buffer.capacity();
+    if(capacity < (std::size_t(1) << min_class_bits))    //too small to pool
+        return;
+    std::size_t size_class = 0;
+    while(size_class + 1 < classes_num && (std::size_t(1) << (size_class + 1 + min_class_bits)) <= capacity)
+        ++size_class;
+    if(capacity >= (std::size_t(1) << (classes_num + min_class_bits)))  //too large to pool
+        return;
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if(retained_bytes + capacity > max_retained)    //cap reached
+        return;
+    retained_bytes += capacity;
+    free_lists[size_class].push_back(std::move(buffer));
+}
+/************************************************************************************************************************
+* Function Name: stats
+* Class name: buffer_pool
+* Access: Public
+* Specifiers: NONE
 * Running Thread: Caller thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
 * Parameters (in): NONE
-* Parameters (out): number of ongoing sessions/clients being served
-* Return value: number of ongoing sessions/clients being served as integer
-* Description: User function to get number of ongoing sessions by server
-*              Accessing atomic variable for thread safety.
+* Parameters (out): pool counters
+* Return value: pool counters as "buffer_pool_stats"
+* Description: Function to get hits and misses counters and the retained capacity of the pool.
 ************************************************************************************************************************/
-inline int ws_server_base::sessions_count(void)
+buffer_pool_stats buffer_pool::stats(void)
 {
-    return static_cast<int>(session_count.load());
+    buffer_pool_stats pool_stats;
+    pool_stats.hits = hits.load(std::memory_order_relaxed);
+    pool_stats.misses = misses.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    pool_stats.retained_bytes = retained_bytes;
+    return pool_stats;
 }
 /************************************************************************************************************************
-* Function Name: send_message
-* Class name: ws_server_base
+* Function Name: make_payload
+* Class name: buffer_pool
 * Access: Public
+* Specifiers: static
+* Running Thread: Caller thread or Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): pool to take the buffer from, nullptr for no pool
+*                  message to copy into the payload
+* Parameters (out): shared immutable payload
+* Return value: shared immutable payload holding a copy of the message
+* Description: Function to copy a message into a buffer taken from the pool, the buffer is given back to the
+*              pool after the last owner of the payload releases it. The pool is kept alive by the payload.
+************************************************************************************************************************/
+shared_payload buffer_pool::make_payload(const std::shared_ptr<buffer_pool>& pool, const std::vector<unsigned char>& message)
+{
+    if(!pool)   //no pool
+        return std::make_shared<const std::vector<unsigned char>>(message);
+    std::vector<unsigned char> buffer = pool->acquire(message.size());
+    buffer.assign(message.begin(),message.end());
+    return shared_payload(new std::vector<unsigned char>(std::move(buffer)),[pool](const std::vector<unsigned char>* payload)
+    {
+        pool->release(std::move(*const_cast<std::vector<unsigned char>*>(payload)));   //created non-const
+        delete payload;
+    });
+}
+/************************************************************************************************************************
+* Function Name: accept_connection
+* Class name: ws_server_base
+* Access: Protected
 * Specifiers: NONE
-* Running Thread: Caller thread
+* Running Thread: Caller thread for first time only then by Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called at first by "ws_server_base::start". Then called each time by its async handler.
+*              to accept new connection. As long as server is running.
+*              "ws_server_base::start" calls it once per outstanding accept, so several accepts are pending at once.
+*              In sharded mode the connection socket is accepted directly on the least-loaded io shard,
+*              and the session runs all its handlers on that shard for its lifetime.
+*              acceptor is created on a strand, so all accept handlers and the acceptor calls run sequentially.
+************************************************************************************************************************/
+void ws_server_base::accept_connection(void)
+{
+    if(!server_running.load())  //if server is not running. accept no more connections
+        return;
+    std::size_t shard = io_shards.empty() ? 0 : select_shard();
+    net::io_context& session_ctx = io_shards.empty() ? *io_ctx : *io_shards[shard];   //io_context to run the new session
+    tcp_acceptor.async_accept(session_ctx,[this,shard,&session_ctx](boost::system::error_code errcode,tcp::socket socket)
+    {
+        if(errcode == boost::asio::error::operation_aborted)    //operation canceled
+        {
+            socket.close();
+            return;
+        }
+        else if(errcode)    //any other error
+            socket.close();
+        else
+            create_session(std::move(socket),session_ctx,shard);
+        accept_connection();  // Continue accepting new connections
+    });
+}
+/************************************************************************************************************************
+* Function Name: accept_shard_connection
+* Class name: ws_server_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread for first time only then by the shard thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): index of the io shard owning the acceptor
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function used instead of "ws_server_base::accept_connection" in SO_REUSEPORT mode.
+*              Each io shard has its own acceptor bound to the server port, and the kernel distributes new connections
+*              between them. Connections accepted by a shard acceptor are started as sessions on the same shard.
+*              Each shard is run by a single thread, so its acceptor calls and handlers run sequentially.
+************************************************************************************************************************/
+void ws_server_base::accept_shard_connection(std::size_t shard)
+{
+    if(!server_running.load())  //if server is not running. accept no more connections
+        return;
+    shard_acceptors[shard].async_accept([this,shard](boost::system::error_code errcode,tcp::socket socket)
+    {
+        if(errcode == boost::asio::error::operation_aborted)    //operation canceled
+        {
+            socket.close();
+            return;
+        }
+        else if(errcode)    //any other error
+            socket.close();
+        else
+            create_session(std::move(socket),*io_shards[shard],shard);
+        accept_shard_connection(shard);  // Continue accepting new connections
+    });
+}
+/************************************************************************************************************************
+* Function Name: create_session
+* Class name: ws_server_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): accepted connection socket
+*                  io_context running the socket, on which the session runs
+*                  index of the io shard of the io_context, used in sharded mode only
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by accept handlers to create and start a session for an accepted connection.
+*              If the sessions limit is reached, the connection is closed.
+*              Sessions counter is reserved atomically, the IDs allocator and the sessions directory are thread-safe.
+************************************************************************************************************************/
+void ws_server_base::create_session(tcp::socket&& socket,net::io_context& session_ctx,std::size_t shard)
+{
+    if(session_count.fetch_add(1) >= max_sessions)  //thread-safely reserve a place for the new session
+    {
+        session_count.fetch_sub(1); //sessions limit reached, release the reserved place
+        socket.close();
+        return;
+    }
+    //Push session metadata and handler to the directory, then pop them from the session object at exit
+    int new_session_id = sessions_ids.acquire();    //get the min available id
+    std::shared_ptr<session_abstract> new_session;  //shared_ptr to the new session
+    if(secure) //if server is secure
+        new_session = std::make_shared<wss_session>(new_session_id,session_count,sessions_ids,sessions,
+            session_ctx,std::move(socket),*ssl_ctx);
+    else    //not secure
+        new_session = std::make_shared<ws_session>(new_session_id,session_count,sessions_ids,sessions,
+            session_ctx,std::move(socket));
+    new_session->callbacks = active_callbacks;
+    new_session->inbox_marks = active_inbox_marks;
+    new_session->outbox_marks = active_outbox_marks;
+    new_session->compression = active_compression;
+    new_session->framing = active_framing;
+    new_session->handshakes = &handshakes;
+    new_session->topics = &topics;
+    new_session->pool = buffer_pools[io_shards.empty() ? 0 : shard];   //buffers pool of the session io shard
+    sessions.insert(new_session_id,new_session);  //push the session handler and id to the directory to allow its handle
+    if(!io_shards.empty())  //sharded mode, count the session on its shard
+    {
+        shards_load[shard].fetch_add(1);
+        new_session->shard_load = &shards_load[shard];
+    }
+    try{new_session->start();}   //start session. to handle "start" exceptions running in this thread
+    catch(...)  //in case of exception and error, remove inserted metadata of the session
+    {
+        std::static_pointer_cast<ws_session_base>(new_session)->release();
+        std::static_pointer_cast<ws_session_base>(new_session)->settle_handshake();
+    }
+}
+/************************************************************************************************************************
+* Function Name: start
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to start server and start server worker threads.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::start(void)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    if(server_running)
+        return; //already running
+    server_running = true;
+    sessions_ids.reset(max_sessions);   //initialize IDs
+    active_callbacks = std::make_shared<const session_callbacks>(callbacks);   //sessions of this run share a snapshot of the callbacks
+    active_inbox_marks = inbox_marks;
+    active_outbox_marks = outbox_marks;
+    active_compression = compression;
+    active_framing = framing;
+    std::size_t threads_num = io_threads;
+    if(threads_num == 0)    //not configured, one worker thread per core
+        threads_num = std::max(1u,std::thread::hardware_concurrency());
+    std::size_t accepts_num = (accept_concurrency == 0) ? threads_num : accept_concurrency;
+    std::size_t pools_num = io_sharding ? threads_num : 1;  //one buffers pool per io shard
+    for(std::size_t i=0; i < pools_num; ++i)
+        buffer_pools.push_back(std::make_shared<buffer_pool>(buffer_pool_limit / pools_num));
+    if(io_sharding) //one io_context per worker thread, in addition to one thread running the acceptor on "io_ctx"
+    {
+        shards_load = std::make_unique<std::atomic<std::size_t>[]>(threads_num);
+        for(std::size_t i=0; i < threads_num; ++i)
+        {
+            io_shards.push_back(std::make_unique<net::io_context>(1));  //concurrency hint, each shard is run by a single thread
+            shards_load[i] = 0;
+        }
+    }
+#ifdef SO_REUSEPORT
+    if(io_sharding && reuse_port)   //one SO_REUSEPORT acceptor per shard, kernel balances connections between them
+    {
+        std::size_t shard_accepts_num = (accepts_num + threads_num - 1) / threads_num;    //outstanding accepts per shard
+        for(std::size_t i=0; i < threads_num; ++i)
+        {
+            tcp::endpoint endpoint(tcp::v4(),server_port);
+            shard_acceptors.emplace_back(*io_shards[i]);
+            shard_acceptors[i].open(endpoint.protocol());
+            shard_acceptors[i].set_option(tcp::acceptor::reuse_address(true));
+            int reuse_port_enable = 1;  //set directly on the socket, Asio has no public SO_REUSEPORT option
+            if(setsockopt(shard_acceptors[i].native_handle(),SOL_SOCKET,SO_REUSEPORT,&reuse_port_enable,sizeof(reuse_port_enable)) != 0)
+                throw boost::system::system_error(errno,boost::system::system_category());
+            shard_acceptors[i].bind(endpoint);
+            shard_acceptors[i].listen(listen_backlog);
+        }
+        for(std::size_t i=0; i < threads_num; ++i)
+            for(std::size_t k=0; k < shard_accepts_num; ++k)    //pipeline of outstanding accepts
+                this->accept_shard_connection(i);
+    }
+#endif
+    if(shard_acceptors.empty()) //single acceptor for all connections
+    {
+        //initialze the tcp_accpetor on a strand, accept handlers may run on different threads
+        tcp_acceptor = tcp::acceptor(net::make_strand(*io_ctx),tcp::endpoint(tcp::v4(),server_port));
+        tcp_acceptor.listen(listen_backlog);
+        for(std::size_t i=0; i < accepts_num; ++i)  //pipeline of outstanding accepts
+            this->accept_connection();
+    }
+    if(io_sharding)
+    {
+        threads_pool = std::make_unique<net::thread_pool>(threads_num+1);
+        if(shard_acceptors.empty()) //a dedicated thread runs the single acceptor
+            net::post(*threads_pool, [this](){io_ctx->run();});
+        for(auto& shard_ctx : io_shards)
+        {
+            net::io_context* shard_ptr = shard_ctx.get();
+            net::post(*threads_pool, [shard_ptr](){auto work = net::make_work_guard(*shard_ptr); shard_ptr->run();});
+        }
+        return;
+    }
+    threads_pool = std::make_unique<net::thread_pool>(threads_num);
+    for (std::size_t i=0; i < threads_num; ++i)
+        net::post(*threads_pool, [this](){io_ctx->run();});
+    return;
+}
+/************************************************************************************************************************
+* Function Name: stop
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to stop server and release are resources and stop all working threads.
+*              shared access to the function from many threads is secured by "stop_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::stop(void)
+{
+    std::lock_guard<std::mutex> lock(stop_mutex);
+    if(!server_running)
+        return;
+    server_running = false; //stop server
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before stopping
+    //cancel pending accepts and close port on the acceptors executors, not to race with running accept handlers
+    if(tcp_acceptor.is_open())
+        close_acceptor(tcp_acceptor);
+    for(auto& shard_acceptor : shard_acceptors)
+        close_acceptor(shard_acceptor);
+    for(int id : sessions.ids()) //close all running sessions, over a snapshot as closing erases from the directory
+        this->close_session(id);
+    io_ctx->stop();  //make sure to stop context
+    for(auto& shard_ctx : io_shards)
+        shard_ctx->stop();
+    threads_pool->join();    //join threads until it ends
+    threads_pool.reset();   //destory/delete threads pool object
+    shard_acceptors.clear();
+    io_shards.clear();  //destroy shards contexts and their sessions
+    std::unique_ptr<net::io_context> new_io_ctx = std::make_unique<net::io_context>();
+    tcp_acceptor = tcp::acceptor(*new_io_ctx);  //release the acceptor strand before destroying its io_context
+    io_ctx = std::move(new_io_ctx);
+    sessions.clear();   //clear sessions directory
+    topics.clear(); //clear sessions subscriptions
+    buffer_pools.clear();   //payloads still owned keep their pool alive
+    sessions_ids.clear();
+    session_count = 0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));    //delay before ending
+}
+/************************************************************************************************************************
+* Function Name: close_acceptor
+* Class name: ws_server_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): acceptor to close by reference
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "ws_server_base::stop" to cancel pending accepts and close the port.
+*              It runs on the acceptor's executor, not to race with its running accept handlers, and waits until done.
+************************************************************************************************************************/
+void ws_server_base::close_acceptor(tcp::acceptor& acceptor)
+{
+    std::promise<void> acceptor_closed;
+    net::post(acceptor.get_executor(),[&acceptor,&acceptor_closed]()
+    {
+        boost::system::error_code errcode;
+        acceptor.cancel(errcode);
+        acceptor.close(errcode);
+        acceptor_closed.set_value();
+    });
+    acceptor_closed.get_future().wait();
+}
+/************************************************************************************************************************
+* Function Name: is_serving
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): server serving status
+* Return value: server serving status as boolean
+* Description: User function to check whether server is serving clients and there are ongoing sessions or not
+*              Accessing atomic variable for thread safety.
+************************************************************************************************************************/
+inline bool ws_server_base::is_serving(void)
+{
+    if(session_count.load() > 0)
+        return true;
+    return false;
+}
+/************************************************************************************************************************
+* Function Name: is_running
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): server running status
+* Return value: server running status as boolean
+* Description: User function to check whether server is running or not
+*              Accessing atomic variable for thread safety.
+************************************************************************************************************************/
+inline bool ws_server_base::is_running(void)
+{
+    if(server_running.load())
+        return true;
+    return false;
+}
+/************************************************************************************************************************
+* Function Name: sessions_count
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: inline
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): number of ongoing sessions/clients being served
+* Return value: number of ongoing sessions/clients being served as integer
+* Description: User function to get number of ongoing sessions by server
+*              Accessing atomic variable for thread safety.
+************************************************************************************************************************/
+inline int ws_server_base::sessions_count(void)
+{
+    return static_cast<int>(session_count.load());
+}
+/************************************************************************************************************************
+* Function Name: set_io_threads
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): number of worker threads, 0 to use the number of cores
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the number of worker threads running the server and its sessions.
+*              Threads count is independent of the maximum sessions limit, it is applied at the next "start" call.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_io_threads(std::size_t threads_num)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    io_threads = threads_num;
+}
+/************************************************************************************************************************
+* Function Name: set_io_sharding
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): boolean to enable or disable sharded mode
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to enable or disable sharded mode, it is applied at the next "start" call.
+*              In sharded mode each worker thread runs its own io_context (shard), and a dedicated thread runs the acceptor.
+*              Each new session is placed on the least-loaded shard and stays on it for its lifetime.
+*              So its handlers never cross threads or contend on a shared io_context queue.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_io_sharding(bool sharding)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    io_sharding = sharding;
+}
+/************************************************************************************************************************
+* Function Name: set_reuse_port
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): boolean to enable or disable SO_REUSEPORT acceptors
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to open one SO_REUSEPORT acceptor per io shard instead of a single acceptor,
+*              so the kernel load-balances new connections across shards. It is applied at the next "start" call.
+*              It takes effect in sharded mode only, on systems without SO_REUSEPORT a single acceptor is used.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_reuse_port(bool reuse)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    reuse_port = reuse;
+}
+/************************************************************************************************************************
+* Function Name: set_accept_concurrency
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): number of outstanding accept operations, 0 to use the number of worker threads
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set how many accept operations are kept pending at once, it is applied at the next "start" call.
+*              More outstanding accepts let the server take connections in bursts, such as reconnect storms.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_accept_concurrency(std::size_t accepts_num)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    accept_concurrency = accepts_num;
+}
+/************************************************************************************************************************
+* Function Name: set_listen_backlog
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): maximum length of the queue of pending connections
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the listen backlog of the acceptor, it is applied at the next "start" call.
+*              Default is the system maximum, "net::socket_base::max_listen_connections".
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_listen_backlog(int backlog)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    listen_backlog = backlog;
+}
+/************************************************************************************************************************
+* Function Name: set_buffer_pool_limit
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): cap of the memory retained by the buffers pools in bytes, 0 disables pooling
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the cap of the free buffers capacity kept by all buffers pools of the server,
+*              it is split equally between the io shards pools. Default is 64MB. Applied at next "start" call.
+************************************************************************************************************************/
+void ws_server_base::set_buffer_pool_limit(std::size_t limit)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    buffer_pool_limit = limit;
+}
+/************************************************************************************************************************
+* Function Name: pool_stats
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): buffers pools counters
+* Return value: buffers pools counters as "buffer_pool_stats", summed over the io shards pools
+* Description: User function to get the buffers pools counters since the server started, zeros if it is stopped.
+************************************************************************************************************************/
+buffer_pool_stats ws_server_base::pool_stats(void)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    buffer_pool_stats total;
+    for(auto& pool : buffer_pools)
+    {
+        buffer_pool_stats shard_stats = pool->stats();
+        total.hits += shard_stats.hits;
+        total.misses += shard_stats.misses;
+        total.retained_bytes += shard_stats.retained_bytes;
+    }
+    return total;
+}
+/************************************************************************************************************************
+* Function Name: set_on_open
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): callback called with the session ID, empty function to remove it
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the callback called from the session's strand once the session handshake is done.
+*              Applied at next "start" call.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_on_open(std::function<void(int)> on_open)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    callbacks.on_open = std::move(on_open);
+}
+/************************************************************************************************************************
+* Function Name: set_on_message
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): callback called with the session ID and the received message, empty function to remove it
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the callback called from the session's strand as soon as a message is received.
+*              The message is moved to the callback and never pushed to the session inbox, so "check_inbox"
+*              and "read_message" are not needed. Without it messages are queued to the inbox as before.
+*              Applied at next "start" call.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_on_message(std::function<void(int,std::vector<unsigned char>&&)> on_message)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    callbacks.on_message = std::move(on_message);
+}
+/************************************************************************************************************************
+* Function Name: set_on_close
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): callback called with the session ID, empty function to remove it
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the callback called once an opened session is closed.
+*              It is called from the session's strand if the session is closed by the client or by an error,
+*              and from the caller thread if it is closed by "close_session" or "stop".
+*              Applied at next "start" call.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_on_close(std::function<void(int)> on_close)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    callbacks.on_close = std::move(on_close);
+}
+/************************************************************************************************************************
+* Function Name: set_on_chunk
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): callback called with the session ID, the received chunk, its size and true with the last chunk
+*                  of the message, empty function to remove it
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to receive messages incrementally instead of complete messages. Sessions read up to
+*              64KB at a time and hand every chunk to the callback from the session's strand as it arrives, so
+*              messages of any size are received with bounded memory, to be written to disk or relayed.
+*              The chunk is valid during the call only. The next chunk is read once the callback returns, so a slow
+*              callback slows down the client by TCP flow control. "on_message" and the inbox are not used.
+*              Applied at next "start" call.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_on_chunk(std::function<void(int,const unsigned char*,std::size_t,bool)> on_chunk)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    callbacks.on_chunk = std::move(on_chunk);
+}
+/************************************************************************************************************************
+* Function Name: set_inbox_limits
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): high and low water marks of each session inbox in messages and bytes, 0 for no mark
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to bound the inbox of each session. Once the queued messages or bytes reach a high
+*              water mark, the session stops reading from its client so TCP flow control pushes back on it.
+*              Reading is resumed once the application read the inbox down to the low water marks.
+*              Messages handed to "on_message" callback or pending asynchronous reads are not queued.
+*              Default is no marks, applied at next "start" call.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_inbox_limits(const inbox_limits& limits)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    inbox_marks = limits;
+}
+/************************************************************************************************************************
+* Function Name: set_outbox_limits
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): limits of each session outbox in messages and bytes, 0 for no limit, and the overflow policy
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to bound the unwritten messages of each session, so a slow client can not grow
+*              the server memory without bound. A message over one of the limits is handled by the policy:
+*              "block" makes the caller wait for room, unless it runs on an io thread, as callbacks do, where the
+*              message is dropped at once. "drop_oldest" drops the oldest unwritten messages,
+*              "drop_newest" drops the new message and "disconnect" closes the slow session.
+*              "send_message" functions return how the message was handled.
+*              Default is no limits, applied at next "start" call.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_outbox_limits(const outbox_limits& limits)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    outbox_marks = limits;
+}
+/************************************************************************************************************************
+* Function Name: set_compression
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): permessage-deflate options, window bits, memory level, context takeover and minimum message size
+* Parameters (out): options status whether they are set or not
+* Return value: false if the options are refused and the former ones are kept, else true
+* Description: User function to accept the permessage-deflate extension for sessions whose clients offer it.
+*              Compressed sessions use less bandwidth for text messages at the cost of CPU time and memory per
+*              session, refer to "deflate_conf.h". Clients not offering the extension are served uncompressed.
+*              A minimum message size is refused by Boost versions without it, as 1.74, refer to "Deflate_Supported".
+*              Default is disabled, applied at next "start" call.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+bool ws_server_base::set_compression(const deflate_options& options)
+{
+    if(!Deflate_Supported(options))
+        return false;
+    std::lock_guard<std::mutex> lock(start_mutex);
+    compression = options;
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: set_frame_options
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): frames type of the sent messages and text validation
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to set the frames type of the messages sent by the sessions, text frames for browser
+*              facing endpoints or binary frames for any payload. With text validation, messages that are not valid
+*              UTF-8 are not sent, "send_message" returns "invalid", and a session receiving them in binary frames is
+*              closed. Text frames received are always validated by Boost.Beast, refer to "utf8_validator.h".
+*              Default is text frames without validation, applied at next "start" call.
+*              shared access to the function from many threads is secured by "start_mutex" mutex. For thread safety
+************************************************************************************************************************/
+void ws_server_base::set_frame_options(const frame_options& options)
+{
+    std::lock_guard<std::mutex> lock(start_mutex);
+    framing = options;
+}
+/************************************************************************************************************************
+* Function Name: select_shard
+* Class name: ws_server_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread for first time only then by Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): index of the io shard to run the next session
+* Return value: index of the io shard as std::size_t
+* Description: Internal function called by "ws_server_base::accept_connection" in sharded mode.
+*              It returns the shard with least running sessions, starting the search at a round-robin position
+*              so equally loaded shards are chosen in turn.
+************************************************************************************************************************/
+std::size_t ws_server_base::select_shard(void)
+{
+    std::size_t shards_num = io_shards.size();
+    std::size_t start = next_shard.fetch_add(1) % shards_num;
+    std::size_t selected = start;
+    for(std::size_t i=1; i < shards_num; ++i)
+    {
+        std::size_t shard = (start + i) % shards_num;
+        if(shards_load[shard].load() < shards_load[selected].load())
+            selected = shard;
+    }
+    return selected;
+}
+/************************************************************************************************************************
+* Function Name: send_message
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to send the message to
+*                  message to be sent as const reference to vector of unsigned characters
+* Parameters (out): outcome of queuing the message
+* Return value: outcome of queuing the message as "send_status", "not_found" if the session is not running
+* Description: User function to send a message to specific session by the server
+*              If the session handshake handler didn't run yet, it waits for it first, only if its response is being
+*              written, a session whose client didn't complete its handshake is not running.
+*              Only the sessions directory shard of the session is locked, calls for different sessions run in parallel.
+*              Once the session outbox reached one of its limits, the result tells how its overflow policy handled
+*              the message, refer to "set_outbox_limits".
+************************************************************************************************************************/
+send_status ws_server_base::send_message(int id, const std::vector<unsigned char>& message)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return send_status::not_found;
+    if(!session->wait_handshake())  //session may still be in its handshake handler
+        return send_status::not_found;
+    return session->send_message(message);
+}
+/************************************************************************************************************************
+* Function Name: send_message (2)
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to send the message to
+*                  shared message to be sent as const reference to "ws_message"
+* Parameters (out): outcome of queuing the message
+* Return value: outcome of queuing the message as "send_status", "not_found" if the session is not running
+* Description: User function to send a shared message to specific session by the server without copying its bytes,
+*              the session queue holds a reference to the message until it is written. Refer to "send_message".
+************************************************************************************************************************/
+send_status ws_server_base::send_message(int id, const ws_message& message)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return send_status::not_found;
+    if(!session->wait_handshake())  //session may still be in its handshake handler
+        return send_status::not_found;
+    return session->send_payload(message.payload(),false);
+}
+/************************************************************************************************************************
+* Function Name: send_messages
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to send the messages to
+*                  batch of messages to be sent as const reference to vector of vectors of unsigned characters
+* Parameters (out): outcome of queuing the messages
+* Return value: worst outcome of queuing the messages as "send_status", "not_found" if the session is not running
+* Description: User function to send a batch of messages in order to specific session by the server.
+*              The messages are copied before the session's queue is locked once for the whole batch.
+*              If the session handshake handler didn't run yet, it waits for it first, only if its response is being
+*              written, a session whose client didn't complete its handshake is not running.
+*              The outbox limits are applied to each message, the worst outcome of the batch is returned.
+************************************************************************************************************************/
+send_status ws_server_base::send_messages(int id, const std::vector<std::vector<unsigned char>>& messages)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return send_status::not_found;
+    if(!session->wait_handshake())  //session may still be in its handshake handler
+        return send_status::not_found;
+    std::vector<shared_payload> payloads;
+    payloads.reserve(messages.size());
+    for(const auto& message : messages)
+        payloads.push_back(buffer_pool::make_payload(session->pool,message));
+    return session->send_payloads(std::move(payloads));
+}
+/************************************************************************************************************************
+* Function Name: send_file
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to send the file to
+*                  file path
+*                  offset of the range in the file, 0 by default
+*                  size of the range, 0 for the rest of the file by default
+* Parameters (out): outcome of queuing the file
+* Return value: outcome of queuing the file as "send_status", "not_found" if the session is not running,
+*               "unreadable" if the file can't be mapped or the range exceeds it
+* Description: User function to send a file range as one message to specific session by the server without reading
+*              it into memory. The range is memory mapped and written in fragments of up to 64KB straight from the
+*              mapping, in order with the session's other messages, the mapping is released once it is written.
+*              Refer to "mapped_file.h". It is admitted by the outbox limits as an empty message.
+*              Files are sent in binary frames whatever the session's frames type, refer to "write_stream".
+************************************************************************************************************************/
+send_status ws_server_base::send_file(int id, const std::string& path, std::size_t offset, std::size_t length)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return send_status::not_found;
+    if(!session->wait_handshake())  //session may still be in its handshake handler
+        return send_status::not_found;
+    std::shared_ptr<const mapped_file> file = mapped_file::open(path,offset,length);
+    if(!file)
+        return send_status::unreadable;
+    return session->send_stream(File_Fragments(std::move(file)),nullptr);
+}
+/************************************************************************************************************************
+* Function Name: send_messages (2)
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to send the messages to
+*                  batch of shared messages to be sent in order as const reference to vector of "ws_message"
+* Parameters (out): outcome of queuing the messages
+* Return value: worst outcome of queuing the messages as "send_status", "not_found" if the session is not running
+* Description: User function to send a batch of shared messages in order to specific session without copying their bytes.
+*              Refer to "send_messages".
+************************************************************************************************************************/
+send_status ws_server_base::send_messages(int id, const std::vector<ws_message>& messages)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return send_status::not_found;
+    if(!session->wait_handshake())  //session may still be in its handshake handler
+        return send_status::not_found;
+    std::vector<shared_payload> payloads;
+    payloads.reserve(messages.size());
+    for(const auto& message : messages)
+        payloads.push_back(message.payload());
+    return session->send_payloads(std::move(payloads));
+}
+/************************************************************************************************************************
+* Function Name: broadcast
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): message to be sent as const reference to vector of unsigned characters
+* Parameters (out): number of sessions the message is queued to
+* Return value: number of sessions the message is queued to as integer
+* Description: User function to send the same message to all running sessions, over a snapshot of the sessions IDs.
+*              Refer to "send_to".
+************************************************************************************************************************/
+int ws_server_base::broadcast(const std::vector<unsigned char>& message)
+{
+    return this->send_to(sessions.ids(),message);
+}
+/************************************************************************************************************************
+* Function Name: broadcast (2)
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): shared message to be sent as const reference to "ws_message"
+* Parameters (out): number of sessions the message is queued to
+* Return value: number of sessions the message is queued to as integer
+* Description: User function to send the same shared message to all running sessions, refer to "send_to (2)".
+************************************************************************************************************************/
+int ws_server_base::broadcast(const ws_message& message)
+{
+    return this->send_to(sessions.ids(),message);
+}
+/************************************************************************************************************************
+* Function Name: send_to
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): IDs of the sessions to send the message to
+*                  message to be sent as const reference to vector of unsigned characters
+* Parameters (out): number of sessions the message is queued to
+* Return value: number of sessions the message is queued to as integer, not found or closed sessions are skipped,
+*               as are sessions whose outbox limits dropped the message
+* Description: User function to send the same message to a list of sessions by the server.
+*              The message is copied once into a shared message, refer to "send_to (2)".
+************************************************************************************************************************/
+int ws_server_base::send_to(const std::vector<int>& ids, const std::vector<unsigned char>& message)
+{
+    std::shared_ptr<buffer_pool> pool;  //pool of the first found session
+    for(int id : ids)
+    {
+        auto session = sessions.find(id);
+        if(session)
+        {
+            pool = session->pool;
+            break;
+        }
+    }
+    return this->send_to(ids,ws_message(buffer_pool::make_payload(pool,message)));  //single copy for all sessions
+}
+/************************************************************************************************************************
+* Function Name: send_to (2)
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): IDs of the sessions to send the message to
+*                  shared message to be sent as const reference to "ws_message"
+* Parameters (out): number of sessions the message is queued to
+* Return value: number of sessions the message is queued to as integer, not found or closed sessions are skipped,
+*               as are sessions whose outbox limits dropped the message
+* Description: User function to send the same shared message to a list of sessions by the server.
+*              Only a reference to the message is pushed to the sessions queues, its bytes are never copied.
+*              Sessions not established yet are skipped at once, even those whose handshake response is being written.
+*              A text message is validated once for all the sessions, refer to "set_frame_options".
+*              Only the sessions directory shard of each session is locked, one at a time.
+************************************************************************************************************************/
+int ws_server_base::send_to(const std::vector<int>& ids, const ws_message& message)
+{
+    //sessions of a run share the server's frames options, the shared message is validated once for all of them
+    if(active_framing.mode == frame_mode::text && active_framing.validate_utf8
+        && !Validate_UTF8(message.payload()->data(),message.payload()->size()))
+        return 0;   //refused by all text sessions
+    int queued = 0;
+    for(int id : ids)
+    {
+        auto session = sessions.find(id);   //get session from sessions directory
+        if(!session || !session->check_session())   //id not found or not established, not queued
+            continue;
+        send_status status = session->send_payload(message.payload(),true);   //validated above
+        if(status == send_status::queued || status == send_status::dropped_oldest)
+            ++queued;
+    }
+    return queued;
+}
+/************************************************************************************************************************
+* Function Name: subscribe
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to subscribe
+*                  topic name
+* Parameters (out): Operation status whether successful or not
+* Return value: Operation status whether successful or not as boolean, false if the session is not running
+* Description: User function to subscribe a session to a topic, it receives the messages published to the topic
+*              until it is unsubscribed or closed.
+*              If the session handshake handler didn't run yet, it waits for it first, only if its response is being
+*              written, a session whose client didn't complete its handshake is not running.
+************************************************************************************************************************/
+bool ws_server_base::subscribe(int id, const std::string& topic)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return false;
+    if(!session->wait_handshake())  //session may still be in its handshake handler
+        return false;
+    return topics.subscribe(id,topic,sessions);
+}
+/************************************************************************************************************************
+* Function Name: unsubscribe
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to unsubscribe
+*                  topic name
+* Parameters (out): Operation status whether successful or not
+* Return value: Operation status whether successful or not as boolean, false if the session is not subscribed
+* Description: User function to unsubscribe a session from a topic. Closed sessions are unsubscribed by themselves.
+************************************************************************************************************************/
+bool ws_server_base::unsubscribe(int id, const std::string& topic)
+{
+    return topics.unsubscribe(id,topic);
+}
+/************************************************************************************************************************
+* Function Name: publish
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): topic name
+*                  message to be sent as const reference to vector of unsigned characters
+* Parameters (out): number of sessions the message is queued to
+* Return value: number of sessions the message is queued to as integer
+* Description: User function to send the same message to all subscribers of a topic, over a snapshot of them.
+*              Refer to "send_to".
+************************************************************************************************************************/
+int ws_server_base::publish(const std::string& topic, const std::vector<unsigned char>& message)
+{
+    return this->send_to(topics.subscribers_of(topic),message);
+}
+/************************************************************************************************************************
+* Function Name: publish (2)
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): topic name
+*                  shared message to be sent as const reference to "ws_message"
+* Parameters (out): number of sessions the message is queued to
+* Return value: number of sessions the message is queued to as integer
+* Description: User function to send the same shared message to all subscribers of a topic, refer to "send_to (2)".
+************************************************************************************************************************/
+int ws_server_base::publish(const std::string& topic, const ws_message& message)
+{
+    return this->send_to(topics.subscribers_of(topic),message);
+}
+/************************************************************************************************************************
+* Function Name: read_message
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to read the message from its queue
+* Parameters (out): message read, empty if read failed
+* Return value: message read as vector of unsigned characters, empty if read failed
+* Description: User function to read messages from specific session's queue by the server
+*              Only the sessions directory shard of the session is locked, calls for different sessions run in parallel.
+************************************************************************************************************************/
+std::vector<unsigned char> ws_server_base::read_message(int id)
+{
+    std::vector<unsigned char> msg;
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return msg; //empty message
+    msg = session->read_message();
+    return msg;
+}
+/************************************************************************************************************************
+* Function Name: read_shared_message
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to read the message from its queue
+* Parameters (out): message read, empty if read failed
+* Return value: message read as "ws_message", empty if read failed
+* Description: User function to read messages from specific session's queue as a shared message.
+*              The received bytes are moved into the message, not copied. Refer to "read_message".
+************************************************************************************************************************/
+ws_message ws_server_base::read_shared_message(int id)
+{
+    return ws_message(this->read_message(id));
+}
+/************************************************************************************************************************
+* Function Name: check_inbox
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to check its inbox/queue
+* Parameters (out): whether there are messages to read or not
+* Return value: whether there are messages to read or not as boolean
+* Description: User function to check the read queue/inbox of specific session by server
+*              Only the sessions directory shard of the session is locked, calls for different sessions run in parallel.
+************************************************************************************************************************/
+bool ws_server_base::check_inbox(int id)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return false;   //id not found or not running
+    if(!session->check_inbox()) //if inbox empty
+        return false;   //inbox empty
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: inbox_depth
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to get its inbox depth
+* Parameters (out): depth of the session inbox, zeros if the session is not found
+* Return value: depth of the session inbox as "inbox_stats"
+* Description: User function to get the queued messages and bytes of specific session inbox, and whether reading
+*              from its client is paused by the inbox high water marks.
+************************************************************************************************************************/
+inbox_stats ws_server_base::inbox_depth(int id)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return inbox_stats();
+    return session->inbox_depth();
+}
+/************************************************************************************************************************
+* Function Name: check_session
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to check its status
+* Parameters (out): whether the session is ongoing or not
+* Return value: whether the session is ongoing or not as boolean
+* Description: User function to check the status of specific session if it's ongoing or not by server
+*              Only the sessions directory shard of the session is locked, calls for different sessions run in parallel.
+************************************************************************************************************************/
+bool ws_server_base::check_session(int id)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return false;
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: handshake_stats
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): counters of the TLS handshakes
+* Return value: full and resumed TLS handshakes of the secure sessions since the server creation, zeros with no TLS/SSL
+* Description: User function to monitor TLS session resumption. Reconnecting clients offering a former session make
+*              abbreviated handshakes with no certificates exchange and no asymmetric keys operations, refer to
+*              "tls_session.h". Failed handshakes are not counted.
+************************************************************************************************************************/
+tls_stats ws_server_base::handshake_stats(void)
+{
+    return handshakes.stats();
+}
+/************************************************************************************************************************
+* Function Name: close_session
+* Class name: ws_server_base
+* Access: Public
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to close
+* Parameters (out): NONE
+* Return value: NONE
+* Description: User function to close a specific session by server using its ID
+*              If the session handshake is not completed by the client, it is cancelled without waiting for the client.
+*              Only the sessions directory shard of the session is locked, calls for different sessions run in parallel.
+************************************************************************************************************************/
+void ws_server_base::close_session(int id)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+        return;
+    if(!session->wait_handshake())  //handshake not completed by the client, cancel it without waiting
+        session->abort_handshake();
+    else
+        session->stop();
+}
+/************************************************************************************************************************
+* Function Name: wait_message
+* Class name: ws_server_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to read the message from its queue
+*                  completion handler called with the read message
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "server_abstract::async_read_message". The handler is called with a message
+*              of the session's queue, or with its next received message. It fails with "not_connected" error if the
+*              session is not found or not ongoing, and with "operation_aborted" error if the session is closed first.
+*              Only the sessions directory shard of the session is locked, calls for different sessions run in parallel.
+************************************************************************************************************************/
+void ws_server_base::wait_message(int id, message_handler handler)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+    {
+        handler(net::error::not_connected,std::vector<unsigned char>());
+        return;
+    }
+    session->wait_message(std::move(handler));
+}
+/************************************************************************************************************************
+* Function Name: send_message (2)
+* Class name: ws_server_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to send the message to
+*                  message to be sent as const reference to vector of unsigned characters
+*                  completion handler called once the message is written
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "server_abstract::async_send_message". Unlike the user "send_message"
+*              it doesn't wait, the handler is called once the message is written or failed. It fails with
+*              "not_connected" error if the session is not found or not ongoing.
+*              Only the sessions directory shard of the session is locked, calls for different sessions run in parallel.
+************************************************************************************************************************/
+void ws_server_base::send_message(int id, const std::vector<unsigned char>& message, sent_handler handler)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+    {
+        handler(net::error::not_connected);
+        return;
+    }
+    session->send_message(message,std::move(handler));
+}
+/************************************************************************************************************************
+* Function Name: send_stream
+* Class name: ws_server_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to send the message to
+*                  source filling the message fragments, returns 0 at the end of the message
+*                  completion handler called once the message is written
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "server_abstract::async_send_stream". The streamed message is queued in
+*              order with the session's other messages, refer to "ws_session_base::send_stream". It fails with
+*              "not_connected" error if the session is not found or not ongoing.
+************************************************************************************************************************/
+void ws_server_base::send_stream(int id, stream_source source, sent_handler handler)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+    {
+        handler(net::error::not_connected);
+        return;
+    }
+    session->send_stream(Buffered_Fragments(std::move(source)),std::move(handler));
+}
+/************************************************************************************************************************
+* Function Name: send_file (2)
+* Class name: ws_server_base
+* Access: Protected
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): session id to send the file to
+*                  file path
+*                  offset of the range in the file
+*                  size of the range, 0 for the rest of the file
+*                  completion handler called once the file is written
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal function called by "server_abstract::async_send_file", refer to "send_file". It fails with
+*              "not_connected" error if the session is not found or not ongoing, and with "bad_descriptor" error if
+*              the file can't be mapped or the range exceeds it.
+************************************************************************************************************************/
+void ws_server_base::send_file(int id, const std::string& path, std::size_t offset, std::size_t length, sent_handler handler)
+{
+    auto session = sessions.find(id);   //get session from sessions directory
+    if(!session)   //id not found, not running
+    {
+        handler(net::error::not_connected);
+        return;
+    }
+    std::shared_ptr<const mapped_file> file = mapped_file::open(path,offset,length);
+    if(!file)
+    {
+        handler(net::error::bad_descriptor);
+        return;
+    }
+    session->send_stream(File_Fragments(std::move(file)),std::move(handler));
+}
+/************************************************************************************************************************
+* Function Name: read_message
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): message from the session read queue
+* Return value: message from the session read queue as vector of unsigned characters, empty if queue is empty
+* Description: Protected function to read message from sessin by server
+*              shared variables and racing to the function is secured by "read_mutex" mutex.
+************************************************************************************************************************/
+std::vector<unsigned char> ws_session_base::read_message(void)
+{
+    std::vector<unsigned char> message;
+    read_mutex.lock();
+    std::shared_ptr<session_abstract> resumed = pop_message(message); //checked under the mutex, the server may read from many threads
+    read_mutex.unlock();
+    if(resumed) //inbox is at its low water mark, read from the peer again
+        this->receive_message();    //"resumed" keeps the session alive until the read is issued
+    return message;
+}
+/************************************************************************************************************************
+* Function Name: send_message
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): message to be sent as const reference to vector of unsigned characters
+* Parameters (out): outcome of queuing the message
+* Return value: outcome of queuing the message as "send_status"
+* Description: Protected function to send message to a session by server, refer to "send_payload".
+************************************************************************************************************************/
+send_status ws_session_base::send_message(const std::vector<unsigned char>& message)
+{
+    return this->send_payload(buffer_pool::make_payload(pool,message),false);
+}
+/************************************************************************************************************************
+* Function Name: send_payload
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): shared immutable message to be sent
+*                  boolean set if the message is already validated as text by the server
+* Parameters (out): outcome of queuing the message
+* Return value: outcome of queuing the message as "send_status", "not_found" if the session is not ongoing
+* Description: Protected function to add a shared message to the session's queue and give the write order.
+*              The payload is not copied, the write handler keeps it alive until the message is written.
+*              shared variables and racing to the function is secured by "send_mutex" mutex.
+*              The message is admitted to the queue by its limits, refer to "admit_message".
+*              A text session with validation refuses messages that are not valid UTF-8, refer to "valid_text".
+*              A message shared by many sessions is validated once by the server, not by each session.
+*              The write order is given only if no write is in flight, else the message is written after the
+*              queued messages by the write handler.
+************************************************************************************************************************/
+send_status ws_session_base::send_payload(shared_payload payload, bool text_checked)
+{
+    if(!text_checked && !valid_text(*payload))
+        return send_status::invalid;
+    std::deque<sent_handler> dropped_handlers;  //handlers of the oldest messages dropped for this one
+    std::unique_lock<std::mutex> send_lock(send_mutex);
+    send_status status = admit_message(send_lock,payload->size(),dropped_handlers);
+    bool start_write = false;
+    if(status == send_status::queued || status == send_status::dropped_oldest)
+    {
+        outbox_bytes += payload->size();
+        send_messages_queue.push_back(std::move(payload));
+        sent_handlers.push_back(nullptr);   //no completion handler
+        start_write = !write_in_progress;   //no write in flight to continue with this message
+        write_in_progress = true;
+    }
+    send_lock.unlock();
+    settle_admission(status,dropped_handlers);
+    if(start_write)
+        this->write_message();  //call write message and give the write order
+    return status;
+}
+/************************************************************************************************************************
+* Function Name: send_payloads
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): batch of shared immutable messages to be sent
+* Parameters (out): outcome of queuing the messages
+* Return value: outcome of queuing the messages as "send_status", the worst outcome of the batch messages
+* Description: Protected function to add a batch of shared messages to the session's queue under one lock,
+*              they are written back to back by the write handler with a single write order.
+*              Each message is admitted by the queue limits in order, the rest of the batch is not queued
+*              once the session is disconnected. Messages that are not valid text are left out of the batch,
+*              validated before taking the lock. Refer to "send_payload".
+************************************************************************************************************************/
+send_status ws_session_base::send_payloads(std::vector<shared_payload>&& payloads)
+{
+    std::deque<sent_handler> dropped_handlers;  //handlers of the oldest messages dropped for the batch
+    send_status batch_status = send_status::queued;
+    auto invalid_begin = std::remove_if(payloads.begin(),payloads.end(),
+        [this](const shared_payload& payload){return !valid_text(*payload);});
+    if(invalid_begin != payloads.end())
+    {
+        batch_status = send_status::invalid;
+        payloads.erase(invalid_begin,payloads.end());
+    }
+    std::unique_lock<std::mutex> send_lock(send_mutex);
+    if(!ongoing_session.load()) //checked under the mutex, not to miss "abort_waiters" at session closure
+        return send_status::not_found;
+    bool queued_any = false;
+    for(auto& payload : payloads)
+    {
+        send_status status = admit_message(send_lock,payload->size(),dropped_handlers);
+        batch_status = std::max(batch_status,status);   //statuses are ordered from best to worst
+        if(status == send_status::disconnected || status == send_status::not_found)
+            break;
+        if(status == send_status::dropped)
+            continue;
+        outbox_bytes += payload->size();
+        send_messages_queue.push_back(std::move(payload));
+        sent_handlers.push_back(nullptr);   //no completion handler
+        queued_any = true;
+    }
+    bool start_write = queued_any && !write_in_progress;  //no write in flight to continue with these messages
+    if(queued_any)
+        write_in_progress = true;
+    send_lock.unlock();
+    settle_admission(batch_status,dropped_handlers);
+    if(start_write)
+        this->write_message();  //call write message and give the write order
+    return batch_status;
+}
+/************************************************************************************************************************
+* Function Name: admit_message
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, "send_mutex" must be locked by the caller through the given lock
+* Expected  Exception: No
+* Parameters (in): lock of "send_mutex", unlocked while waiting with "block" policy
+*                  size of the new message in bytes
+* Parameters (out): handlers of the oldest messages dropped for the new message
+*                   whether the new message may be queued or not
+* Return value: "queued" or "dropped_oldest" if the caller may queue the new message, else why it may not
+* Description: Protected function to apply the session outbox limits before queuing a message. An empty outbox
+*              always admits the message. Over one of the limits, the outbox policy is applied:
+*              "block" waits until written messages make room, the session closes or the block timeout expires,
+*              it only blocks threads not running the io_context, on a pool thread, as in callbacks, the writes
+*              making room may be queued behind the caller, so the message is dropped at once there.
+*              "drop_oldest" drops the oldest unwritten messages, the message in flight is never dropped.
+*              "drop_newest" drops the new message and "disconnect" drops it and the session.
+*              Dropped handlers and disconnection are handled by "settle_admission" after unlocking.
+************************************************************************************************************************/
+send_status ws_session_base::admit_message(std::unique_lock<std::mutex>& send_lock, std::size_t size,
+    std::deque<sent_handler>& dropped_handlers)
+{
+    auto outbox_full = [this,size]()
+    {
+        if(send_messages_queue.empty()) //a message larger than the limits is still sent alone
+            return false;
+        return (outbox_marks.max_messages != 0 && send_messages_queue.size() >= outbox_marks.max_messages) ||
+               (outbox_marks.max_bytes != 0 && outbox_bytes + size > outbox_marks.max_bytes);
+    };
+    if(!ongoing_session.load()) //checked under the mutex, not to miss "abort_waiters" at session closure
+        return send_status::not_found;
+    if(!outbox_full())
+        return send_status::queued;
+    switch(outbox_marks.policy)
+    {
+    case overflow_policy::block:
+        if(io_ctx.get_executor().running_in_this_thread())  //the writes making room may be queued behind the caller
+            return send_status::dropped;
+        if(!outbox_space.wait_for(send_lock,outbox_marks.block_timeout,[this,&outbox_full](){return !ongoing_session.load() || !outbox_full();}))
+            return send_status::dropped;    //timed out
+        return ongoing_session.load() ? send_status::queued : send_status::not_found;
+    case overflow_policy::drop_oldest:
+        while(outbox_full())
+        {
+            if(send_messages_queue.front() == stream_marker())    //streamed message not started yet
+                stream_sources.pop_front();
+            outbox_bytes -= send_messages_queue.front()->size();
+            send_messages_queue.pop_front();
+            dropped_handlers.push_back(std::move(sent_handlers.front()));
+            sent_handlers.pop_front();
+        }
+        return send_status::dropped_oldest;
+    case overflow_policy::drop_newest:
+        return send_status::dropped;
+    case overflow_policy::disconnect:
+        return send_status::disconnected;
+    }
+    return send_status::dropped;
+}
+/************************************************************************************************************************
+* Function Name: settle_admission
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): outcome of "admit_message"
+*                  handlers of the dropped oldest messages
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function called after "send_mutex" is unlocked to fail the asynchronous sends of the
+*              dropped messages with "no_buffer_space" error, and to drop the connection of a slow consumer.
+************************************************************************************************************************/
+void ws_session_base::settle_admission(send_status status, std::deque<sent_handler>& dropped_handlers)
+{
+    for(auto& handler : dropped_handlers)
+        if(handler)
+            handler(net::error::no_buffer_space);
+    if(status == send_status::disconnected)
+        this->drop_connection();
+}
+/************************************************************************************************************************
+* Function Name: wait_message
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): completion handler called with the read message
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function called by "ws_server_base::wait_message". If the queue has a message,
+*              the handler is called at once with it, else it waits for the next received message, even if the
+*              session handshake is not finished yet. It fails with "not_connected" error if the session is closed.
+*              Access to the queue is secured by "read_mutex" mutex.
+************************************************************************************************************************/
+void ws_session_base::wait_message(message_handler handler)
+{
+    read_mutex.lock();
+    if(!read_messages_queue.empty())
+    {
+        std::vector<unsigned char> message;
+        std::shared_ptr<session_abstract> resumed = pop_message(message);
+        read_mutex.unlock();
+        if(resumed) //inbox is at its low water mark, read from the peer again
+            this->receive_message();    //"resumed" keeps the session alive until the read is issued
+        handler(boost::system::error_code(),std::move(message));
+        return;
+    }
+    if(waiters_closed)  //checked under the mutex, not to miss "abort_waiters" at session closure
+    {
+        read_mutex.unlock();
+        handler(net::error::not_connected,std::vector<unsigned char>());
+        return;
+    }
+    read_waiters.push_back(std::move(handler));
+    read_mutex.unlock();
+}
+/************************************************************************************************************************
+* Function Name: send_message (2)
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): message to be sent as const reference to vector of unsigned characters
+*                  completion handler called once the message is written
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function called by "ws_server_base::send_message (2)". The message is stored in the queue
+*              with its handler then written to the stream, the handler is called from the write handler.
+*              It fails with "not_connected" error if the session is not ongoing, including during its handshake.
+*              It fails with "no_buffer_space" error if the outbox limits drop it, or "connection_aborted" error
+*              if they disconnect the session, refer to "admit_message".
+*              It fails with "bad_frame_payload" error if it is not valid text, refer to "valid_text".
+*              The write order is given only if no write is in flight, refer to "send_payload".
+************************************************************************************************************************/
+void ws_session_base::send_message(const std::vector<unsigned char>& message, sent_handler handler)
+{
+    if(!valid_text(message))
+    {
+        handler(websocket::error::bad_frame_payload);
+        return;
+    }
+    shared_payload payload = buffer_pool::make_payload(pool,message);
+    std::deque<sent_handler> dropped_handlers;  //handlers of the oldest messages dropped for this one
+    std::unique_lock<std::mutex> send_lock(send_mutex);
+    send_status status = admit_message(send_lock,payload->size(),dropped_handlers);
+    bool start_write = false;
+    if(status == send_status::queued || status == send_status::dropped_oldest)
+    {
+        outbox_bytes += payload->size();
+        send_messages_queue.push_back(std::move(payload));
+        sent_handlers.push_back(std::move(handler));
+        start_write = !write_in_progress;   //no write in flight to continue with this message
+        write_in_progress = true;
+    }
+    send_lock.unlock();
+    settle_admission(status,dropped_handlers);
+    if(status == send_status::not_found)
+        handler(net::error::not_connected);
+    else if(status == send_status::dropped)
+        handler(net::error::no_buffer_space);
+    else if(status == send_status::disconnected)
+        handler(net::error::connection_aborted);
+    if(start_write)
+        this->write_message();  //call write message and give the write order
+}
+/************************************************************************************************************************
+* Function Name: send_stream
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): source of the message fragments, returns an empty fragment at the end of the message
+*                  completion handler called once the message is written, may be empty
+* Parameters (out): outcome of queuing the message
+* Return value: outcome of queuing the message as "send_status"
+* Description: Protected function to send a message of any size without holding it in memory. A "stream_marker"
+*              takes its place in the queue, so it is written in order with the other messages, and its source is
+*              stored in "stream_sources". Once its turn comes, the source is called from the session's strand for
+*              every fragment of up to 64KB, refer to "write_stream". Other messages wait until the last fragment.
+*              It is admitted by the outbox limits as an empty message and fails like "send_message (2)".
+*              Streamed messages are sent in binary frames whatever the session's frames type, refer to "write_stream".
+************************************************************************************************************************/
+send_status ws_session_base::send_stream(fragment_source source, sent_handler handler)
+{
+    std::deque<sent_handler> dropped_handlers;  //handlers of the oldest messages dropped for this one
+    std::unique_lock<std::mutex> send_lock(send_mutex);
+    send_status status = admit_message(send_lock,0,dropped_handlers);
+    bool start_write = false;
+    if(status == send_status::queued || status == send_status::dropped_oldest)
+    {
+        send_messages_queue.push_back(stream_marker());
+        sent_handlers.push_back(std::move(handler));
+        stream_sources.push_back(std::move(source));
+        start_write = !write_in_progress;   //no write in flight to continue with this message
+        write_in_progress = true;
+    }
+    send_lock.unlock();
+    settle_admission(status,dropped_handlers);
+    if(handler && status == send_status::not_found)
+        handler(net::error::not_connected);
+    else if(handler && status == send_status::dropped)
+        handler(net::error::no_buffer_space);
+    else if(handler && status == send_status::disconnected)
+        handler(net::error::connection_aborted);
+    if(start_write)
+        this->write_message();  //call write message and give the write order
+    return status;
+}
+/************************************************************************************************************************
+* Function Name: stream_marker
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: static
+* Running Thread: Caller thread or Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: empty payload marking a streamed message in "send_messages_queue"
+* Description: Protected function returning the payload queued for streamed messages, compared by address.
+************************************************************************************************************************/
+const shared_payload& ws_session_base::stream_marker(void)
+{
+    static const shared_payload marker = std::make_shared<const std::vector<unsigned char>>();
+    return marker;
+}
+/************************************************************************************************************************
+* Function Name: take_message
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, called from the session's strand by the writes only
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): next message to write and its completion handler
+* Return value: false if the queue is empty and the writes stop, else true
+* Description: Protected function to take the front message of "send_messages_queue" to be written.
+*              If it is a streamed message, its source is moved to "writing_source".
+*              Blocked senders are notified of the room left. Secured by "send_mutex" mutex.
+************************************************************************************************************************/
+bool ws_session_base::take_message(shared_payload& message, sent_handler& handler)
+{
+    send_mutex.lock();
+    if(send_messages_queue.empty()) //all messages are written, or aborted by session closure
+    {
+        write_in_progress = false;  //next message gives the write order again
+        send_mutex.unlock();
+        return false;
+    }
+    message = std::move(send_messages_queue.front());
+    send_messages_queue.pop_front();    //read front then pop
+    outbox_bytes -= message->size();
+    handler = std::move(sent_handlers.front());
+    sent_handlers.pop_front();
+    if(message == stream_marker())
+    {
+        writing_source = std::move(stream_sources.front());
+        stream_sources.pop_front();
+    }
+    send_mutex.unlock();
+    if(outbox_marks.policy == overflow_policy::block)
+        outbox_space.notify_all();  //room for blocked senders
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: take_batch
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, called from the session's strand by the writes only
+* Expected  Exception: No
+* Parameters (in): message taken by "take_message" and its completion handler, not a streamed message
+* Parameters (out): NONE
+* Return value: true if messages are gathered to "writing_batch" with the given one, else false
+* Description: Protected function to gather the given message and the small messages queued after it in
+*              "writing_batch", as long as they are not streamed messages and don't exceed "gather_size" bytes all.
+*              Otherwise the given message is left to be written alone, straight from its payload.
+*              Blocked senders are notified of the room left. Secured by "send_mutex" mutex.
+************************************************************************************************************************/
+bool ws_session_base::take_batch(shared_payload& message, sent_handler& handler)
+{
+    std::size_t batch_bytes = message->size();
+    send_mutex.lock();
+    while(!send_messages_queue.empty() && send_messages_queue.front() != stream_marker()
+        && batch_bytes + send_messages_queue.front()->size() <= gather_size)
+    {
+        if(writing_batch.empty())
+        {
+            writing_batch.push_back(std::move(message));
+            writing_batch_handlers.push_back(std::move(handler));
+        }
+        batch_bytes += send_messages_queue.front()->size();
+        outbox_bytes -= send_messages_queue.front()->size();
+        writing_batch.push_back(std::move(send_messages_queue.front()));
+        send_messages_queue.pop_front();
+        writing_batch_handlers.push_back(std::move(sent_handlers.front()));
+        sent_handlers.pop_front();
+    }
+    send_mutex.unlock();
+    if(writing_batch.empty())   //no message to gather with
+        return false;
+    if(outbox_marks.policy == overflow_policy::block)
+        outbox_space.notify_all();  //room for blocked senders
+    return true;
+}
+/************************************************************************************************************************
+* Function Name: settle_batch
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, called from the session's strand by the writes only
+* Expected  Exception: No
+* Parameters (in): error code of the write
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function to release the written or failed messages of "writing_batch" and call their
+*              completion handlers, if any, with the error code of the write.
+************************************************************************************************************************/
+void ws_session_base::settle_batch(boost::system::error_code errcode)
+{
+    std::vector<sent_handler> handlers = std::move(writing_batch_handlers);
+    writing_batch_handlers.clear();
+    writing_batch.clear();
+    for(auto& handler : handlers)
+        if(handler) //asynchronous send, message is written or failed
+            handler(errcode);
+}
+/************************************************************************************************************************
+* Function Name: valid_text
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: const
+* Running Thread: Caller thread or Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): message to be sent or received
+* Parameters (out): NONE
+* Return value: false if the session validates text and the message is not valid UTF-8, else true
+* Description: Protected function to check sent messages and messages received in binary frames by a text session
+*              with validation, refer to "Validate_UTF8". Sessions sending binary frames accept any message.
+************************************************************************************************************************/
+bool ws_session_base::valid_text(const std::vector<unsigned char>& message) const
+{
+    if(framing.mode != frame_mode::text || !framing.validate_utf8)
+        return true;
+    return Validate_UTF8(message.data(),message.size());
+}
+/************************************************************************************************************************
+* Function Name: deliver_message
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): received message as rvalue reference
+*                  shared pointer to the session, kept while reading is paused
+* Parameters (out): whether to read the next message from the peer or not
+* Return value: whether to read the next message from the peer or not as boolean
+* Description: Protected function called from the session's strand for each received message.
+*              The message goes to user "on_message" callback if set, else to the oldest pending asynchronous read,
+*              else it is pushed to the queue. Access to the queue is secured by "read_mutex" mutex.
+*              A message left in place by the user callback gives its buffer back to the session buffers pool.
+*              Once the queue reaches one of its high water marks reading is paused, no read is issued so TCP flow
+*              control pushes back on the peer, until "pop_message" resumes it. As no read is pending then, the
+*              session keeps itself alive by "paused_owner" until it is resumed or stopped.
+************************************************************************************************************************/
+bool ws_session_base::deliver_message(std::vector<unsigned char>&& message, const std::shared_ptr<session_abstract>& owner)
+{
+    if(notify_message(std::move(message)))  //handed to user callback
+    {
+        if(pool && message.capacity() != 0)    //not taken by the user callback, reuse its buffer
+            pool->release(std::move(message));
+        return true;
+    }
+    read_mutex.lock();
+    if(!read_waiters.empty())   //pending asynchronous read, hand the message directly
+    {
+        message_handler waiter = std::move(read_waiters.front());
+        read_waiters.pop_front();
+        read_mutex.unlock();
+        waiter(boost::system::error_code(),std::move(message));
+        return true;
+    }
+    inbox_bytes += message.size();
+    read_messages_queue.push_back(std::move(message));  //push received data into the queue
+    read_paused = (inbox_marks.high_messages != 0 && read_messages_queue.size() >= inbox_marks.high_messages) ||
+                  (inbox_marks.high_bytes != 0 && inbox_bytes >= inbox_marks.high_bytes);
+    if(read_paused)
+        paused_owner = owner;
+    bool keep_reading = !read_paused;
+    read_mutex.unlock();
+    return keep_reading;
+}
+/************************************************************************************************************************
+* Function Name: pop_message
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, "read_mutex" must be locked by the caller
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): message popped from the queue, unchanged if the queue is empty
+*                   the session if reading from the peer is resumed
+* Return value: shared pointer to the session if reading is resumed, the caller calls its "receive_message"
+*               after unlocking "read_mutex", else nullptr
+* Description: Protected function to pop the oldest message of the queue. If reading is paused by the high water
+*              marks and the queue is at or below all its low water marks, reading is resumed.
+************************************************************************************************************************/
+std::shared_ptr<session_abstract> ws_session_base::pop_message(std::vector<unsigned char>& message)
+{
+    if(read_messages_queue.empty())
+        return nullptr;
+    message = std::move(read_messages_queue.front());
+    read_messages_queue.pop_front();
+    inbox_bytes -= message.size();
+    if(!read_paused)
+        return nullptr;
+    read_paused = (inbox_marks.high_messages != 0 && read_messages_queue.size() > inbox_marks.low_messages) ||
+                  (inbox_marks.high_bytes != 0 && inbox_bytes > inbox_marks.low_bytes);
+    if(read_paused)
+        return nullptr;
+    return std::move(paused_owner);
+}
+/************************************************************************************************************************
+* Function Name: abort_waiters
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread or Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function called by the session stop functions to fail pending asynchronous reads and
+*              unwritten asynchronous sends with "operation_aborted" error.
+*              Access to shared variables is secured by "read_mutex" and "send_mutex" mutexes.
+************************************************************************************************************************/
+void ws_session_base::abort_waiters(void)
+{
+    read_mutex.lock();
+    waiters_closed = true;
+    std::deque<message_handler> waiters = std::move(read_waiters);
+    read_waiters.clear();
+    std::shared_ptr<session_abstract> paused_session = std::move(paused_owner); //released after the mutex, the caller owns the session too
+    read_mutex.unlock();
+    send_mutex.lock();
+    std::deque<sent_handler> handlers = std::move(sent_handlers);
+    sent_handlers.clear();
+    send_messages_queue.clear();
+    stream_sources.clear();
+    outbox_bytes = 0;
+    write_in_progress = false;
+    send_mutex.unlock();
+    outbox_space.notify_all();  //blocked senders see the session closure
+    for(auto& waiter : waiters)
+        waiter(net::error::operation_aborted,std::vector<unsigned char>());
+    for(auto& handler : handlers)
+        if(handler)
+            handler(net::error::operation_aborted);
+}
+/************************************************************************************************************************
+* Function Name: settle_handshake
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions and server classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function called once the session handshake succeeded or failed, after the session state
+*              is updated. It releases the threads waiting in "ws_session_base::wait_handshake", only once.
+************************************************************************************************************************/
+void ws_session_base::settle_handshake(void)
+{
+    if(!handshake_done.exchange(true))
+        handshake_promise.set_value();
+}
+/************************************************************************************************************************
+* Function Name: wait_handshake
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Caller thread
+* Sync/Async: Synchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): session status whether its established or not
+* Return value: session status as boolean whether its established or not
+* Description: Protected function called by the server before sending to or closing a session. The client may finish
+*              the handshake and use the connection before the session handshake handler runs on the server,
+*              so once the handshake response is being written it waits for the handler, which follows at once.
+*              A session whose peer didn't complete its upgrade request is not waited for, it returns immediately.
+*              Neither is it waited for from a thread running the session's io_context, as callbacks do: the handler
+*              may be queued behind the caller on this thread, single-threaded and sharded modes, or on its strand.
+************************************************************************************************************************/
+bool ws_session_base::wait_handshake(void)
+{
+    if(strand.running_in_this_thread() || io_ctx.get_executor().running_in_this_thread())  //handler can't run meanwhile
+        return ongoing_session.load();
+    if(!handshake_done.load() && handshake_responding.load())
+        handshake_settled.wait_for(std::chrono::seconds(connection_timeout));
+    return ongoing_session.load();
+}
+/************************************************************************************************************************
+* Function Name: check_inbox
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
+* Specifiers: inline
+* Running Thread: Pool thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
-* Parameters (in): session id to send the message to
-*                  message to be sent as const reference to vector of unsigned characters
-* Parameters (out): Operation status whether successful or not
-* Return value: Operation status whether successful or not as boolean.
-* Description: User function to send a message to specific session by the server
-*              shared access to the function from many threads is secured by "send_message_mutex" mutex. For thread safety
+* Parameters (in): NONE
+* Parameters (out): read queue/inbox status whether there are messages to read or empty
+* Return value: read queue/inbox status as boolean whether there are messages to read or empty
+* Description: Protected function to check read queue of a session by server.
+*              shared variables are secured by "read_mutex" mutex.
 ************************************************************************************************************************/
-bool ws_server_base::send_message(int id, const std::vector<unsigned char>& message)
+inline bool ws_session_base::check_inbox(void)
 {
-    std::lock_guard<std::mutex> lock(send_message_mutex);
-    auto session_iter = sessions.find(id);  //get session handler from sessions map container
-    if(session_iter == sessions.end())   //id not found, not running
-        return false;
-    auto session_handler = session_iter->second;    //stored weak_ptr to the session
-    session_handler.lock()->send_message(message);
-    return true;
+    std::lock_guard<std::mutex> lock(read_mutex);
+    return !read_messages_queue.empty();
 }
 /************************************************************************************************************************
-* Function Name: read_message
-* Class name: ws_server_base
-* Access: Public
+* Function Name: inbox_depth
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
 * Specifiers: NONE
 * Running Thread: Caller thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
-* Parameters (in): session id to read the message from its queue
-* Parameters (out): message read, empty if read failed
-* Return value: message read as vector of unsigned characters, empty if read failed
-* Description: User function to read messages from specific session's queue by the server
-*              shared access to the function from many threads is secured by "read_message_mutex" mutex. For thread safety
+* Parameters (in): NONE
+* Parameters (out): depth of the read queue/inbox
+* Return value: depth of the read queue/inbox as "inbox_stats"
+* Description: Protected function to get the queued messages and bytes of a session by server, and whether reading
+*              is paused by the high water marks. shared variables are secured by "read_mutex" mutex.
 ************************************************************************************************************************/
-std::vector<unsigned char> ws_server_base::read_message(int id)
+inbox_stats ws_session_base::inbox_depth(void)
 {
-    std::lock_guard<std::mutex> lock(read_message_mutex);
-    std::vector<unsigned char> msg;
-    auto session_iter = sessions.find(id);  //get session handler from sessions map container
-    if(session_iter == sessions.end())   //id not found, not running
-        return msg; //empty message
-    auto session_handler = session_iter->second;    //stored weak_ptr to the session
-    msg = session_handler.lock()->read_message();
-    return msg;
+    std::lock_guard<std::mutex> lock(read_mutex);
+    inbox_stats depth;
+    depth.messages = read_messages_queue.size();
+    depth.bytes = inbox_bytes;
+    depth.paused = read_paused;
+    return depth;
 }
 /************************************************************************************************************************
-* Function Name: check_inbox
-* Class name: ws_server_base
-* Access: Public
-* Specifiers: NONE
-* Running Thread: Caller thread
+* Function Name: check_session
+* Class name: ws_session_base
+* Access: Protected - Accessed only by server classes
+* Specifiers: inline
+* Running Thread: Pool thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
-* Parameters (in): session id to check its inbox/queue
-* Parameters (out): whether there are messages to read or not
-* Return value: whether there are messages to read or not as boolean
-* Description: User function to check the read queue/inbox of specific session by server
-*              shared access to the function from many threads is secured by "check_inbox_mutex" mutex. For thread safety
+* Parameters (in): NONE
+* Parameters (out): session status whether its ongoing or not
+* Return value: session status as boolean whether its ongoing or not
+* Description: Protected function to check session statu by server whether ongoing or not.
+*              Accessing atomic variable for thread safety.
 ************************************************************************************************************************/
-bool ws_server_base::check_inbox(int id)
+inline bool ws_session_base::check_session(void)
 {
-    std::lock_guard<std::mutex> lock(check_inbox_mutex);
-    auto session_iter = sessions.find(id);  //get session handler from sessions map container
-    if(session_iter == sessions.end())   //id not found, not running
-        return false;   //id not found or not running
-    auto session_handler = session_iter->second;    //stored weak_ptr to the session
-    if(!session_handler.lock()->check_inbox()) //if inbox empty
-        return false;   //inbox empty
-    return true;
+    return ongoing_session.load();
 }
 /************************************************************************************************************************
-* Function Name: check_session
-* Class name: ws_server_base
-* Access: Public
+* Function Name: release
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions and server classes
 * Specifiers: NONE
-* Running Thread: Caller thread
+* Running Thread: Pool thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
-* Parameters (in): session id to check its status
-* Parameters (out): whether the session is ongoing or not
-* Return value: whether the session is ongoing or not as boolean
-* Description: User function to check the status of specific session if it's ongoing or not by server
-*              shared access to the function from many threads is secured by "session_check_mutex" mutex. For thread safety
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function to delete the session metadata at session closure.
+*              metadata: session id, session's handler in sessions directory, decrement sessions counter by 1
+*              decrement its io shard sessions counter in sharded mode and its topics subscriptions.
+*              The sessions directory and the IDs allocator shared with the server are thread-safe.
 ************************************************************************************************************************/
-bool ws_server_base::check_session(int id)
+void ws_session_base::release(void)
 {
-    std::lock_guard<std::mutex> lock(session_check_mutex);
-    auto session_iter = sessions.find(id);  //get session handler from sessions map container
-    if(session_iter == sessions.end())   //id not found, not running
-        return false;
-    return true;
+    sessions.erase(session_id); //erase the session handler from the directory before its id can be reused
+    if(topics != nullptr)   //unsubscribe from all topics, after the erasure not to be subscribed again
+        topics->remove(session_id);
+    sessions_ids.release(session_id);
+    session_count.fetch_sub(1); //thread-safely decrement the session counter at server class
+    if(shard_load != nullptr)   //sharded mode
+        shard_load->fetch_sub(1);
 }
 /************************************************************************************************************************
-* Function Name: close_session
-* Class name: ws_server_base
-* Access: Public
+* Function Name: notify_open
+* Class name: ws_session_base
+* Access: Protected - Accessed only by sessions classes
 * Specifiers: NONE
-* Running Thread: Caller thread
+* Running Thread: Pool thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
-* Parameters (in): session id to close
+* Parameters (in): NONE
 * Parameters (out): NONE
 * Return value: NONE
-* Description: User function to close a specific session by server using its ID
-*              shared access to the function from many threads is secured by "session_close_mutex" mutex. For thread safety
+* Description: Protected function called from the session's strand after the session handshake.
+*              It marks the session as opened and calls user "on_open" callback if set.
+*              Exceptions thrown by the user callback are suppressed, not to break the io thread.
 ************************************************************************************************************************/
-void ws_server_base::close_session(int id)
+void ws_session_base::notify_open(void)
 {
-    std::lock_guard<std::mutex> lock(session_close_mutex);
-    auto session_iter = sessions.find(id);  //get session handler from sessions map container
-    if(session_iter == sessions.end())   //id not found, not running
+    opened = true;
+    if(!callbacks || !callbacks->on_open)
         return;
-    auto session_handler = session_iter->second;    //stored weak_ptr to the session
-    session_handler.lock()->stop();
+    try{callbacks->on_open(session_id);}
+    catch(...) {} //suppress user callback exceptions
 }
 /************************************************************************************************************************
-* Function Name: read_message
+* Function Name: notify_message
 * Class name: ws_session_base
-* Access: Protected - Accessed only by server classes
+* Access: Protected - Accessed only by sessions classes
 * Specifiers: NONE
 * Running Thread: Pool thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
-* Parameters (in): NONE
-* Parameters (out): message from the session read queue
-* Return value: message from the session read queue as vector of unsigned characters, empty if queue is empty
-* Description: Protected function to read message from sessin by server
-*              shared variables and racing to the function is secured by "read_mutex" mutex.
+* Parameters (in): received message as rvalue reference
+* Parameters (out): whether the message is handed to the user callback or not
+* Return value: boolean, false if no "on_message" callback is set and the message is left to the caller to queue
+* Description: Protected function called from the session's strand as soon as a message is received.
+*              The message is moved to user "on_message" callback if set.
+*              Exceptions thrown by the user callback are suppressed, not to break the io thread.
 ************************************************************************************************************************/
-std::vector<unsigned char> ws_session_base::read_message(void)
+bool ws_session_base::notify_message(std::vector<unsigned char>&& message)
 {
-    std::vector<unsigned char> message;
-    if(read_messages_queue.size() == 0)
-        return message;
-    read_mutex.lock();
-    message = read_messages_queue.front();
-    read_messages_queue.pop_front();
-    read_mutex.unlock();
-    return message;
+    if(!callbacks || !callbacks->on_message)
+        return false;
+    try{callbacks->on_message(session_id,std::move(message));}
+    catch(...) {} //suppress user callback exceptions
+    return true;
 }
 /************************************************************************************************************************
-* Function Name: send_message
+* Function Name: notify_chunk
 * Class name: ws_session_base
-* Access: Protected - Accessed only by server classes
+* Access: Protected - Accessed only by sessions classes
 * Specifiers: NONE
 * Running Thread: Pool thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
-* Parameters (in): message to be sent as const reference to vector of unsigned characters
+* Parameters (in): received chunk data and size
+*                  boolean set at the last chunk of the message
 * Parameters (out): NONE
 * Return value: NONE
-* Description: Protected function to send message to a session by server
-*              shared variables and racing to the function is secured by "send_mutex" mutex.
+* Description: Protected function called from the session's strand as soon as a chunk is received.
+*              It calls user "on_chunk" callback, set when the session reads chunks.
+*              Exceptions thrown by the user callback are suppressed, not to break the io thread.
 ************************************************************************************************************************/
-void ws_session_base::send_message(const std::vector<unsigned char>& message)
+void ws_session_base::notify_chunk(const unsigned char* chunk, std::size_t size, bool last_chunk)
 {
-    send_mutex.lock();
-    send_messages_queue.push_back(std::move(message));
-    send_mutex.unlock();
-    this->write_message();  //call write message and give the write order
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending and writing
-    return;
+    try{callbacks->on_chunk(session_id,chunk,size,last_chunk);}
+    catch(...) {} //suppress user callback exceptions
 }
 /************************************************************************************************************************
-* Function Name: check_inbox
+* Function Name: next_fragment
 * Class name: ws_session_base
-* Access: Protected - Accessed only by server classes
-* Specifiers: inline
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
 * Running Thread: Pool thread
 * Sync/Async: Synchronous
-* Reentrancy: Reentrant
+* Reentrancy: Non-Reentrant, called from the session's strand by the writes only
 * Expected  Exception: No
 * Parameters (in): NONE
-* Parameters (out): read queue/inbox status whether there are messages to read or empty
-* Return value: read queue/inbox status as boolean whether there are messages to read or empty
-* Description: Protected function to check read queue of a session by server.
+* Parameters (out): next fragment of the streamed message, empty at its end
+* Return value: false if the source of the streamed message threw, else true
+* Description: Protected function to get the next fragment from "writing_source", user sources included.
+*              Exceptions thrown by the source are suppressed, not to break the io thread, the message is aborted.
 ************************************************************************************************************************/
-inline bool ws_session_base::check_inbox(void)
+bool ws_session_base::next_fragment(net::const_buffer& fragment)
 {
-    if(read_messages_queue.size()>0)
-        return true;
-    return false;
+    try{fragment = writing_source(stream_chunk_size);}
+    catch(...) {return false;} //suppress user source exceptions
+    return true;
 }
 /************************************************************************************************************************
-* Function Name: check_session
+* Function Name: notify_close
 * Class name: ws_session_base
-* Access: Protected - Accessed only by server classes
-* Specifiers: inline
-* Running Thread: Pool thread
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread or Caller thread
 * Sync/Async: Synchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
 * Parameters (in): NONE
-* Parameters (out): session status whether its ongoing or not
-* Return value: session status as boolean whether its ongoing or not
-* Description: Protected function to check session statu by server whether ongoing or not.
-*              Accessing atomic variable for thread safety.
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function called by the session stop functions after the session closure.
+*              It calls user "on_close" callback if set, only once and only if the session was opened.
+*              Exceptions thrown by the user callback are suppressed, not to break the io thread.
 ************************************************************************************************************************/
-inline bool ws_session_base::check_session(void)
+void ws_session_base::notify_close(void)
 {
-    return ongoing_session.load();
+    if(!opened.exchange(false) || !callbacks || !callbacks->on_close)
+        return;
+    try{callbacks->on_close(session_id);}
+    catch(...) {} //suppress user callback exceptions
 }
 /************************************************************************************************************************
 * Function Name: start
@@ -448,7 +2747,7 @@ inline bool ws_session_base::check_session(void)
 * Access: Protected - Accessed only by server classes
 * Specifiers: NONE
 * Running Thread: Pool thread
-* Sync/Async: Synchronous
+* Sync/Async: Asynchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
 * Parameters (in): NONE
@@ -456,9 +2755,11 @@ inline bool ws_session_base::check_session(void)
 * Return value: NONE
 * Description: Protected function to start a new session by server. session with no TLS/SSL underlayer.
 *              server starts the new session as new client tries to connect to the server.
+*              It returns immediately, the handshake is driven by its async handlers with a "handshake_timer" deadline.
 *              if the session is started successfully, it starts receiving operations and update its status.
-*              if session failed to start, it stops and disconnects the client and delete its metadata
-*              metadata: session id, session's handler in sessions map, decrement sessions counter by 1.
+*              if session failed to start or its deadline expired, it disconnects the client and delete its metadata
+*              by "fail_handshake", the session is never established.
+*              metadata: session id, session's handler in sessions directory, decrement sessions counter by 1.
 ************************************************************************************************************************/
 void ws_session::start(void)
 {
@@ -466,32 +2767,34 @@ void ws_session::start(void)
     auto self_object = shared_from_this();
     //set the suggested timeout settings for the websocket as the server
     self_object->stream.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
-    self_object->stream.set_option(websocket::stream_base::decorator([](websocket::response_type& response)//****
+    self_object->stream.set_option(websocket::stream_base::decorator([session = self_object.get()](websocket::response_type& response)//****
     {
+        session->handshake_responding = true;   //response is written next, the handshake handler follows
         response.set(http::field::server,std::string(BOOST_BEAST_VERSION_STRING)+"websocket-server-async");
     }));
-    stream.async_accept([self_object](boost::system::error_code errcode) mutable //mutable lambda expression
+    Set_Deflate(self_object->stream,compression,true);  //permessage-deflate negotiation, accepted if offered by client
+    self_object->stream.binary(framing.mode == frame_mode::binary); //frames type of sent messages
+    handshake_timer.expires_after(std::chrono::seconds(connection_timeout));
+    handshake_timer.async_wait(net::bind_executor(strand,[self_object](boost::system::error_code errcode)
+    {
+        if(errcode || self_object->ongoing_session.load()) //deadline cancelled or session already established
+            return;
+        beast::get_lowest_layer(self_object->stream).cancel();  //abort the handshake, its handler releases the session
+    }));
+    stream.async_accept(net::bind_executor(strand,[self_object](boost::system::error_code errcode) mutable //mutable lambda expression
     {
+        self_object->handshake_timer.cancel();  //handshake finished, cancel its deadline
         if(errcode)
         {
-            self_object->ongoing_session = true;
-            self_object->stop(-1);   //set "ongoing_session" to true to allow session closing
+            self_object->fail_handshake();  //never opened, the session is released without closing it
             return;
         }
         // All functions are successfull
         self_object->ongoing_session = true;
+        self_object->settle_handshake();    //before "on_open", it may use the session
+        self_object->notify_open();
         self_object->receive_message(); //trigger receive message call
-    });
-    //Boost's default handshake timeout connection for websocket is 30seconds
-    int i = 0;  //timeout check loop
-    while((i++<connection_timeout) && (!ongoing_session.load()))
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    if(!ongoing_session.load())  //if connection is not successfull
-    {
-        self_object->ongoing_session = true;
-        self_object->stop();   //stop if not stopped
-        return;
-    }
+    }));
 }
 /************************************************************************************************************************
 * Function Name: stop(1)
@@ -507,25 +2810,37 @@ void ws_session::start(void)
 * Return value: NONE
 * Description: Protected function to stop thesession by server willingly. session with no TLS/SSL underlayer.
 *              It stops and disconnects the client and delete its metadata
-*              metadata: session id, session's handler in sessions map, decrement sessions counter by 1.
+*              metadata: session id, session's handler in sessions directory, decrement sessions counter by 1.
+*              The close handshake runs on the session's strand beside its pending read, the caller waits for it
+*              up to the connection timeout then a short delay, unless it is called from a thread running the session's
+*              io_context, as callbacks do, the close may be queued behind the caller on this thread.
 ************************************************************************************************************************/
 void ws_session::stop(void)
 {
-    if(!ongoing_session.load()) //if session is already stopped
+    if(!ongoing_session.exchange(false)) //if session is already stopped, only one stop call releases the session
         return; //do nothing and return
-    ongoing_session = false;
-    g_sessions.lock(); //shared mutex for all sessions
-    sessions.erase(session_id); //erase the session handler from the map
-    sessions_ids.insert(session_id);
-    g_sessions.unlock();
-    session_count.fetch_sub(1); //thread-safely decrement the session counter at server class, locked by static mutex
-    try
+    release();  //delete session metadata
+    abort_waiters();    //fail pending asynchronous operations
+    //close on the session's strand, a synchronous close from this thread races the pending read for the client's close frame
+    auto self_object = shared_from_this();
+    std::shared_ptr<std::promise<void>> closed = std::make_shared<std::promise<void>>();
+    std::future<void> close_result = closed->get_future();
+    net::dispatch(strand,[self_object,closed]()
     {
-        if (stream.is_open())
-            stream.close(websocket::close_code::normal);
-    }
-    catch(...) {} //suppress exceptions
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending
+        if(!self_object->stream.is_open())
+        {
+            closed->set_value();
+            return;
+        }
+        self_object->stream.async_close(websocket::close_code::normal,net::bind_executor(self_object->strand,
+            [self_object,closed](beast::error_code){closed->set_value();}));
+    });
+    bool io_thread = strand.running_in_this_thread() || io_ctx.get_executor().running_in_this_thread();
+    if(!io_thread)  //the close may need this thread
+        close_result.wait_for(std::chrono::seconds(connection_timeout));
+    notify_close(); //session is closed, notify the user
+    if(!io_thread)  //an io thread is not held
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending
 }
 /************************************************************************************************************************
 * Function Name: stop(2)
@@ -541,18 +2856,14 @@ void ws_session::stop(void)
 * Return value: NONE
 * Description: Protected function to stop the session by session itself in error cases. session with no TLS/SSL underlayer.
 *              It stops and disconnects the client and delete its metadata
-*              metadata: session id, session's handler in sessions map, decrement sessions counter by 1.
+*              metadata: session id, session's handler in sessions directory, decrement sessions counter by 1.
 ************************************************************************************************************************/
 void ws_session::stop(int code)
 {
-    if(!ongoing_session.load()) //if session is already stopped
+    if(!ongoing_session.exchange(false)) //if session is already stopped, only one stop call releases the session
         return; //do nothing and return
-    ongoing_session = false;
-    g_sessions.lock(); //shared mutex for all sessions
-    sessions.erase(session_id); //erase the session handler from the map
-    sessions_ids.insert(session_id);
-    g_sessions.unlock();
-    session_count.fetch_sub(1);//thread-safely decrement the session counter at server class, locked by static mutex
+    release();  //delete session metadata
+    abort_waiters();    //fail pending asynchronous operations
     if(code == 0)
     {
         try
@@ -571,7 +2882,82 @@ void ws_session::stop(int code)
         }
         catch(...) {} //suppress exception
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending
+    notify_close(); //session is closed, notify the user
+}
+/************************************************************************************************************************
+* Function Name: abort_handshake
+* Class name: ws_session
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Caller thread then Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function to close a session whose handshake is not completed by the client, session with no TLS/SSL underlayer.
+*              The TCP socket is closed on the session's strand, the pending handshake fails at once and its handler
+*              releases the session, the caller doesn't wait for the client nor for the handshake deadline.
+************************************************************************************************************************/
+void ws_session::abort_handshake(void)
+{
+    auto self_object = shared_from_this();
+    net::post(strand,[self_object]()
+    {
+        boost::system::error_code errcode;
+        beast::get_lowest_layer(self_object->stream).close(errcode);   //fails the pending handshake
+    });
+}
+/************************************************************************************************************************
+* Function Name: fail_handshake
+* Class name: ws_session
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, called once from the session's strand by the failed handshake handler
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function to release a session whose handshake failed or timed out, session with no TLS/SSL underlayer.
+*              The session was never established, so there's no websocket close to send nor user to notify:
+*              the TCP socket is closed, the session metadata is deleted, then the handshake waiters are released.
+*              "ongoing_session" stays false all along, senders never see the session as established.
+************************************************************************************************************************/
+void ws_session::fail_handshake(void)
+{
+    boost::system::error_code errcode;
+    beast::get_lowest_layer(stream).close(errcode);    //disconnect the client
+    release();  //delete session metadata
+    settle_handshake();
+}
+/************************************************************************************************************************
+* Function Name: drop_connection
+* Class name: ws_session
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Caller thread then Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function to close a slow consumer session, session with no TLS/SSL underlayer.
+*              The TCP socket is closed on the session's strand first, so the pending write to the slow client
+*              fails at once instead of waiting for it, then the session is stopped.
+************************************************************************************************************************/
+void ws_session::drop_connection(void)
+{
+    auto self_object = shared_from_this();
+    net::post(strand,[self_object]()
+    {
+        boost::system::error_code errcode;
+        beast::get_lowest_layer(self_object->stream).close(errcode);   //fails the pending read and write
+        self_object->stop(-1);   //stop session
+    });
 }
 /************************************************************************************************************************
 * Function Name: receive_message
@@ -589,20 +2975,152 @@ void ws_session::stop(int code)
 *              It contains its own handler as Lambda functions called upon receiving new message then
 *              "ws_session::receive_message" is called again after handler execution.
 *              This function exits completely at session closure.
+*              The message is read into "read_data" vector and moved to the application without copying.
+*              A message of a binary frame that is not valid text for a text session with validation stops it.
 *              Access to the queue and shared variables is secured by "read_mutex" mutex
+*              It stops while the inbox is above its high water marks, then it is called again by the inbox reader
+*              from its thread and posted to the session's strand.
+************************************************************************************************************************/
+void ws_session::receive_message(void)
+{
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(!strand.running_in_this_thread())    //resumed by the inbox reader, stream operations run on the session's strand
+    {
+        net::post(strand,[self_object]()
+        {
+            if(self_object->ongoing_session.load())
+                self_object->receive_message();
+        });
+        return;
+    }
+    if(!stream.is_open())   //if stream is closed or there's no connection
+    {
+        this->stop(-1);   //stop session
+        return;
+    }
+    if(callbacks && callbacks->on_chunk)    //chunks are handed to the user as they arrive, messages are not assembled
+    {
+        if(read_chunk.size() != stream_chunk_size)
+            read_chunk.resize(stream_chunk_size);
+        stream.async_read_some(net::buffer(read_chunk),net::bind_executor(strand,[self_object](beast::error_code errcode,std::size_t bytes_received)
+        {
+            if(errcode == boost::beast::websocket::error::closed)
+            {
+                self_object->stop(0);   //stop session
+                return;
+            }
+            else if(errcode == boost::asio::error::eof)
+            {
+                self_object->stop(0);   //stop session
+                return;
+            }
+            else if(errcode)
+            {
+                self_object->stop(-1);   //stop session
+                return;
+            }
+            self_object->notify_chunk(self_object->read_chunk.data(),bytes_received,self_object->stream.is_message_done());
+            self_object->receive_message(); //receive the next chunk
+        }));
+        return;
+    }
+    if(pool && read_data.capacity() == 0)   //take a buffer sized as the last received message
+        read_data = pool->acquire(read_size_hint);
+    read_buffer.emplace(read_data); //dynamic buffer over the empty "read_data", the stream reads the message into it
+    stream.async_read(*read_buffer,net::bind_executor(strand,[self_object](beast::error_code errcode,std::size_t bytes_received)
+    {
+        if(errcode == boost::beast::websocket::error::closed)
+        {
+            self_object->stop(0);   //stop session
+            return;
+        }
+        else if(errcode == boost::asio::error::eof)
+        {
+            self_object->stop(0);   //stop session
+            return;
+        }
+        else if(errcode)
+        {
+            self_object->stop(-1);   //stop session
+            return;
+        }
+        boost::ignore_unused(bytes_received);   //the message size is the size of "read_data"
+        if (self_object->read_data.empty()) //empty message, receive again
+        {
+            self_object->receive_message();
+            return;
+        }
+        if(!self_object->stream.got_text() && !self_object->valid_text(self_object->read_data))  //text frames are validated by the stream
+        {
+            self_object->stop(-1);   //not valid text for a text session with validation, stop session
+            return;
+        }
+        std::vector<unsigned char> received_data = std::move(self_object->read_data);   //take the received bytes, no copy
+        self_object->read_size_hint = received_data.size();
+        if(self_object->deliver_message(std::move(received_data),self_object)) //to user callback, pending read or the queue
+            self_object->receive_message(); //receive again, unless the inbox reached its high water mark
+    }));
+}
+/************************************************************************************************************************
+* Function Name: write_message
+* Class name: ws_session
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Parameters (in): NONE
+* Expected  Exception: No
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal Asynchronous function called by the first queued message when no write is in flight,
+*              then by its own write handler until the queue is drained, so only one write is in flight at a time.
+*              It runs on the session's strand, it is posted to it if called from another thread.
+*              It contains its own handler as Lambda functions called upon sending the new message to handle any error occurs.
+*              Access to the queue and shared variables is secured by "send_mutex" mutex
+*              The message\'s completion handler, if any, is called from the write handler.
+*              A streamed message is written by "write_stream", which calls this function after its last fragment.
+*              Small messages queued together are gathered and written by one write, refer to "write_gathered".
+*              session is not with TLS/SSL underlayer.
 ************************************************************************************************************************/
-void ws_session::receive_message(void)
+void ws_session::write_message(void)
 {
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(!strand.running_in_this_thread())    //stream operations run on the session's strand, beside its read
+    {
+        net::post(strand,[self_object](){self_object->write_message();});
+        return;
+    }
     if(!stream.is_open())   //if stream is closed or there's no connection
     {
         this->stop(-1);   //stop session
         return;
     }
-    std::shared_ptr<beast::flat_buffer> buffer = std::make_shared<beast::flat_buffer>();
-    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
-    auto self_object = shared_from_this();
-    stream.async_read(*buffer,net::bind_executor(strand,[buffer,self_object](beast::error_code errcode,std::size_t bytes_received) mutable //mutable lambda expression
+    shared_payload message;
+    sent_handler handler;
+    if(!take_message(message,handler))  //all messages are written, or aborted by session closure
+        return;
+    if(message == stream_marker())  //streamed message, written fragment by fragment from its source
     {
+        writing_handler = std::move(handler);
+        stream.binary(true);    //any bytes, sent in binary frames whatever the frames type of the session
+        this->write_stream();
+        return;
+    }
+    if(take_batch(message,handler)) //small queued messages, gathered and written together
+    {
+        stream.next_layer().gather();
+        this->write_gathered(0);
+        return;
+    }
+    net::const_buffer buffer(message->data(), message->size());
+    //the payload is captured to keep it alive until it is written, it may be shared with other sessions queues
+    stream.async_write(buffer,net::bind_executor(strand,[self_object,handler,message](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    {
+        if(handler) //asynchronous send, message is written or failed
+            handler(errcode);
         if(errcode == boost::beast::websocket::error::closed)
         {
             self_object->stop(0);   //stop session
@@ -613,58 +3131,129 @@ void ws_session::receive_message(void)
             self_object->stop(0);   //stop session
             return;
         }
-        else if(errcode)
+        else if(errcode) //failed to send
         {
             self_object->stop(-1);   //stop session
             return;
         }
-        if (buffer->size() == 0) //empty buffer, receive again
-            self_object->receive_message();
-        auto date_buffer_ptr = net::buffer_cast<unsigned char*>(buffer->data()); //get ptr to the buffer for the "vector of unsigned char"
-        std::size_t data_size = buffer->size();
-        std::vector<unsigned char> received_data(date_buffer_ptr,date_buffer_ptr + data_size);  //store
-        self_object->read_mutex.lock();
-        self_object->read_messages_queue.push_back(received_data);  //push received data into the queue
-        self_object->read_mutex.unlock();
-        buffer->consume(bytes_received);   //clear the buffer
-        buffer->clear();
-        std::string rec_string(received_data.begin(),received_data.end());
-        self_object->receive_message(); //receive again
+        boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        self_object->write_message();   //write the next queued message, one write in flight at a time
     }));
 }
 /************************************************************************************************************************
-* Function Name: write_message
+* Function Name: write_gathered
 * Class name: ws_session
-* Access: Protected - Accessed only by server classes
+* Access: Protected - Accessed only by sessions classes
 * Specifiers: NONE
 * Running Thread: Pool thread
 * Sync/Async: Asynchronous
-* Reentrancy: Reentrant
-* Parameters (in): NONE
+* Reentrancy: Non-Reentrant, called from the session's strand by the writes only
+* Parameters (in): index of the next message of "writing_batch" to be framed
 * Expected  Exception: No
 * Parameters (out): NONE
 * Return value: NONE
-* Description: Internal Asynchronous function called after a each "ws_server_base::send_message" function call
-*              It contains its own handler as Lambda functions called upon sending the new message to handle any error occurs.
-*              Access to the queue and shared variables is secured by "send_mutex" mutex
-*              session is not with TLS/SSL underlayer.
+* Description: Internal Asynchronous function framing the messages of "writing_batch" one per call while the stream
+*              gathers them, each frame is appended to the gathering buffer and completed at once. After the last
+*              one, all frames are written by a single write of "gather_stream::async_flush", one syscall, then the
+*              messages handlers are called, refer to "settle_batch", and "write_message" writes the next queued
+*              messages. session with no TLS/SSL underlayer.
 ************************************************************************************************************************/
-void ws_session::write_message(void)
+void ws_session::write_gathered(std::size_t index)
 {
-    if(!stream.is_open())   //if stream is closed or there's no connection
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(index == writing_batch.size())   //all messages are framed, write them at once
     {
-        this->stop(-1);   //stop session
+        stream.next_layer().async_flush(net::bind_executor(strand,[self_object](beast::error_code errcode)
+        {
+            self_object->settle_batch(errcode);
+            if(errcode == boost::beast::websocket::error::closed)
+            {
+                self_object->stop(0);   //stop session
+                return;
+            }
+            else if(errcode == boost::asio::error::eof)
+            {
+                self_object->stop(0);   //stop session
+                return;
+            }
+            else if(errcode) //failed to send
+            {
+                self_object->stop(-1);   //stop session
+                return;
+            }
+            self_object->write_message();   //write the next queued messages, one write in flight at a time
+        }));
         return;
     }
-    send_mutex.lock();
-    std::vector<unsigned char> message = send_messages_queue.front();
-    send_messages_queue.pop_front();    //read front then pop
-    send_mutex.unlock();
-    net::const_buffer buffer(message.data(), message.size());
+    net::const_buffer buffer(writing_batch[index]->data(), writing_batch[index]->size());
+    stream.async_write(buffer,net::bind_executor(strand,[self_object,index](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    {
+        boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        if(!errcode)
+        {
+            self_object->write_gathered(index+1);   //frame the next message
+            return;
+        }
+        self_object->settle_batch(errcode);
+        //frames gathered before the failure are flushed, then the session is stopped
+        self_object->stream.next_layer().async_flush(net::bind_executor(self_object->strand,[self_object,errcode](beast::error_code)
+        {
+            if(errcode == boost::beast::websocket::error::closed || errcode == boost::asio::error::eof)
+                self_object->stop(0);   //stop session
+            else
+                self_object->stop(-1);   //stop session
+        }));
+    }));
+}
+/************************************************************************************************************************
+* Function Name: write_stream
+* Class name: ws_session
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Non-Reentrant, called from the session's strand by the writes only
+* Parameters (in): NONE
+* Expected  Exception: No
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal Asynchronous function writing the streamed message of "writing_source", one fragment per
+*              call. The source returns the next fragment, written as a websocket frame without ending the message,
+*              its write handler calls this function again. Once the source returns an empty fragment, the
+*              final empty frame ends the message, "writing_handler" is called and "write_message" writes the next
+*              queued message. Only one fragment is held in memory. The message is sent in binary frames, the
+*              frames type of the session is set back after its last fragment. session with no TLS/SSL underlayer.
+*              A source that throws aborts the message, its handler fails and the connection is closed.
+************************************************************************************************************************/
+void ws_session::write_stream(void)
+{
     //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
     auto self_object = shared_from_this();
-    stream.async_write(buffer,net::bind_executor(strand,[self_object](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    net::const_buffer fragment; //valid until "writing_source" is released
+    if(!next_fragment(fragment))    //user source failed, the message can't be completed
     {
+        writing_source = nullptr;
+        sent_handler handler = std::move(writing_handler);
+        writing_handler = nullptr;
+        if(handler)
+            handler(net::error::operation_aborted);
+        this->stop(-1);
+        return;
+    }
+    bool last_fragment = fragment.size() == 0;
+    stream.async_write_some(last_fragment,fragment,
+        net::bind_executor(strand,[self_object,last_fragment](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    {
+        if(errcode || last_fragment)    //message is written or failed
+        {
+            self_object->stream.binary(self_object->framing.mode == frame_mode::binary);  //back to the frames type of the session
+            self_object->writing_source = nullptr;
+            sent_handler handler = std::move(self_object->writing_handler);
+            self_object->writing_handler = nullptr;
+            if(handler)
+                handler(errcode);
+        }
         if(errcode == boost::beast::websocket::error::closed)
         {
             self_object->stop(0);   //stop session
@@ -681,6 +3270,10 @@ void ws_session::write_message(void)
             return;
         }
         boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        if(last_fragment)
+            self_object->write_message();   //write the next queued message
+        else
+            self_object->write_stream();    //write the next fragment
     }));
 }
 /************************************************************************************************************************
@@ -689,7 +3282,7 @@ void ws_session::write_message(void)
 * Access: Protected - Accessed only by server classes
 * Specifiers: NONE
 * Running Thread: Pool thread
-* Sync/Async: Synchronous
+* Sync/Async: Asynchronous
 * Reentrancy: Reentrant
 * Expected  Exception: No
 * Parameters (in): NONE
@@ -697,53 +3290,57 @@ void ws_session::write_message(void)
 * Return value: NONE
 * Description: Protected function to start a new session by server. session with TLS/SSL underlayer.
 *              server starts the new session as new client tries to connect to the server.
+*              It returns immediately, both handshakes are driven by their async handlers with a "handshake_timer" deadline.
 *              if the session is started successfully, it starts receiving operations and update its status.
-*              if session failed to start, it stops and disconnects the client and delete its metadata
-*              metadata: session id, session's handler in sessions map, decrement sessions counter by 1.
+*              if session failed to start or its deadline expired, it disconnects the client and delete its metadata
+*              by "fail_handshake", the session is never established.
+*              metadata: session id, session's handler in sessions directory, decrement sessions counter by 1.
 ************************************************************************************************************************/
 void wss_session::start(void)
 {
     //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
     auto self_object = shared_from_this();
-    stream.next_layer().async_handshake(ssl::stream_base::server, //make the SSL handshake,server side, session key sharing
-    [self_object](boost::system::error_code errcode)   //and certificates verification if exists
+    handshake_timer.expires_after(std::chrono::seconds(connection_timeout));
+    handshake_timer.async_wait(net::bind_executor(strand,[self_object](boost::system::error_code errcode)
+    {
+        if(errcode || self_object->ongoing_session.load()) //deadline cancelled or session already established
+            return;
+        beast::get_lowest_layer(self_object->stream).cancel();  //abort the handshakes, their handler releases the session
+    }));
+    stream.next_layer().next_layer().async_handshake(ssl::stream_base::server, //make the SSL handshake,server side, session key sharing
+    net::bind_executor(strand,[self_object](boost::system::error_code errcode)   //and certificates verification if exists
     {
         if(errcode)
         {
-            self_object->ongoing_session = true;
-            self_object->stop(-1);   //set "ongoing_session" to true to allow session closing
+            self_object->handshake_timer.cancel();
+            self_object->fail_handshake();  //never opened, the session is released without closing it
             return;
         }
+        self_object->handshakes->count(self_object->stream.next_layer().next_layer().native_handle());   //full or resumed handshake
         //set the suggested timeout settings for the websocket as the server
         self_object->stream.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
-        self_object->stream.set_option(websocket::stream_base::decorator([](websocket::response_type& response)//****
+        self_object->stream.set_option(websocket::stream_base::decorator([session = self_object.get()](websocket::response_type& response)//****
         {
+            session->handshake_responding = true;   //response is written next, the handshake handler follows
             response.set(http::field::server,std::string(BOOST_BEAST_VERSION_STRING)+"websocket-server-async-ssl");
         }));
-        self_object->stream.async_accept([self_object](boost::system::error_code errcode2) mutable  //mutable lambda expression
+        Set_Deflate(self_object->stream,self_object->compression,true); //permessage-deflate negotiation, accepted if offered by client
+        self_object->stream.binary(self_object->framing.mode == frame_mode::binary);    //frames type of sent messages
+        self_object->stream.async_accept(net::bind_executor(self_object->strand,[self_object](boost::system::error_code errcode2) mutable  //mutable lambda expression
         {
+            self_object->handshake_timer.cancel();  //handshakes finished, cancel their deadline
             if(errcode2)
             {
-                self_object->ongoing_session = true;
-                self_object->stop(-1);//set "ongoing_session" to true to allow session closing
+                self_object->fail_handshake();  //never opened, the session is released without closing it
                 return;
             }
             // All functions are successfull
             self_object->ongoing_session = true;
-            //all function are successfull
+            self_object->settle_handshake();    //before "on_open", it may use the session
+            self_object->notify_open();
             self_object->receive_message(); //trigger receive message call
-        });
-    });
-    //Boost's default handshake timeout connection for websocket is 30seconds
-    int i = 0;  //timeout check loop
-    while((i++<connection_timeout) && (!ongoing_session.load()))
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    if(!ongoing_session.load())  //if connection is not successfull
-    {
-        self_object->ongoing_session = true;
-        self_object->stop();   //stop if not stopped
-        return;
-    }
+        }));
+    }));
 }
 /************************************************************************************************************************
 * Function Name: stop(1)
@@ -759,25 +3356,37 @@ void wss_session::start(void)
 * Return value: NONE
 * Description: Protected function to stop thesession by server willingly. session with TLS/SSL underlayer.
 *              It stops and disconnects the client and delete its metadata
-*              metadata: session id, session's handler in sessions map, decrement sessions counter by 1.
+*              metadata: session id, session's handler in sessions directory, decrement sessions counter by 1.
+*              The close handshake runs on the session's strand beside its pending read, the caller waits for it
+*              up to the connection timeout then a short delay, unless it is called from a thread running the session's
+*              io_context, as callbacks do, the close may be queued behind the caller on this thread.
 ************************************************************************************************************************/
 void wss_session::stop(void)
 {
-    if(!ongoing_session.load()) //if session is already stopped
+    if(!ongoing_session.exchange(false)) //if session is already stopped, only one stop call releases the session
         return; //do nothing and return
-    ongoing_session = false;
-    g_sessions.lock(); //static mutex for all sessions
-    sessions.erase(session_id); //erase the session handler from the map
-    sessions_ids.insert(session_id);
-    g_sessions.unlock();
-    session_count.fetch_sub(1);//thread-safely decrement the session counter at server class, locked by static mutex
-    try
+    release();  //delete session metadata
+    abort_waiters();    //fail pending asynchronous operations
+    //close on the session's strand, a synchronous close from this thread races the pending read for the client's close frame
+    auto self_object = shared_from_this();
+    std::shared_ptr<std::promise<void>> closed = std::make_shared<std::promise<void>>();
+    std::future<void> close_result = closed->get_future();
+    net::dispatch(strand,[self_object,closed]()
     {
-        if (stream.is_open())
-            stream.close(websocket::close_code::normal);
-    }
-    catch(...) {} //suppress exception
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending
+        if(!self_object->stream.is_open())
+        {
+            closed->set_value();
+            return;
+        }
+        self_object->stream.async_close(websocket::close_code::normal,net::bind_executor(self_object->strand,
+            [self_object,closed](beast::error_code){closed->set_value();}));
+    });
+    bool io_thread = strand.running_in_this_thread() || io_ctx.get_executor().running_in_this_thread();
+    if(!io_thread)  //the close may need this thread
+        close_result.wait_for(std::chrono::seconds(connection_timeout));
+    notify_close(); //session is closed, notify the user
+    if(!io_thread)  //an io thread is not held
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending
 }
 /************************************************************************************************************************
 * Function Name: stop(2)
@@ -793,18 +3402,14 @@ void wss_session::stop(void)
 * Return value: NONE
 * Description: Protected function to stop the session by session itself in error cases. session with TLS/SSL underlayer.
 *              It stops and disconnects the client and delete its metadata
-*              metadata: session id, session's handler in sessions map, decrement sessions counter by 1.
+*              metadata: session id, session's handler in sessions directory, decrement sessions counter by 1.
 ************************************************************************************************************************/
 void wss_session::stop(int code)
 {
-    if(!ongoing_session.load()) //if session is already stopped
+    if(!ongoing_session.exchange(false)) //if session is already stopped, only one stop call releases the session
         return; //do nothing and return
-    ongoing_session = false;
-    g_sessions.lock(); //static mutex for all sessions
-    sessions.erase(session_id); //erase the session handler from the map
-    sessions_ids.insert(session_id);
-    g_sessions.unlock();
-    session_count.fetch_sub(1);//thread-safely decrement the session counter at server class, locked by static mutex
+    release();  //delete session metadata
+    abort_waiters();    //fail pending asynchronous operations
     if(code == 0)
     {
         try
@@ -823,7 +3428,82 @@ void wss_session::stop(int code)
         }
         catch(...) {} //suppress exception
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));    //delay before ending
+    notify_close(); //session is closed, notify the user
+}
+/************************************************************************************************************************
+* Function Name: abort_handshake
+* Class name: wss_session
+* Access: Protected - Accessed only by server classes
+* Specifiers: NONE
+* Running Thread: Caller thread then Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function to close a session whose handshake is not completed by the client, session with TLS/SSL underlayer.
+*              The TCP socket is closed on the session's strand, the pending handshake fails at once and its handler
+*              releases the session, the caller doesn't wait for the client nor for the handshake deadline.
+************************************************************************************************************************/
+void wss_session::abort_handshake(void)
+{
+    auto self_object = shared_from_this();
+    net::post(strand,[self_object]()
+    {
+        boost::system::error_code errcode;
+        beast::get_lowest_layer(self_object->stream).close(errcode);   //fails the pending handshake
+    });
+}
+/************************************************************************************************************************
+* Function Name: fail_handshake
+* Class name: wss_session
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Synchronous
+* Reentrancy: Non-Reentrant, called once from the session's strand by the failed handshake handler
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function to release a session whose handshake failed or timed out, session with TLS/SSL underlayer.
+*              The session was never established, so there's no websocket close to send nor user to notify:
+*              the TCP socket is closed, the session metadata is deleted, then the handshake waiters are released.
+*              "ongoing_session" stays false all along, senders never see the session as established.
+************************************************************************************************************************/
+void wss_session::fail_handshake(void)
+{
+    boost::system::error_code errcode;
+    beast::get_lowest_layer(stream).close(errcode);    //disconnect the client
+    release();  //delete session metadata
+    settle_handshake();
+}
+/************************************************************************************************************************
+* Function Name: drop_connection
+* Class name: wss_session
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Caller thread then Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Reentrant
+* Expected  Exception: No
+* Parameters (in): NONE
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Protected function to close a slow consumer session, session with TLS/SSL underlayer.
+*              The TCP socket is closed on the session's strand first, so the pending write to the slow client
+*              fails at once instead of waiting for it, then the session is stopped.
+************************************************************************************************************************/
+void wss_session::drop_connection(void)
+{
+    auto self_object = shared_from_this();
+    net::post(strand,[self_object]()
+    {
+        boost::system::error_code errcode;
+        beast::get_lowest_layer(self_object->stream).close(errcode);   //fails the pending read and write
+        self_object->stop(-1);   //stop session
+    });
 }
 /************************************************************************************************************************
 * Function Name: receive_message
@@ -841,19 +3521,60 @@ void wss_session::stop(int code)
 *              It contains its own handler as Lambda functions called upon receiving new message then
 *              "ws_session::receive_message" is called again after handler execution.
 *              This function exits completely at session closure.
+*              The message is read into "read_data" vector and moved to the application without copying.
+*              A message of a binary frame that is not valid text for a text session with validation stops it.
 *              Access to the queue and shared varibales is secured by "read_mutex" mutex
+*              It stops while the inbox is above its high water marks, then it is called again by the inbox reader
+*              from its thread and posted to the session's strand.
 ************************************************************************************************************************/
 void wss_session::receive_message(void)
 {
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(!strand.running_in_this_thread())    //resumed by the inbox reader, stream operations run on the session's strand
+    {
+        net::post(strand,[self_object]()
+        {
+            if(self_object->ongoing_session.load())
+                self_object->receive_message();
+        });
+        return;
+    }
     if(!stream.is_open())   //if stream is closed or there's no connection
     {
         this->stop(-1);   //stop session
         return;
     }
-    std::shared_ptr<beast::flat_buffer> buffer = std::make_shared<beast::flat_buffer>();
-    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
-    auto self_object = shared_from_this();
-    stream.async_read(*buffer,net::bind_executor(strand,[buffer,self_object](beast::error_code errcode,std::size_t bytes_received) mutable //mutable lambda expression
+    if(callbacks && callbacks->on_chunk)    //chunks are handed to the user as they arrive, messages are not assembled
+    {
+        if(read_chunk.size() != stream_chunk_size)
+            read_chunk.resize(stream_chunk_size);
+        stream.async_read_some(net::buffer(read_chunk),net::bind_executor(strand,[self_object](beast::error_code errcode,std::size_t bytes_received)
+        {
+            if(errcode == boost::beast::websocket::error::closed)
+            {
+                self_object->stop(0);   //stop session
+                return;
+            }
+            else if(errcode == boost::asio::error::eof)
+            {
+                self_object->stop(0);   //stop session
+                return;
+            }
+            else if(errcode)
+            {
+                self_object->stop(-1);   //stop session
+                return;
+            }
+            self_object->notify_chunk(self_object->read_chunk.data(),bytes_received,self_object->stream.is_message_done());
+            self_object->receive_message(); //receive the next chunk
+        }));
+        return;
+    }
+    if(pool && read_data.capacity() == 0)   //take a buffer sized as the last received message
+        read_data = pool->acquire(read_size_hint);
+    read_buffer.emplace(read_data); //dynamic buffer over the empty "read_data", the stream reads the message into it
+    stream.async_read(*read_buffer,net::bind_executor(strand,[self_object](beast::error_code errcode,std::size_t bytes_received)
     {
         if(errcode == boost::beast::websocket::error::closed)
         {
@@ -870,18 +3591,21 @@ void wss_session::receive_message(void)
             self_object->stop(-1);   //stop session
             return;
         }
-        if (buffer->size() == 0) //empty buffer, receive again
+        boost::ignore_unused(bytes_received);   //the message size is the size of "read_data"
+        if (self_object->read_data.empty()) //empty message, receive again
+        {
             self_object->receive_message();
-        auto date_buffer_ptr = net::buffer_cast<unsigned char*>(buffer->data()); //get ptr to the buffer for the "vector of unsigned char"
-        std::size_t data_size = buffer->size();
-        std::vector<unsigned char> received_data(date_buffer_ptr,date_buffer_ptr + data_size);  //store
-        self_object->read_mutex.lock();
-        self_object->read_messages_queue.push_back(received_data);  //push received data into the queue
-        self_object->read_mutex.unlock();
-        buffer->consume(bytes_received);   //clear the buffer
-        buffer->clear();
-        std::string rec_string(received_data.begin(),received_data.end());
-        self_object->receive_message(); //receive again
+            return;
+        }
+        if(!self_object->stream.got_text() && !self_object->valid_text(self_object->read_data))  //text frames are validated by the stream
+        {
+            self_object->stop(-1);   //not valid text for a text session with validation, stop session
+            return;
+        }
+        std::vector<unsigned char> received_data = std::move(self_object->read_data);   //take the received bytes, no copy
+        self_object->read_size_hint = received_data.size();
+        if(self_object->deliver_message(std::move(received_data),self_object)) //to user callback, pending read or the queue
+            self_object->receive_message(); //receive again, unless the inbox reached its high water mark
     }));
 }
 /************************************************************************************************************************
@@ -896,27 +3620,186 @@ void wss_session::receive_message(void)
 * Expected  Exception: No
 * Parameters (out): NONE
 * Return value: NONE
-* Description: Internal Asynchronous function called after a each "ws_server_base::send_message" function call
+* Description: Internal Asynchronous function called by the first queued message when no write is in flight,
+*              then by its own write handler until the queue is drained, so only one write is in flight at a time.
+*              It runs on the session's strand, it is posted to it if called from another thread.
 *              It contains its own handler as Lambda functions called upon sending the new message to handle any error occurs.
 *              Access to the queue and shared varibales is secured by "send_mutex" mutex.
+*              The message\'s completion handler, if any, is called from the write handler.
+*              A streamed message is written by "write_stream", which calls this function after its last fragment.
+*              Small messages queued together are gathered and written by one write, refer to "write_gathered".
 *              session is with TLS/SSL underlayer.
 ************************************************************************************************************************/
 void wss_session::write_message(void)
 {
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(!strand.running_in_this_thread())    //stream operations run on the session's strand, beside its read
+    {
+        net::post(strand,[self_object](){self_object->write_message();});
+        return;
+    }
     if(!stream.is_open())   //if stream is closed or there's no connection
     {
         this->stop(-1);   //stop session
         return;
     }
-    send_mutex.lock();
-    std::vector<unsigned char> message = send_messages_queue.front();
-    send_messages_queue.pop_front();    //read front then pop
-    send_mutex.unlock();
-    net::const_buffer buffer(message.data(), message.size());
+    shared_payload message;
+    sent_handler handler;
+    if(!take_message(message,handler))  //all messages are written, or aborted by session closure
+        return;
+    if(message == stream_marker())  //streamed message, written fragment by fragment from its source
+    {
+        writing_handler = std::move(handler);
+        stream.binary(true);    //any bytes, sent in binary frames whatever the frames type of the session
+        this->write_stream();
+        return;
+    }
+    if(take_batch(message,handler)) //small queued messages, gathered and written together
+    {
+        stream.next_layer().gather();
+        this->write_gathered(0);
+        return;
+    }
+    net::const_buffer buffer(message->data(), message->size());
+    //the payload is captured to keep it alive until it is written, it may be shared with other sessions queues
+    stream.async_write(buffer,net::bind_executor(strand,[self_object,handler,message](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    {
+        if(handler) //asynchronous send, message is written or failed
+            handler(errcode);
+        if(errcode == boost::beast::websocket::error::closed)
+        {
+            self_object->stop(0);   //stop session
+            return;
+        }
+        else if(errcode == boost::asio::error::eof)
+        {
+            self_object->stop(0);   //stop session
+            return;
+        }
+        else if(errcode) //failed to send
+        {
+            self_object->stop(-1);   //stop session
+            return;
+        }
+        boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        self_object->write_message();   //write the next queued message, one write in flight at a time
+    }));
+}
+/************************************************************************************************************************
+* Function Name: write_gathered
+* Class name: wss_session
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Non-Reentrant, called from the session's strand by the writes only
+* Parameters (in): index of the next message of "writing_batch" to be framed
+* Expected  Exception: No
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal Asynchronous function framing the messages of "writing_batch" one per call while the stream
+*              gathers them, each frame is appended to the gathering buffer and completed at once. After the last
+*              one, all frames are written by a single write of "gather_stream::async_flush", one syscall, then the
+*              messages handlers are called, refer to "settle_batch", and "write_message" writes the next queued
+*              messages. session with TLS/SSL underlayer.
+************************************************************************************************************************/
+void wss_session::write_gathered(std::size_t index)
+{
+    //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
+    auto self_object = shared_from_this();
+    if(index == writing_batch.size())   //all messages are framed, write them at once
+    {
+        stream.next_layer().async_flush(net::bind_executor(strand,[self_object](beast::error_code errcode)
+        {
+            self_object->settle_batch(errcode);
+            if(errcode == boost::beast::websocket::error::closed)
+            {
+                self_object->stop(0);   //stop session
+                return;
+            }
+            else if(errcode == boost::asio::error::eof)
+            {
+                self_object->stop(0);   //stop session
+                return;
+            }
+            else if(errcode) //failed to send
+            {
+                self_object->stop(-1);   //stop session
+                return;
+            }
+            self_object->write_message();   //write the next queued messages, one write in flight at a time
+        }));
+        return;
+    }
+    net::const_buffer buffer(writing_batch[index]->data(), writing_batch[index]->size());
+    stream.async_write(buffer,net::bind_executor(strand,[self_object,index](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    {
+        boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        if(!errcode)
+        {
+            self_object->write_gathered(index+1);   //frame the next message
+            return;
+        }
+        self_object->settle_batch(errcode);
+        //frames gathered before the failure are flushed, then the session is stopped
+        self_object->stream.next_layer().async_flush(net::bind_executor(self_object->strand,[self_object,errcode](beast::error_code)
+        {
+            if(errcode == boost::beast::websocket::error::closed || errcode == boost::asio::error::eof)
+                self_object->stop(0);   //stop session
+            else
+                self_object->stop(-1);   //stop session
+        }));
+    }));
+}
+/************************************************************************************************************************
+* Function Name: write_stream
+* Class name: wss_session
+* Access: Protected - Accessed only by sessions classes
+* Specifiers: NONE
+* Running Thread: Pool thread
+* Sync/Async: Asynchronous
+* Reentrancy: Non-Reentrant, called from the session's strand by the writes only
+* Parameters (in): NONE
+* Expected  Exception: No
+* Parameters (out): NONE
+* Return value: NONE
+* Description: Internal Asynchronous function writing the streamed message of "writing_source", one fragment per
+*              call. The source returns the next fragment, written as a websocket frame without ending the message,
+*              its write handler calls this function again. Once the source returns an empty fragment, the
+*              final empty frame ends the message, "writing_handler" is called and "write_message" writes the next
+*              queued message. Only one fragment is held in memory. The message is sent in binary frames, the
+*              frames type of the session is set back after its last fragment. session with TLS/SSL underlayer.
+*              A source that throws aborts the message, its handler fails and the connection is closed.
+************************************************************************************************************************/
+void wss_session::write_stream(void)
+{
     //to avoid object destroying during async operations and keep the object alive until end of the scope of "self_object" shared_ptr
     auto self_object = shared_from_this();
-    stream.async_write(buffer,net::bind_executor(strand,[self_object](beast::error_code errcode, std::size_t bytes_sent_dummy)
+    net::const_buffer fragment; //valid until "writing_source" is released
+    if(!next_fragment(fragment))    //user source failed, the message can't be completed
+    {
+        writing_source = nullptr;
+        sent_handler handler = std::move(writing_handler);
+        writing_handler = nullptr;
+        if(handler)
+            handler(net::error::operation_aborted);
+        this->stop(-1);
+        return;
+    }
+    bool last_fragment = fragment.size() == 0;
+    stream.async_write_some(last_fragment,fragment,
+        net::bind_executor(strand,[self_object,last_fragment](beast::error_code errcode, std::size_t bytes_sent_dummy)
     {
+        if(errcode || last_fragment)    //message is written or failed
+        {
+            self_object->stream.binary(self_object->framing.mode == frame_mode::binary);  //back to the frames type of the session
+            self_object->writing_source = nullptr;
+            sent_handler handler = std::move(self_object->writing_handler);
+            self_object->writing_handler = nullptr;
+            if(handler)
+                handler(errcode);
+        }
         if(errcode == boost::beast::websocket::error::closed)
         {
             self_object->stop(0);   //stop session
@@ -933,5 +3816,9 @@ void wss_session::write_message(void)
             return;
         }
         boost::ignore_unused(bytes_sent_dummy); //ignore the dummy parameter
+        if(last_fragment)
+            self_object->write_message();   //write the next queued message
+        else
+            self_object->write_stream();    //write the next fragment
     }));
 }
@@ -62,12 +62,29 @@
 #include <boost/asio/strand.hpp>
 #include <unordered_map>
 #include <unordered_set>
+#include <string>
+#include <vector>
+#include <cstdint>
 #include <memory>
 #include <deque>
+#include <optional>
 #include <chrono>
 #include <thread>
 #include <functional>
+#include <future>
+#include <array>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <sys/socket.h>
 #include "ssl_conf.h"
+#include "ws_message.h"
+#include "deflate_conf.h"
+#include "utf8_validator.h"
+#include "mapped_file.h"
+#include "tls_session.h"
+#include "gather_stream.h"
 #include <iostream>
 /************************************************************************************************************************
  *                     							   NAMESPACES
@@ -81,6 +98,10 @@ using tcp = boost::asio::ip::tcp;
 /***********************************************************************************************************************
  *                     					      FORWARD DECLARATIONS
  ***********************************************************************************************************************/
+class ids_allocator;
+class sessions_directory;
+class topics_directory;
+class buffer_pool;
 class server_abstract;
 class ws_server_base;
 class ws_server;
@@ -92,13 +113,204 @@ class ws_session;
 /***********************************************************************************************************************
  *                                                  ALIASES
  ***********************************************************************************************************************/
-using ws_stream = websocket::stream<tcp::socket>;   //stream type for websockets
-using wss_stream = websocket::stream<beast::ssl_stream<tcp::socket>>; //stream type for websockets secure
+using ws_stream = websocket::stream<gather_stream<tcp::socket>>;   //stream type for websockets
+using wss_stream = websocket::stream<gather_stream<beast::ssl_stream<tcp::socket>>>; //stream type for websockets secure
 using session_hndl = std::weak_ptr<session_abstract>;   //session hndl, for handling and dealing with sessions objects
+using message_handler = std::function<void(boost::system::error_code,std::vector<unsigned char>)>;   //completion of a message read
+using sent_handler = std::function<void(boost::system::error_code)>;    //completion of a message write or a connection
+using received_buffer = net::dynamic_vector_buffer<unsigned char,std::allocator<unsigned char>>;   //dynamic buffer reading a message into a vector
+using stream_source = std::function<std::size_t(unsigned char*,std::size_t)>;  //fills the next fragment of a streamed message, returns its size, 0 ends the message
+/***********************************************************************************************************************
+ *                                                  ENUMS
+ ***********************************************************************************************************************/
+enum class overflow_policy  //what a session does with a new message once its outbox reached one of its limits
+{
+    block,          //the caller waits until the session writes enough queued messages, or the block timeout expires,
+                    //only outside the io threads, a caller running on them, as callbacks do, drops the message at once
+    drop_oldest,    //the oldest unwritten messages are dropped to make room for the new message
+    drop_newest,    //the new message is dropped
+    disconnect      //the session is closed as a slow consumer, the new message is dropped
+};
+enum class send_status  //outcome of queuing a message to a session
+{
+    queued,         //message is queued, after waiting for room with "block" policy
+    dropped_oldest, //message is queued after dropping the oldest unwritten messages
+    dropped,        //message is not queued, outbox is full with "drop_newest" policy or "block" timed out
+    invalid,        //message is not queued, it is not valid UTF-8 for a text session with validation
+    unreadable,     //file is not queued, it can't be mapped or the range exceeds it
+    disconnected,   //message is not queued, the session is closed as a slow consumer
+    not_found       //message is not queued, the session is not found or not running
+};
+/***********************************************************************************************************************
+ *                                                  STRUCTS
+ ***********************************************************************************************************************/
+struct session_callbacks    //user callbacks of the server's sessions, called from the session's strand
+{
+    std::function<void(int)> on_open;   //called with session ID after the session handshake
+    std::function<void(int,std::vector<unsigned char>&&)> on_message;   //called with session ID and received message, message is not queued
+    std::function<void(int)> on_close;  //called with session ID after an opened session closure
+    std::function<void(int,const unsigned char*,std::size_t,bool)> on_chunk;    //called with session ID and each received chunk, true at the end of the message, messages are not assembled
+};
+struct inbox_limits  //water marks of each session inbox, 0 means no mark
+{
+    std::size_t high_messages = 0;  //reading from the peer is paused once the queued messages reach it
+    std::size_t high_bytes = 0; //reading from the peer is paused once the queued bytes reach it
+    std::size_t low_messages = 0;   //reading is resumed once the queued messages are at or below it
+    std::size_t low_bytes = 0;  //reading is resumed once the queued bytes are at or below it
+};
+struct inbox_stats  //depth of a session inbox
+{
+    std::size_t messages = 0;   //queued messages
+    std::size_t bytes = 0;  //bytes of the queued messages
+    bool paused = false;    //reading from the peer is paused by the high water mark
+};
+struct outbox_limits //limits of each session outbox, unwritten messages only, 0 means no limit
+{
+    std::size_t max_messages = 0;   //unwritten messages limit
+    std::size_t max_bytes = 0;  //unwritten bytes limit, a single message larger than it is queued to an empty outbox
+    overflow_policy policy = overflow_policy::drop_newest;  //applied to a new message over one of the limits
+    std::chrono::milliseconds block_timeout = std::chrono::seconds(30);   //longest wait of "block" policy
+};
+struct buffer_pool_stats    //counters of the server's buffers pools
+{
+    std::size_t hits = 0;   //buffers reused from the free lists
+    std::size_t misses = 0; //buffers allocated as no fitting free buffer was found
+    std::size_t retained_bytes = 0; //capacity of the free buffers kept for reuse
+};
 /***********************************************************************************************************************
  *                                                  CLASSES
  ***********************************************************************************************************************/
 /************************************************************************************************************************
+* Class Name: ids_allocator
+* Purpose: Sessions IDs allocator, always gives the lowest available ID
+* Abstract/Concrete: Concrete
+* #Instances: One instance per server
+* Exception Expected: No
+* Inherited Classes: NONE
+* Constructors:
+*               1- Default Non-parameterized constructor, no IDs available until "reset" is called - public
+*
+* Description: Hierarchical bitmap of available IDs. Level 0 has a bit per ID, set if the ID is available.
+*              Each upper level has a bit per word of the level below, set if that word has any available ID.
+*              Finding the lowest available ID is a find-first-set per level from the top level down,
+*              so acquiring and releasing IDs cost O(log64(IDs)) steps, constant in practice, not O(IDs).
+*              Thread-safe, access is secured by its own "ids_mutex" mutex, held only for the few bitmap steps.
+************************************************************************************************************************/
+class ids_allocator
+{
+private:
+    std::mutex ids_mutex;   //mutex to protect the bitmap levels
+    std::vector<std::vector<std::uint64_t>> levels; //bitmap levels, levels[0] has a bit per ID, last level is a single word
+public:
+    ids_allocator(void) = default;
+    void reset(std::size_t);    //make IDs 1..N available
+    int acquire(void);  //take the lowest available ID, 0 if no ID is available
+    void release(int);  //make an acquired ID available again
+    void clear(void);   //remove all IDs
+};
+/************************************************************************************************************************
+* Class Name: sessions_directory
+* Purpose: Concurrent directory of sessions handlers by their IDs
+* Abstract/Concrete: Concrete
+* #Instances: One instance per server
+* Exception Expected: No
+* Inherited Classes: NONE
+* Constructors:
+*               1- Default Non-parameterized constructor, empty directory - public
+*
+* Description: Sessions handlers are spread over a fixed number of shards by their IDs, each shard is a hash map
+*              secured by its own shared mutex and aligned to a cache line not to share it with other shards.
+*              Lookups take a shared lock on the ID's shard only, so lookups of any sessions run in parallel and
+*              only sessions creation and closure of IDs in the same shard take an exclusive lock.
+*              Found handlers are returned as shared_ptr, the session is kept alive while the caller uses it.
+************************************************************************************************************************/
+class sessions_directory
+{
+private:
+    static constexpr std::size_t shards_num = 64;   //number of shards, IDs are given lowest first so "ID % shards_num" is balanced
+    struct alignas(64) directory_shard
+    {
+        mutable std::shared_mutex shard_mutex;  //shared for lookups, exclusive for insertion and erasure
+        std::unordered_map<int,session_hndl> sessions;  //sessions handlers of the shard
+    };
+    std::array<directory_shard,shards_num> shards;
+    directory_shard& shard_of(int id) {return shards[static_cast<std::size_t>(id) % shards_num];}
+    const directory_shard& shard_of(int id) const {return shards[static_cast<std::size_t>(id) % shards_num];}
+public:
+    sessions_directory(void) = default;
+    void insert(int, session_hndl); //add session handler with its ID
+    void erase(int);    //remove session handler by its ID
+    std::shared_ptr<session_abstract> find(int) const;  //get session by its ID, nullptr if not found or closed
+    std::vector<int> ids(void) const;   //snapshot of all IDs in the directory
+    void clear(void);   //remove all sessions handlers
+};
+/************************************************************************************************************************
+* Class Name: topics_directory
+* Purpose: Index of the sessions subscribed to named topics
+* Abstract/Concrete: Concrete
+* #Instances: One instance per server
+* Exception Expected: No
+* Inherited Classes: NONE
+* Constructors:
+*               1- Default Non-parameterized constructor, no topics - public
+*
+* Description: Sessions IDs are indexed by topic for publishing, and topics are indexed by session ID to remove
+*              a closed session from all its topics without scanning them. Both indexes are secured by one shared
+*              mutex, publishing takes it shared and only subscriptions updates take it exclusive.
+*              A topic is removed with its last subscriber.
+************************************************************************************************************************/
+class topics_directory
+{
+private:
+    mutable std::shared_mutex topics_mutex; //shared for publishing, exclusive for subscriptions updates
+    std::unordered_map<std::string,std::unordered_set<int>> subscribers;    //sessions IDs subscribed to each topic
+    std::unordered_map<int,std::unordered_set<std::string>> subscriptions;  //topics subscribed by each session ID
+public:
+    topics_directory(void) = default;
+    bool subscribe(int, const std::string&, const sessions_directory&); //add session to topic if it is running
+    bool unsubscribe(int, const std::string&);  //remove session from topic
+    void remove(int);   //remove session from all its topics
+    std::vector<int> subscribers_of(const std::string&) const;  //snapshot of the topic subscribers IDs
+    void clear(void);   //remove all topics
+};
+/************************************************************************************************************************
+* Class Name: buffer_pool
+* Purpose: Free lists of messages buffers for reuse across reads and writes
+* Abstract/Concrete: Concrete
+* #Instances: One instance per io shard of a server, one for all sessions when not sharded
+* Exception Expected: No
+* Inherited Classes: NONE
+* Constructors:
+*               1- Constructor that accepts the cap of retained memory in bytes - public
+*
+* Description: Buffers are "std::vector<unsigned char>" kept in size classes of powers of 2, from 256 bytes to 4MB.
+*              A buffer is taken from the smallest class fitting the requested size and is given back to the
+*              largest class its capacity fits, so a taken buffer always has the requested capacity.
+*              Given back buffers are freed once the retained capacity would exceed the cap, as are buffers
+*              smaller or larger than the classes. Free lists are secured by one mutex per pool, each shard
+*              has its own pool. Hits and misses of the taken buffers are counted.
+************************************************************************************************************************/
+class buffer_pool
+{
+private:
+    static constexpr std::size_t min_class_bits = 8;    //smallest size class, 256 bytes
+    static constexpr std::size_t classes_num = 15;  //size classes up to 4MB, larger buffers are not pooled
+    static constexpr std::size_t classes_span = 2;  //larger classes tried when the fitting class is empty
+    std::mutex pool_mutex;  //mutex to protect the free lists and "retained_bytes"
+    std::array<std::vector<std::vector<unsigned char>>,classes_num> free_lists;   //free buffers of each size class
+    std::size_t retained_bytes = 0; //capacity of the free buffers
+    std::size_t max_retained;   //cap of the retained capacity
+    std::atomic<std::size_t> hits = 0;  //taken buffers found in the free lists
+    std::atomic<std::size_t> misses = 0;    //taken buffers allocated
+public:
+    buffer_pool(void) = delete; //deleted default non-parameterized constructor
+    explicit buffer_pool(std::size_t limit) : max_retained(limit) {}
+    std::vector<unsigned char> acquire(std::size_t);    //take empty buffer with capacity of at least the given size
+    void release(std::vector<unsigned char>&&); //give buffer back for reuse
+    buffer_pool_stats stats(void);  //counters and retained capacity
+    static shared_payload make_payload(const std::shared_ptr<buffer_pool>&, const std::vector<unsigned char>&);    //copy message into pooled payload
+};
+/************************************************************************************************************************
 * Class Name: server_abstract
 * Purpose: Abstract base class for furher derived classes
 * Abstract/Concrete: Abstract
@@ -117,37 +329,132 @@ protected:
     bool secure; //boolean to understand if the server is secured or not
     bool started_once = false;  //boolean to check if the server already started once or not
     unsigned short server_port; //opened port for the server
-    //8 mutuxes for 8 functions to prevent racing from different threads to the same single instance
+    //2 mutuxes for start and stop functions, sessions functions only lock the sessions directory shard of the session
     std::mutex start_mutex;     //mutex for start function
     std::mutex stop_mutex;         //mutex for stop function
-    std::mutex send_message_mutex;   //mutex for send message
-    std::mutex read_message_mutex;   //mutex for read message
-    std::mutex check_inbox_mutex;   //mutex for check inbox
-    std::mutex session_check_mutex; //mutex for check_session function
-    std::mutex session_close_mutex;   //mutex to prevent deadlock of calling close sessions inside stop function
-    std::mutex session_establishment_mutex; //Mutex to prevent racing when creating new sessions
-    std::mutex g_sessions;   //mutex to protect shared access to map of IDs and sessions
     std::size_t max_sessions;   //max allowed sessions num
     std::atomic<std::size_t> session_count = 0; //counter for sessions running
     std::atomic<bool> server_running = false;   //boolean to show if server is running or not
-    std::unordered_set<int> sessions_ids;   //to track available IDs for sessions
-    std::unordered_map<int,session_hndl> sessions;  //hash map for all sessions to control
+    ids_allocator sessions_ids; //to track available IDs for sessions, gives the lowest available ID
+    sessions_directory sessions;    //directory of all sessions to control
+    topics_directory topics;    //sessions subscriptions to topics, for publishing
+    session_callbacks callbacks;    //user callbacks set by the user, applied at next start
+    std::shared_ptr<const session_callbacks> active_callbacks;  //user callbacks shared with the sessions since last start
+    inbox_limits inbox_marks;   //sessions inbox water marks set by the user, applied at next start
+    inbox_limits active_inbox_marks;    //sessions inbox water marks since last start
+    outbox_limits outbox_marks; //sessions outbox limits set by the user, applied at next start
+    outbox_limits active_outbox_marks;  //sessions outbox limits since last start
+    deflate_options compression;    //sessions permessage-deflate options set by the user, applied at next start
+    deflate_options active_compression; //sessions permessage-deflate options since last start
+    frame_options framing;  //sessions frames type and validation set by the user, applied at next start
+    frame_options active_framing;   //sessions frames type and validation since last start
+    tls_counters handshakes;    //full and resumed TLS handshakes of secure sessions, since the server creation
 protected:
     server_abstract(void) = delete; //deleted default non-parameterized constructor
     explicit server_abstract(std::size_t limit,unsigned short port,bool type) : max_sessions(limit), secure(type), server_port(port) {}
     virtual ~server_abstract(void) = default;
     virtual void accept_connection(void) = 0;
+    virtual void wait_message(int, message_handler) = 0;    //read message of session from queue, or wait for the next one
+    virtual void send_message(int, const std::vector<unsigned char>&, sent_handler) = 0;   //send message for session, handler is called once written
+    virtual void send_stream(int, stream_source, sent_handler) = 0; //send streamed message for session, handler is called once written
+    virtual void send_file(int, const std::string&, std::size_t, std::size_t, sent_handler) = 0;    //send file range for session, handler is called once written
 public:
     virtual void start(void) = 0;   //start server
     virtual void stop(void) = 0;    //stop server
     virtual bool is_serving(void) = 0;  //check if server is serving clients or not
     virtual bool is_running(void) = 0;  //check if server is running or not
     virtual int sessions_count(void) = 0;   //count number of running sessions
-    virtual bool send_message(int, const std::vector<unsigned char>&) = 0;  //send message for session, add to queue
+    virtual void set_io_threads(std::size_t) = 0;   //set number of worker threads running the server, applied at next start
+    virtual void set_io_sharding(bool) = 0; //set one io_context per worker thread, applied at next start
+    virtual void set_reuse_port(bool) = 0;  //set one SO_REUSEPORT acceptor per io shard, applied at next start
+    virtual void set_accept_concurrency(std::size_t) = 0;   //set number of outstanding accepts, applied at next start
+    virtual void set_listen_backlog(int) = 0;   //set acceptor listen backlog, applied at next start
+    virtual void set_buffer_pool_limit(std::size_t) = 0;    //set cap of retained memory by the buffers pools, applied at next start
+    virtual buffer_pool_stats pool_stats(void) = 0; //buffers pools counters of the running server
+    virtual void set_on_open(std::function<void(int)>) = 0;  //set callback of sessions opening, applied at next start
+    virtual void set_on_message(std::function<void(int,std::vector<unsigned char>&&)>) = 0;  //set callback of received messages instead of inbox, applied at next start
+    virtual void set_on_close(std::function<void(int)>) = 0; //set callback of sessions closure, applied at next start
+    virtual void set_on_chunk(std::function<void(int,const unsigned char*,std::size_t,bool)>) = 0; //set callback of received chunks instead of messages, applied at next start
+    virtual void set_inbox_limits(const inbox_limits&) = 0; //set water marks of sessions inbox, applied at next start
+    virtual inbox_stats inbox_depth(int) = 0;   //depth of session inbox
+    virtual void set_outbox_limits(const outbox_limits&) = 0;   //set limits and overflow policy of sessions outbox, applied at next start
+    virtual bool set_compression(const deflate_options&) = 0;   //set permessage-deflate options of sessions, applied at next start
+    virtual void set_frame_options(const frame_options&) = 0;   //set frames type of sessions and their text validation, applied at next start
+    virtual send_status send_message(int, const std::vector<unsigned char>&) = 0;  //send message for session, add to queue
+    virtual send_status send_messages(int, const std::vector<std::vector<unsigned char>>&) = 0; //send batch of messages for session, add to queue at once
+    virtual send_status send_file(int, const std::string&, std::size_t = 0, std::size_t = 0) = 0;  //send file range for session from its mapping, add to queue
+    virtual int broadcast(const std::vector<unsigned char>&) = 0;    //send one shared message to all sessions, add to their queues
+    virtual int send_to(const std::vector<int>&, const std::vector<unsigned char>&) = 0; //send one shared message to a list of sessions
+    virtual bool subscribe(int, const std::string&) = 0;    //subscribe session to a topic
+    virtual bool unsubscribe(int, const std::string&) = 0;  //unsubscribe session from a topic
+    virtual int publish(const std::string&, const std::vector<unsigned char>&) = 0; //send one shared message to the topic subscribers
     virtual std::vector<unsigned char> read_message(int) = 0;   //read message for session, get from queue
+    /*====================== Shared messages, their bytes are never copied, vector functions above copy them once ====*/
+    virtual send_status send_message(int, const ws_message&) = 0;  //send shared message for session, add to queue
+    virtual send_status send_messages(int, const std::vector<ws_message>&) = 0;    //send batch of shared messages for session, add to queue at once
+    virtual int broadcast(const ws_message&) = 0;   //send shared message to all sessions, add to their queues
+    virtual int send_to(const std::vector<int>&, const ws_message&) = 0;    //send shared message to a list of sessions
+    virtual int publish(const std::string&, const ws_message&) = 0; //send shared message to the topic subscribers
+    virtual ws_message read_shared_message(int) = 0;    //read message for session as shared message, get from queue
     virtual bool check_inbox(int) = 0;  //check session inbox of a session
     virtual bool check_session(int) = 0;//check if a specific session is running
+    virtual tls_stats handshake_stats(void) = 0;    //full and resumed TLS handshakes of secure sessions
     virtual void close_session(int) = 0;//close specific session
+    /*====================== Asynchronous operations, for any completion token such as "net::use_awaitable" =========*/
+    template<typename CompletionToken>
+    auto async_read_message(int id, CompletionToken&& token)   //completion: void(error_code, std::vector<unsigned char>)
+    {
+        return net::async_initiate<CompletionToken,void(boost::system::error_code,std::vector<unsigned char>)>([this](auto handler,int session_id)
+        {
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            auto handler_executor = net::get_associated_executor(*shared_handler);
+            this->wait_message(session_id,[shared_handler,handler_executor](boost::system::error_code errcode,std::vector<unsigned char> message)
+            {
+                net::post(handler_executor,[shared_handler,errcode,message = std::move(message)]() mutable
+                    {(*shared_handler)(errcode,std::move(message));});
+            });
+        },token,id);
+    }
+    template<typename CompletionToken>
+    auto async_send_message(int id, const std::vector<unsigned char>& message, CompletionToken&& token)   //completion: void(error_code)
+    {
+        return net::async_initiate<CompletionToken,void(boost::system::error_code)>([this](auto handler,int session_id,const std::vector<unsigned char>& msg)
+        {
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            auto handler_executor = net::get_associated_executor(*shared_handler);
+            this->send_message(session_id,msg,[shared_handler,handler_executor](boost::system::error_code errcode)
+            {
+                net::post(handler_executor,[shared_handler,errcode](){(*shared_handler)(errcode);});
+            });
+        },token,id,message);
+    }
+    template<typename CompletionToken>
+    auto async_send_stream(int id, stream_source source, CompletionToken&& token)   //completion: void(error_code)
+    {
+        return net::async_initiate<CompletionToken,void(boost::system::error_code)>([this](auto handler,int session_id,stream_source message_source)
+        {
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            auto handler_executor = net::get_associated_executor(*shared_handler);
+            this->send_stream(session_id,std::move(message_source),[shared_handler,handler_executor](boost::system::error_code errcode)
+            {
+                net::post(handler_executor,[shared_handler,errcode](){(*shared_handler)(errcode);});
+            });
+        },token,id,std::move(source));
+    }
+    template<typename CompletionToken>
+    auto async_send_file(int id, const std::string& path, std::size_t offset, std::size_t length, CompletionToken&& token)   //completion: void(error_code)
+    {
+        return net::async_initiate<CompletionToken,void(boost::system::error_code)>([this](auto handler,int session_id,
+            const std::string& file_path,std::size_t file_offset,std::size_t file_length)
+        {
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            auto handler_executor = net::get_associated_executor(*shared_handler);
+            this->send_file(session_id,file_path,file_offset,file_length,[shared_handler,handler_executor](boost::system::error_code errcode)
+            {
+                net::post(handler_executor,[shared_handler,errcode](){(*shared_handler)(errcode);});
+            });
+        },token,id,path,offset,length);
+    }
 };
 /************************************************************************************************************************
 * Class Name: ws_server_base
@@ -180,9 +487,20 @@ class ws_server_base : public server_abstract
 {
 protected:
     ssl::context* ssl_ctx; //SSL context shared_ptr passed to sessions by reference
-    std::unique_ptr<net::io_context> io_ctx;
+    std::unique_ptr<net::io_context> io_ctx;    //main io_context, runs the acceptor and the sessions when not sharded
     tcp::acceptor tcp_acceptor; //TCP acceptor for connections accpeting
     std::unique_ptr<net::thread_pool> threads_pool; //Pool of threads to run server and sessions, unique pointer
+    std::size_t io_threads = 0; //number of worker threads running "io_ctx", 0 means number of cores, independent of "max_sessions"
+    bool io_sharding = false;   //boolean to run each session on one of "io_shards" contexts instead of the shared "io_ctx"
+    std::vector<std::unique_ptr<net::io_context>> io_shards;    //one io_context per worker thread, used in sharded mode only
+    std::unique_ptr<std::atomic<std::size_t>[]> shards_load;    //number of sessions running on each shard
+    std::vector<std::shared_ptr<buffer_pool>> buffer_pools; //messages buffers pools, one per io shard or one when not sharded
+    std::size_t buffer_pool_limit = 64*1024*1024;   //cap of retained memory by all buffers pools, split between them
+    std::atomic<std::size_t> next_shard = 0;    //round-robin start point when choosing the least-loaded shard
+    bool reuse_port = false;    //boolean to open one SO_REUSEPORT acceptor per io shard in sharded mode
+    std::vector<tcp::acceptor> shard_acceptors; //acceptors of io shards, used in SO_REUSEPORT mode only
+    std::size_t accept_concurrency = 0; //number of outstanding accepts, 0 means number of worker threads
+    int listen_backlog = net::socket_base::max_listen_connections;  //acceptor listen backlog
     bool verification_on;   //boolean variable to check whether the instance is not that secured by verification, used by "wss_server"
 protected:
     ws_server_base(void) = delete;  //deleted default non-parameterized constructor
@@ -196,16 +514,54 @@ protected:
         tcp_acceptor(*io_ctx,tcp::endpoint(tcp::v4(),port)), verification_on(vrf) {tcp_acceptor.cancel(); tcp_acceptor.close();}
     virtual ~ws_server_base(void) = default;
     void accept_connection(void) override;
+    void accept_shard_connection(std::size_t);
+    void create_session(tcp::socket&&,net::io_context&,std::size_t);
+    void close_acceptor(tcp::acceptor&);
+    std::size_t select_shard(void);
+    void wait_message(int, message_handler) override;
+    void send_message(int, const std::vector<unsigned char>&, sent_handler) override;
+    void send_stream(int, stream_source, sent_handler) override;
+    void send_file(int, const std::string&, std::size_t, std::size_t, sent_handler) override;
 public:
     void start(void) override;
     void stop(void) override;
     bool is_serving(void) override;
     bool is_running(void) override;
     int sessions_count(void) override;
-    bool send_message(int, const std::vector<unsigned char>&) override;
+    void set_io_threads(std::size_t) override;
+    void set_io_sharding(bool) override;
+    void set_reuse_port(bool) override;
+    void set_accept_concurrency(std::size_t) override;
+    void set_listen_backlog(int) override;
+    void set_buffer_pool_limit(std::size_t) override;
+    buffer_pool_stats pool_stats(void) override;
+    void set_on_open(std::function<void(int)>) override;
+    void set_on_message(std::function<void(int,std::vector<unsigned char>&&)>) override;
+    void set_on_close(std::function<void(int)>) override;
+    void set_on_chunk(std::function<void(int,const unsigned char*,std::size_t,bool)>) override;
+    void set_inbox_limits(const inbox_limits&) override;
+    inbox_stats inbox_depth(int) override;
+    void set_outbox_limits(const outbox_limits&) override;
+    bool set_compression(const deflate_options&) override;
+    void set_frame_options(const frame_options&) override;
+    send_status send_message(int, const std::vector<unsigned char>&) override;
+    send_status send_messages(int, const std::vector<std::vector<unsigned char>>&) override;
+    send_status send_file(int, const std::string&, std::size_t = 0, std::size_t = 0) override;
+    int broadcast(const std::vector<unsigned char>&) override;
+    int send_to(const std::vector<int>&, const std::vector<unsigned char>&) override;
+    bool subscribe(int, const std::string&) override;
+    bool unsubscribe(int, const std::string&) override;
+    int publish(const std::string&, const std::vector<unsigned char>&) override;
     std::vector<unsigned char> read_message(int) override;
+    send_status send_message(int, const ws_message&) override;
+    send_status send_messages(int, const std::vector<ws_message>&) override;
+    int broadcast(const ws_message&) override;
+    int send_to(const std::vector<int>&, const ws_message&) override;
+    int publish(const std::string&, const ws_message&) override;
+    ws_message read_shared_message(int) override;
     bool check_inbox(int) override;
     bool check_session(int) override;
+    tls_stats handshake_stats(void) override;
     void close_session(int) override;
 };
 /************************************************************************************************************************
@@ -302,11 +658,18 @@ protected:
     wss_server(void) = delete;  //deleted default non-parameterized constructor
     explicit wss_server(unsigned short port, std::size_t sessions_num,
                         const std::string key_file, const std::string certificate_file, const std::string CA_cert_file)
-        : ws_server_base(ssl_ctx,port,sessions_num,true) {Set_SSL_CTX(ssl_ctx,key_file,certificate_file,CA_cert_file);}
+        : ws_server_base(ssl_ctx,port,sessions_num,true), key(key_file), certificate(certificate_file), CA_certificate(CA_cert_file)
+    {
+        Set_SSL_CTX(ssl_ctx,key_file,certificate_file,CA_cert_file);
+        Set_Session_Resumption(ssl_ctx,true);   //session tickets and cache for reconnecting clients
+    }
     explicit wss_server(unsigned short port, std::size_t sessions_num,
                         const std::string key_file)
-        : ws_server_base(ssl_ctx,port,sessions_num,false)
-    {Set_SSL_CTX(ssl_ctx,key_file);}
+        : ws_server_base(ssl_ctx,port,sessions_num,false), key(key_file)
+    {
+        Set_SSL_CTX(ssl_ctx,key_file);
+        Set_Session_Resumption(ssl_ctx,true);   //session tickets and cache for reconnecting clients
+    }
     ~wss_server(void) = default;
 public:
     wss_server(const wss_server&) = delete; //delete copy constructor
@@ -316,9 +679,6 @@ public:
         const std::string certificate,const std::string CA_certificate)//create the instance function
     {
         std::lock_guard<std::mutex> lock(access_mutex);
-        this->key = key;
-        this->certificate = certificate;
-        this->CA_certificate = CA_certificate;
         if(server_instance == nullptr)
             server_instance = new wss_server(port,sessions_num,key,certificate,CA_certificate);
         return server_instance;
@@ -326,7 +686,6 @@ public:
     inline static wss_server* GetInstance(unsigned short port, std::size_t sessions_num,const std::string key)//create the instance function
     {
         std::lock_guard<std::mutex> lock(access_mutex2);
-        this->key = key;
         if(server_instance2 == nullptr)
             server_instance2 = new wss_server(port,sessions_num,key);
         return server_instance2;
@@ -376,16 +735,35 @@ protected:
     std::mutex read_mutex;  //mutex to prevent racing for "read_messages_queue"
     std::mutex send_mutex;  //mutex to prevent racing for "send_messages_queue"
     std::deque<std::vector<unsigned char>> read_messages_queue;  //queue to store messages to read
-    std::deque<std::vector<unsigned char>> send_messages_queue;  //queue to store messages to send
-    std::mutex& g_sessions;   //reference to the mutex to protect shared access to map of IDs and sessions
+    std::size_t inbox_bytes = 0;    //bytes of "read_messages_queue" messages, secured by "read_mutex"
+    bool read_paused = false;   //no read is issued as the inbox reached its high water mark, secured by "read_mutex"
+    inbox_limits inbox_marks;   //water marks of "read_messages_queue", set by server
+    std::shared_ptr<session_abstract> paused_owner; //keeps the session alive while reading is paused, secured by "read_mutex"
+    std::deque<shared_payload> send_messages_queue;  //queue to store messages to send, payloads may be shared with other sessions
+    std::deque<message_handler> read_waiters;   //pending asynchronous reads waiting for messages, secured by "read_mutex"
+    std::deque<sent_handler> sent_handlers;     //completions of "send_messages_queue" messages, secured by "send_mutex"
+    bool write_in_progress = false; //a write is in flight and its handler writes the next message, secured by "send_mutex"
+    std::size_t outbox_bytes = 0;   //bytes of "send_messages_queue" messages, secured by "send_mutex"
+    outbox_limits outbox_marks; //limits of "send_messages_queue", set by server
+    std::condition_variable outbox_space;   //notified when messages leave "send_messages_queue", for "block" policy
+    std::deque<fragment_source> stream_sources;   //sources of the streamed messages queued as "stream_marker", secured by "send_mutex"
+    deflate_options compression;    //permessage-deflate options accepted at the handshake, set by server
+    frame_options framing;  //frames type of sent messages and text validation, set by server
+    tls_counters* handshakes = nullptr; //TLS handshakes counters of the server, set by server
+    bool waiters_closed = false;    //boolean set at session closure, no more asynchronous operations are accepted
     std::atomic<std::size_t>& session_count; //reference to session_count to decrement it after session close
-    std::unordered_set<int>& sessions_ids;  //reference to IDs set of the server to safely release the id
-    std::unordered_map<int,session_hndl>& sessions; //reference to sessions map to safely release the session resources
+    ids_allocator& sessions_ids;    //reference to IDs allocator of the server to safely release the id
+    sessions_directory& sessions; //reference to sessions directory to safely release the session resources
+    std::atomic<std::size_t>* shard_load = nullptr; //sessions counter of the io shard running the session, set by server in sharded mode
+    topics_directory* topics = nullptr; //topics index of the server to unsubscribe the session at closure, set by server
+    std::shared_ptr<buffer_pool> pool;  //buffers pool of the session's io shard, set by server
+    std::shared_ptr<const session_callbacks> callbacks; //user callbacks of the server, set by server
+    std::atomic<bool> opened = false;   //boolean set after "on_open" call, "on_close" is called only for opened sessions
 protected:
     session_abstract(void) = delete;    //deleted default non-parameterized constructor
     explicit session_abstract(int id,std::atomic<std::size_t>& sessions_counter,
-        std::unordered_set<int>& ids_set,std::unordered_map<int,session_hndl>& sessions_map, std::mutex& gmtx)
-        : session_id(id), session_count(sessions_counter), sessions_ids(ids_set), sessions(sessions_map), g_sessions(gmtx) {}
+        ids_allocator& ids_set,sessions_directory& sessions_dir)
+        : session_id(id), session_count(sessions_counter), sessions_ids(ids_set), sessions(sessions_dir) {}
     virtual ~session_abstract(void) = default;
     virtual void stop(int) = 0;   //for ungracefull disconnection
     virtual void receive_message(void) = 0; //receive messages asynchronously
@@ -393,11 +771,21 @@ protected:
     virtual void start(void) = 0;   //to start session connection by server
     virtual void stop(void) = 0;    //for gracefull disconnection
     virtual std::vector<unsigned char> read_message(void) = 0;  //read messages, add to queue
-    virtual void send_message(const std::vector<unsigned char>&) =0; //send messages, get from queue
+    virtual send_status send_message(const std::vector<unsigned char>&) =0; //send messages, get from queue
+    virtual send_status send_payload(shared_payload, bool) = 0;  //add shared message to the queue without copying, and give the write order
+    virtual send_status send_payloads(std::vector<shared_payload>&&) = 0;  //add batch of shared messages to the queue at once, and give the write order
+    virtual void drop_connection(void) = 0; //close the connection of a slow consumer
+    virtual void wait_message(message_handler) = 0; //read message from queue, or wait for the next one
+    virtual void send_message(const std::vector<unsigned char>&, sent_handler) = 0;  //send message, handler is called once written
+    virtual send_status send_stream(fragment_source, sent_handler) = 0; //send streamed message in fragments, handler is called once written
     virtual bool check_inbox(void) = 0;  //check session inbox
+    virtual inbox_stats inbox_depth(void) = 0;  //depth of session inbox
     virtual bool check_session(void) = 0;//check if session is running
+    virtual bool wait_handshake(void) = 0;  //wait for the handshake handler if its response is being written
+    virtual void abort_handshake(void) = 0; //cancel the pending handshake of a session not established yet
 public:
     friend class ws_server_base;    //friend class to access private/protected members
+    friend class topics_directory;  //friend class to check the session at subscription
 };
 /************************************************************************************************************************
 * Class Name: ws_session_base
@@ -412,9 +800,8 @@ public:
 *                   Inputs:
 *                       - Session ID
 *                       - Reference to sessions counter
-*                       - Reference to IDs set
-*                       - Reference to sessions map container
-*                       - Reference to shared mutex with the server
+*                       - Reference to IDs allocator
+*                       - Reference to sessions directory
 *                       - io_context reference
 *                    # All refernces are used for resources release by the session object after session closure.
 * Description: Base class for derived classes for WebSocket and WebSocket secure.
@@ -427,20 +814,60 @@ class ws_session_base : public session_abstract
 protected:
     net::io_context& io_ctx;    //reference to the io_context
     net::strand<net::io_context::executor_type> strand; //strand to manage handlers running on many threads sequentially
+    net::steady_timer handshake_timer;  //deadline of the session handshake, cancels the connection if it expires
+    std::promise<void> handshake_promise;   //set once the session handshake succeeds or fails
+    std::shared_future<void> handshake_settled; //to wait for "handshake_promise"
+    std::atomic<bool> handshake_done = false;   //boolean to set "handshake_promise" only once
+    std::atomic<bool> handshake_responding = false; //the upgrade request is accepted and its response is being written
+    std::vector<unsigned char> read_data;   //bytes of the message being received, moved to the application at its end
+    std::optional<received_buffer> read_buffer; //dynamic buffer over "read_data", the stream reads into it
+    std::size_t read_size_hint = 0; //size of the last received message, to take a fitting buffer from the pool
+    std::vector<unsigned char> read_chunk;  //chunk of the message being received, with "on_chunk" callback
+    fragment_source writing_source; //source of the streamed message being written, used on the session's strand only
+    sent_handler writing_handler;   //completion of the streamed message being written
+    static constexpr std::size_t stream_chunk_size = 64*1024;   //size of streamed chunks and fragments, memory used per session
+    std::vector<shared_payload> writing_batch;  //small queued messages being written together by one gathered write
+    std::vector<sent_handler> writing_batch_handlers;   //completions of "writing_batch" messages
+    static constexpr std::size_t gather_size = 64*1024; //most bytes of small queued messages written together
 protected:
     ws_session_base(void) = delete; //deleted default non-parameterized constructor
-    explicit ws_session_base(int id,std::atomic<std::size_t>& sessions_counter,std::unordered_set<int>& ids_set,
-        std::unordered_map<int,session_hndl>& sessions_map,std::mutex& gmtx,net::io_context& context)
-        : session_abstract(id,sessions_counter,ids_set,sessions_map,gmtx), io_ctx(context), strand(context.get_executor()){}
+    explicit ws_session_base(int id,std::atomic<std::size_t>& sessions_counter,ids_allocator& ids_set,
+        sessions_directory& sessions_dir,net::io_context& context)
+        : session_abstract(id,sessions_counter,ids_set,sessions_dir), io_ctx(context), strand(context.get_executor()),
+        handshake_timer(strand), handshake_settled(handshake_promise.get_future().share()) {}
     virtual ~ws_session_base(void) = default;
+    void release(void);
+    void notify_open(void);
+    bool notify_message(std::vector<unsigned char>&&);
+    void notify_close(void);
+    void notify_chunk(const unsigned char*, std::size_t, bool);
+    bool next_fragment(net::const_buffer&);
+    bool deliver_message(std::vector<unsigned char>&&, const std::shared_ptr<session_abstract>&);
+    std::shared_ptr<session_abstract> pop_message(std::vector<unsigned char>&);
+    send_status admit_message(std::unique_lock<std::mutex>&, std::size_t, std::deque<sent_handler>&);
+    void settle_admission(send_status, std::deque<sent_handler>&);
+    bool valid_text(const std::vector<unsigned char>&) const;
+    static const shared_payload& stream_marker(void);
+    bool take_message(shared_payload&, sent_handler&);
+    bool take_batch(shared_payload&, sent_handler&);
+    void settle_batch(boost::system::error_code);
+    void abort_waiters(void);
+    void settle_handshake(void);
+    bool wait_handshake(void) override;
     virtual void receive_message(void) = 0;
     virtual void write_message(void) = 0;
     virtual void stop(int) = 0;
     virtual void start(void) = 0;
     virtual void stop(void) = 0;
     std::vector<unsigned char> read_message(void) override;
-    void send_message(const std::vector<unsigned char>&) override;
+    send_status send_message(const std::vector<unsigned char>&) override;
+    send_status send_payload(shared_payload, bool) override;
+    send_status send_payloads(std::vector<shared_payload>&&) override;
+    void wait_message(message_handler) override;
+    void send_message(const std::vector<unsigned char>&, sent_handler) override;
+    send_status send_stream(fragment_source, sent_handler) override;
     bool check_inbox(void) override;
+    inbox_stats inbox_depth(void) override;
     bool check_session(void) override;
 public:
      friend class ws_server_base;    //friend class to access private/protected members
@@ -458,9 +885,8 @@ public:
 *                   Inputs:
 *                       - Session ID
 *                       - Reference to sessions counter
-*                       - Reference to IDs set
-*                       - Reference to sessions map container
-*                       - Reference to shared mutex with the server
+*                       - Reference to IDs allocator
+*                       - Reference to sessions directory
 *                       - io_context reference
 *                       - session connection socket
 *                    # All refernces are used for resources release by the session object after session closure.
@@ -478,15 +904,20 @@ private:
     ws_stream stream;   //I/O stream
 protected:
     void stop(int) override;
+    void abort_handshake(void) override;
+    void fail_handshake(void);
     void receive_message(void) override;
     void write_message(void) override;
+    void write_stream(void);
+    void write_gathered(std::size_t);
     void start(void) override;
     void stop(void) override;
+    void drop_connection(void) override;
 public:
     ws_session(void) = delete;  //deleted default non-parameterized constructor
-    explicit ws_session(int id,std::atomic<std::size_t>& sessions_counter,std::unordered_set<int>& ids_set,
-        std::unordered_map<int,session_hndl>& sessions_map,std::mutex& gmtx,net::io_context& context,tcp::socket&& socket)
-        : ws_session_base(id,sessions_counter,ids_set,sessions_map,gmtx,context), stream(std::move(socket)) {}
+    explicit ws_session(int id,std::atomic<std::size_t>& sessions_counter,ids_allocator& ids_set,
+        sessions_directory& sessions_dir,net::io_context& context,tcp::socket&& socket)
+        : ws_session_base(id,sessions_counter,ids_set,sessions_dir,context), stream(std::move(socket)) {}
     ~ws_session(void) = default;
 public:
     friend class ws_server_base;    //friend class to access private/protected members
@@ -505,9 +936,8 @@ public:
 *                   Inputs:
 *                       - Session ID
 *                       - Reference to sessions counter
-*                       - Reference to IDs set
-*                       - Reference to sessions map container
-*                       - Reference to shared mutex with the server
+*                       - Reference to IDs allocator
+*                       - Reference to sessions directory
 *                       - io_context reference
 *                       - session connection socket
 *                       - server's ssl_context by reference
@@ -526,15 +956,20 @@ private:
     wss_stream stream;  //I/O secured stream
 protected:
     void stop(int) override;
+    void abort_handshake(void) override;
+    void fail_handshake(void);
     void receive_message(void) override;
     void write_message(void) override;
+    void write_stream(void);
+    void write_gathered(std::size_t);
     void start(void) override;
     void stop(void) override;
+    void drop_connection(void) override;
 public:
     wss_session(void) = delete;  //deleted default non-parameterized constructor
-    explicit wss_session(int id,std::atomic<std::size_t>& sessions_counter,std::unordered_set<int>& ids_set,
-        std::unordered_map<int,session_hndl>& sessions_map,std::mutex& gmtx,net::io_context& context,tcp::socket&& socket,ssl::context& ssl_ctx)
-        : ws_session_base(id,sessions_counter,ids_set,sessions_map,gmtx,context), stream(std::move(socket),ssl_ctx) {}
+    explicit wss_session(int id,std::atomic<std::size_t>& sessions_counter,ids_allocator& ids_set,
+        sessions_directory& sessions_dir,net::io_context& context,tcp::socket&& socket,ssl::context& ssl_ctx)
+        : ws_session_base(id,sessions_counter,ids_set,sessions_dir,context), stream(std::move(socket),ssl_ctx) {}
     ~wss_session(void) = default;
 public:
     friend class ws_server_base;    //friend class to access private/protected members
@@ -0,0 +1,88 @@
+/************************************************************************************************************************
+ * 	Module: WebSocket Message
+ * 	File Name: ws_message.h
+ *  Authors: Ahmed Desoky
+ *	Date: 19/1/2025
+ *	*********************************************************************************************************************
+ *	Description: This file includes the message type shared by the server, its sessions and the client.
+ *               A message is an immutable bytes buffer held by a reference counted pointer, so copying a message
+ *               copies the pointer only. The same message can be queued to many sessions, kept by the application
+ *               and written again without copying its bytes. The bytes are freed when the last copy is released.
+ *               It includes as well the frame options, the frames type messages are sent in and their validation.
+ ***********************************************************************************************************************/
+#pragma once
+/************************************************************************************************************************
+ *                     							   INCLUDES
+ ***********************************************************************************************************************/
+#include <memory>
+#include <vector>
+#include <string>
+/***********************************************************************************************************************
+ *                                                  ALIASES
+ ***********************************************************************************************************************/
+using shared_payload = std::shared_ptr<const std::vector<unsigned char>>;  //immutable bytes, shared by all copies of a message
+/***********************************************************************************************************************
+ *                                                  ENUMS
+ ***********************************************************************************************************************/
+enum class frame_mode   //websocket frames type of sent messages
+{
+    text,   //text frames, the payload must be valid UTF-8, read as strings by browsers
+    binary  //binary frames, any payload
+};
+/***********************************************************************************************************************
+ *                                                  STRUCTS
+ ***********************************************************************************************************************/
+struct frame_options    //frames type of a connection and its text validation
+{
+    frame_mode mode = frame_mode::text; //type of the frames of all sent messages
+    bool validate_utf8 = false; //text mode only, refuse sending and receiving messages that are not valid UTF-8
+};
+/***********************************************************************************************************************
+ *                                                  CLASSES
+ ***********************************************************************************************************************/
+/************************************************************************************************************************
+* Class Name: ws_message
+* Purpose: Cheap to copy, reference counted, immutable message
+* Abstract/Concrete: Concrete
+* #Instances: Unlimited
+* Exception Expected: No
+* Inherited Classes: NONE
+* Constructors:
+*               1- Default Non-parameterized constructor for empty message - public
+*               2- Constructor that takes the bytes of a vector without copying them - public
+*               3- Constructor that copies the bytes of a vector or a string once - public
+*               4- Constructor that shares an existing payload - public
+*
+* Description: Wrapper of "shared_payload". Its bytes can not be modified after construction, so copies of the
+*              message are safe to read from any thread. An empty message holds no payload and allocates nothing.
+*              "bytes" gives a vector reference for the vector based functions and the comparisons.
+************************************************************************************************************************/
+class ws_message
+{
+private:
+    shared_payload message_payload; //nullptr for empty message
+    static const shared_payload& empty_payload(void)   //shared by all empty messages
+    {
+        static const shared_payload empty = std::make_shared<const std::vector<unsigned char>>();
+        return empty;
+    }
+public:
+    ws_message(void) = default;
+    explicit ws_message(std::vector<unsigned char>&& bytes)    //takes the bytes, no copy
+        : message_payload(std::make_shared<const std::vector<unsigned char>>(std::move(bytes))) {}
+    explicit ws_message(const std::vector<unsigned char>& bytes)   //copies the bytes once
+        : message_payload(std::make_shared<const std::vector<unsigned char>>(bytes)) {}
+    explicit ws_message(const std::string& text)   //copies the characters once
+        : message_payload(std::make_shared<const std::vector<unsigned char>>(text.begin(),text.end())) {}
+    explicit ws_message(shared_payload payload) : message_payload(std::move(payload)) {}
+    const std::vector<unsigned char>& bytes(void) const {return message_payload ? *message_payload : *empty_payload();}
+    const shared_payload& payload(void) const {return message_payload ? message_payload : empty_payload();}  //never nullptr
+    const unsigned char* data(void) const {return bytes().data();}
+    std::size_t size(void) const {return message_payload ? message_payload->size() : 0;}
+    bool empty(void) const {return size() == 0;}
+    long use_count(void) const {return message_payload.use_count();}    //number of copies sharing the bytes
+    std::vector<unsigned char>::const_iterator begin(void) const {return bytes().begin();}
+    std::vector<unsigned char>::const_iterator end(void) const {return bytes().end();}
+    bool operator==(const ws_message& other) const {return message_payload == other.message_payload || bytes() == other.bytes();}
+    bool operator!=(const ws_message& other) const {return !(*this == other);}
+};